@@ -0,0 +1,125 @@
+#include <Arduino.h>
+
+#include "AdcSampler.h"
+
+bool AdcSampler::_running = false;
+uint8_t AdcSampler::_count = 0;
+uint8_t AdcSampler::_mux[AdcSampler::MAX_CHANNELS];
+uint16_t AdcSampler::_limit[AdcSampler::MAX_CHANNELS];
+volatile uint16_t AdcSampler::_filtered[AdcSampler::MAX_CHANNELS];
+volatile uint8_t AdcSampler::_sampling = 0;
+volatile uint8_t AdcSampler::_selected = 0;
+volatile uint8_t AdcSampler::_tripped = 0;
+volatile unsigned long AdcSampler::_conversions = 0;
+
+bool AdcSampler::begin(const uint8_t* pins, uint8_t count) {
+	if (count == 0 || count > MAX_CHANNELS) return false;
+	end();
+	_count = count;
+	for (uint8_t i = 0; i < count; i++) {
+#ifdef ARDUINO
+		uint8_t channel = (pins[i] >= A0) ? pins[i] - A0 : pins[i]; //A0 or 0 both mean channel 0
+#else
+		uint8_t channel = pins[i] & 0x0F;
+#endif
+		_mux[i] = (channel & 0x07) | ((channel & 0x08) << 2); //MUX2:0, MUX5 for 8 - 15
+		_limit[i] = 0;
+		_filtered[i] = 0;
+	}
+	_sampling = 0;
+	_selected = 0;
+	_tripped = 0;
+	_conversions = 0;
+#ifdef ARDUINO
+	//free running: a new conversion starts as soon as one finishes, with the MUX set at that moment.
+	//so when the ISR reads a result, the next conversion already runs, the MUX written now is for
+	//the one after it. channel 0 is selected twice at the start to fill that pipeline
+	ADCSRA = 0;
+	_selectChannel(0);
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0)); //trigger source: free running
+	ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) | _BV(ADSC);
+#endif
+	_running = true;
+	return true;
+}
+
+void AdcSampler::end() {
+#ifdef ARDUINO
+	ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+#endif
+	_running = false;
+}
+
+uint16_t AdcSampler::read(uint8_t channel) {
+	if (channel >= _count) return 0;
+	uint16_t value;
+	do {
+		value = _filtered[channel];
+	} while (value != _filtered[channel]); //the ISR hit between the two byte reads
+	return value >> 4;
+}
+
+void AdcSampler::snapshot(AdcSnapshot& snapshot) {
+	unsigned long conversions;
+	snapshot.count = _count;
+	do {
+		conversions = getConversions();
+		for (uint8_t i = 0; i < _count; i++) snapshot.value[i] = _filtered[i] >> 4;
+	} while (conversions != getConversions()); //a conversion landed during the copy, take it again
+	snapshot.conversions = conversions;
+}
+
+void AdcSampler::setLimit(uint8_t channel, uint16_t limit) {
+	if (channel >= MAX_CHANNELS) return;
+	noInterrupts();
+	_limit[channel] = limit << 4;
+	interrupts();
+}
+
+uint8_t AdcSampler::getTrippedMask() {
+	return _tripped;
+}
+
+void AdcSampler::clearTripped() {
+	_tripped = 0;
+}
+
+unsigned long AdcSampler::getConversions() {
+	noInterrupts();
+	unsigned long conversions = _conversions;
+	interrupts();
+	return conversions;
+}
+
+//one result: filter it, check its limit, select the channel after the one now converting
+void AdcSampler::_onConversion(uint16_t value) {
+	uint8_t channel = _sampling;
+	uint16_t filtered = _filtered[channel];
+	filtered = (filtered == 0) ? value << 4 : filtered - (filtered >> 4) + value; //the first sample seeds it
+	_filtered[channel] = filtered;
+	if (_limit[channel] && filtered > _limit[channel]) _tripped |= (1 << channel);
+	_conversions++;
+
+	_sampling = _selected; //the conversion running now started with the last selection
+	_selected = (_selected + 1 < _count) ? _selected + 1 : 0;
+	_selectChannel(_selected);
+}
+
+#ifdef ARDUINO
+
+void AdcSampler::_selectChannel(uint8_t channel) {
+	uint8_t mux = _mux[channel];
+	ADMUX = _BV(REFS0) | (mux & 0x07); //AVcc reference, like analogRead()
+	if (mux & 0x20) ADCSRB |= _BV(MUX5);
+	else ADCSRB &= ~_BV(MUX5);
+}
+
+ISR(ADC_vect) {
+	AdcSampler::_onConversion(ADC);
+}
+
+#else
+
+void AdcSampler::_selectChannel(uint8_t) {}
+
+#endif
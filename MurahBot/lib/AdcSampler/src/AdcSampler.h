@@ -0,0 +1,60 @@
+// AdcSampler.h
+#include <Arduino.h>
+
+#ifndef _ADCSAMPLER_h
+#define _ADCSAMPLER_h
+
+//filtered values of every channel, taken together
+struct AdcSnapshot {
+	uint16_t value[8]; //0 - 1023, in channel list order
+	uint8_t count; //channels
+	unsigned long conversions; //total, tells two snapshots apart
+};
+
+//background ADC: the converter free runs (prescaler 128, about 9600 conversions/s) and its ISR walks
+//a list of up to 8 analog pins, so a channel is sampled every count / 9600 s and analogRead() is
+//never called. each result goes into a 1/16 exponential filter per channel. the readers take the
+//filtered values lock-free: they copy and retry if a conversion landed meanwhile.
+//a channel can have a limit: the ISR latches it as soon as the filtered value exceeds it, e.g. an
+//overcurrent, and the latch holds until clearTripped(). the ISR costs about 4% of the CPU.
+//one sampler per chip, it owns the ADC: analogRead() must not be used while it runs
+class AdcSampler {
+public:
+	static const uint8_t MAX_CHANNELS = 8;
+
+	//starts sampling the analog pins (A0 - A15), false for no or too many pins
+	static bool begin(const uint8_t* pins, uint8_t count);
+	static void end();
+	static bool isRunning() { return _running; }
+
+	static uint16_t read(uint8_t channel); //filtered value, 0 - 1023
+	static void snapshot(AdcSnapshot& snapshot); //all channels from the same conversion count
+
+	static void setLimit(uint8_t channel, uint16_t limit); //0 removes it
+	static uint8_t getTrippedMask(); //bit per channel over its limit since the last clear
+	static void clearTripped();
+
+	static unsigned long getConversions();
+
+	//host: a finished conversion of the channel the ISR expects next: the list in order, after
+	//channel 0 twice at the start like on the chip
+	static void injectConversion(uint16_t value) { _onConversion(value); }
+
+	static void _onConversion(uint16_t value); //ISR body, not for users
+private:
+	static bool _running;
+	static uint8_t _count;
+	static uint8_t _mux[MAX_CHANNELS]; //MUX bits of each channel, bit 5 is MUX5 (A8 - A15)
+	static uint16_t _limit[MAX_CHANNELS]; //times 16, like the filter state
+
+	//written by the ISR only
+	static volatile uint16_t _filtered[MAX_CHANNELS]; //16 x the filtered value
+	static volatile uint8_t _sampling; //channel of the result the ISR gets next
+	static volatile uint8_t _selected; //channel in the MUX, converted after the running conversion
+	static volatile uint8_t _tripped;
+	static volatile unsigned long _conversions;
+
+	static void _selectChannel(uint8_t channel);
+};
+
+#endif
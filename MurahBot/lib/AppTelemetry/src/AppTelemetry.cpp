@@ -0,0 +1,123 @@
+#include <Arduino.h>
+
+#include "AppTelemetry.h"
+
+//Blynk message around the payload: 5 byte header, "vw\0", the pin number as text and its '\0'
+//(the payload's own last '\0' is not sent, which leaves the pin number's count)
+static uint8_t blynkOverhead(uint8_t virtualPin) {
+	uint8_t digits = (virtualPin >= 100) ? 3 : (virtualPin >= 10) ? 2 : 1;
+	return 5 + 3 + digits;
+}
+
+//default constructor: nothing pushed yet, the budget starts with one full push of credit
+AppTelemetry::AppTelemetry(uint8_t virtualPin, uint8_t fieldCount, uint16_t minIntervalMs, uint16_t maxIntervalMs,
+	uint16_t bytesPerSecond)
+	:_virtualPin(virtualPin), _fieldCount(fieldCount > MAX_FIELDS ? MAX_FIELDS : fieldCount),
+	_overhead(blynkOverhead(virtualPin)), _minInterval(minIntervalMs), _maxInterval(maxIntervalMs),
+	_bytesPerSecond(bytesPerSecond), _watched(0xFFFF), _hasPushed(false), _lastPush(0), _lastRefill(0) {
+	_credit = _burst();
+	for (uint8_t i = 0; i < MAX_FIELDS; i++) {
+		_values[i] = 0;
+		_pushed[i] = 0;
+	}
+	resetCounters();
+}
+
+void AppTelemetry::setIntervals(uint16_t minIntervalMs, uint16_t maxIntervalMs) {
+	_minInterval = minIntervalMs;
+	_maxInterval = maxIntervalMs;
+}
+
+void AppTelemetry::setBudget(uint16_t bytesPerSecond) {
+	_bytesPerSecond = bytesPerSecond;
+}
+
+void AppTelemetry::setWatched(uint16_t fieldMask) {
+	_watched = fieldMask;
+}
+
+void AppTelemetry::set(uint8_t field, long value) {
+	if (field >= _fieldCount) return;
+	_values[field] = constrain(value, -FIELD_LIMIT, FIELD_LIMIT);
+}
+
+uint8_t AppTelemetry::prepare(int room) {
+	unsigned long now = millis();
+	_refill(now);
+	if (_hasPushed && now - _lastPush < _minInterval) return 0;
+	if (_hasPushed && !_changed() && now - _lastPush < _maxInterval) return 0;
+
+	uint8_t length = _format();
+	uint8_t wireSize = _overhead + length;
+	if (wireSize > room || _credit < wireSize * 1000UL) {
+		_deferred++;
+		return 0;
+	}
+	_credit -= wireSize * 1000UL;
+	_lastPush = now;
+	_hasPushed = true;
+	for (uint8_t i = 0; i < _fieldCount; i++) _pushed[i] = _values[i];
+	_pushes++;
+	_bytes += wireSize;
+	return length;
+}
+
+unsigned long AppTelemetry::getPushes() {
+	return _pushes;
+}
+
+unsigned long AppTelemetry::getDeferred() {
+	return _deferred;
+}
+
+unsigned long AppTelemetry::getBytes() {
+	return _bytes;
+}
+
+void AppTelemetry::resetCounters() {
+	_pushes = 0;
+	_deferred = 0;
+	_bytes = 0;
+}
+
+bool AppTelemetry::_changed() {
+	for (uint8_t i = 0; i < _fieldCount; i++) {
+		if ((_watched & (1 << i)) && _values[i] != _pushed[i]) return true;
+	}
+	return false;
+}
+
+//the credit grows by bytesPerSecond per second up to one full push, so an idle link cannot save up
+//for a burst of pushes
+void AppTelemetry::_refill(unsigned long now) {
+	unsigned long elapsed = now - _lastRefill;
+	_lastRefill = now;
+	if (elapsed > 10000) elapsed = 10000; //keeps the product below the long range
+	_credit += elapsed * _bytesPerSecond;
+	if (_credit > _burst()) _credit = _burst();
+}
+
+unsigned long AppTelemetry::_burst() {
+	return (_overhead + PAYLOAD_SIZE) * 1000UL;
+}
+
+//decimal text of each field, each ended by '\0' like BlynkParam::add()
+uint8_t AppTelemetry::_format() {
+	uint8_t length = 0;
+	for (uint8_t i = 0; i < _fieldCount; i++) {
+		long value = _values[i];
+		if (value < 0) {
+			_payload[length++] = '-';
+			value = -value;
+		}
+		char digits[7];
+		uint8_t count = 0;
+		do {
+			digits[count++] = '0' + value % 10;
+			value /= 10;
+		} while (value > 0);
+		while (count > 0) _payload[length++] = digits[--count];
+		_payload[length++] = '\0';
+	}
+	return length;
+}
@@ -0,0 +1,68 @@
+// AppTelemetry.h
+#include <Arduino.h>
+
+#ifndef _APPTELEMETRY_h
+#define _APPTELEMETRY_h
+
+//telemetry for the Blynk app: a fixed set of integer fields pushed as ONE multi-value write to one
+//virtual pin, the app splits the values. the joystick samples come in over the same BLE link, so the
+//pushes are throttled three ways:
+//  - at most one push every minInterval, and only when a watched field changed (or every maxInterval)
+//  - a byte budget (token bucket, bytesPerSecond with one full push of burst)
+//  - a push is only prepared when the serial transmit buffer has room for all of it, so the write
+//    never blocks the scheduler
+//the payload is built in the Blynk parameter format (values as decimal text, each ended by '\0'),
+//so main wraps it in a BlynkParam and hands it to Blynk.virtualWrite() as it is
+class AppTelemetry {
+public:
+	static const uint8_t MAX_FIELDS = 12;
+	static const long FIELD_LIMIT = 999999; //values are clamped to +-FIELD_LIMIT, 8 bytes a field at most
+	static const uint8_t PAYLOAD_SIZE = MAX_FIELDS * 8; //Blynk sends messages of up to 128 bytes
+
+	AppTelemetry(uint8_t virtualPin, uint8_t fieldCount, uint16_t minIntervalMs = 250, uint16_t maxIntervalMs = 2000,
+		uint16_t bytesPerSecond = 300);
+
+	void setIntervals(uint16_t minIntervalMs, uint16_t maxIntervalMs);
+	void setBudget(uint16_t bytesPerSecond);
+	void setWatched(uint16_t fieldMask); //fields whose change makes a push due, default all of them
+
+	void set(uint8_t field, long value);
+
+	//builds the payload if a push is due, within the budget and no larger than room (the free bytes of
+	//the output, e.g. Serial1.availableForWrite()). returns its length, 0 if there is nothing to send.
+	//a returned payload counts as sent: the caller writes it right away
+	uint8_t prepare(int room);
+	char* getPayload() { return _payload; }
+	uint8_t getVirtualPin() { return _virtualPin; }
+
+	unsigned long getPushes();
+	unsigned long getDeferred(); //due pushes held back by the budget or a full transmit buffer
+	unsigned long getBytes(); //bytes on the link, with the Blynk message overhead
+	void resetCounters();
+
+private:
+	uint8_t _virtualPin;
+	uint8_t _fieldCount;
+	uint8_t _overhead; //Blynk header, "vw" and the pin number
+	uint16_t _minInterval;
+	uint16_t _maxInterval;
+	uint16_t _bytesPerSecond;
+	uint16_t _watched;
+	bool _hasPushed;
+	unsigned long _lastPush;
+	unsigned long _lastRefill;
+	unsigned long _credit; //budget left, in 1/1000 bytes
+	unsigned long _pushes;
+	unsigned long _deferred;
+	unsigned long _bytes;
+	long _values[MAX_FIELDS];
+	long _pushed[MAX_FIELDS]; //values of the last push
+	char _payload[PAYLOAD_SIZE];
+
+	bool _changed();
+	void _refill(unsigned long now);
+	unsigned long _burst(); //credit cap, one full push
+	uint8_t _format();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include <Arduino.h>
+
+#include "CommandLink.h"
+
+SpscBuffer<CommandLink::RX_BUFFER_SIZE> CommandLink::_rx;
+SpscBuffer<CommandLink::TX_BUFFER_SIZE> CommandLink::_tx;
+volatile uint16_t CommandLink::_rxOverruns = 0;
+
+//sets up USART1 like the core does (double speed), receive and transmit are interrupt driven
+void CommandLink::begin(unsigned long baud) {
+	_rx.clear();
+#ifdef ARDUINO
+	uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+	UCSR1A = _BV(U2X1);
+	UBRR1H = ubrr >> 8;
+	UBRR1L = ubrr;
+	UCSR1C = _BV(UCSZ11) | _BV(UCSZ10); //8N1
+	UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+#else
+	(void)baud;
+#endif
+}
+
+bool CommandLink::poll() {
+	uint8_t byte;
+	while (_rx.pop(byte)) {
+		if (_parser.feed(byte)) return true;
+	}
+	return false;
+}
+
+bool CommandLink::send(uint8_t type, uint8_t seq, const uint8_t payload[4]) {
+	if (_tx.space() < CommandFrame::SIZE) return false;
+	CommandFrame frame;
+	encodeCommandFrame(type, seq, payload, frame);
+	const uint8_t* bytes = &frame.sync;
+	for (uint8_t i = 0; i < CommandFrame::SIZE; i++) _tx.push(bytes[i]);
+#ifdef ARDUINO
+	noInterrupts(); //the UDRE ISR clears UDRIE1 in the same register
+	UCSR1B |= _BV(UDRIE1);
+	interrupts();
+#endif
+	return true;
+}
+
+bool CommandLink::reply(const CommandFrame& request) {
+	return send(request.type | COMMAND_REPLY, request.seq, request.payload);
+}
+
+bool CommandLink::replyError(const CommandFrame& request, CommandError error) {
+	const uint8_t payload[4] = { request.type, request.payload[0], error, 0 };
+	return send(COMMAND_ERROR, request.seq, payload);
+}
+
+unsigned long CommandLink::getRxOverruns() {
+	noInterrupts();
+	uint16_t overruns = _rxOverruns;
+	interrupts();
+	return overruns;
+}
+
+void CommandLink::resetCounters() {
+	noInterrupts();
+	_rxOverruns = 0;
+	interrupts();
+	_parser.resetCounters();
+}
+
+void CommandLink::receiveByte(uint8_t byte, bool lostBefore) {
+	if (lostBefore) _rxOverruns++;
+	if (!_rx.push(byte)) _rxOverruns++;
+}
+
+bool CommandLink::nextTransmitByte(uint8_t& byte) {
+	return _tx.pop(byte);
+}
+
+#ifdef ARDUINO
+//a byte with a framing error is dropped, the parser's CRC catches the hole
+ISR(USART1_RX_vect) {
+	uint8_t status = UCSR1A;
+	uint8_t byte = UDR1;
+	if (status & _BV(FE1)) return;
+	CommandLink::receiveByte(byte, status & _BV(DOR1)); //DOR1: a byte was lost in the UART itself
+}
+
+ISR(USART1_UDRE_vect) {
+	uint8_t byte;
+	if (CommandLink::nextTransmitByte(byte)) UDR1 = byte;
+	else UCSR1B &= ~_BV(UDRIE1); //ring empty, sleep until send() queues more
+}
+#endif
@@ -0,0 +1,164 @@
+// CommandLink.h
+#include <Arduino.h>
+
+#ifndef _COMMANDLINK_h
+#define _COMMANDLINK_h
+
+//compact framed command protocol on the BLE serial port (Serial1), the alternative to Blynk
+//selected with the build flag -D MURAHBOT_SERIAL_PROTOCOL, see tools/link_latency.py for the host side
+//every frame is 8 bytes: 0x5A, type, seq, 4 payload bytes, CRC-8 (poly 0x07, init 0) of type to payload
+//a ping is answered with a pong of the same seq and payload, the other commands are not answered
+//unless they are rejected: then a COMMAND_ERROR frame with the seq of the command says why
+
+enum CommandType : uint8_t {
+	COMMAND_JOYSTICK = 1, //x, y: 0 - 255 like the Blynk joystick (V1)
+	COMMAND_WHEELS = 2, //4 signed duties / 2 in WheelIndex order (int8, -127 to 127)
+	COMMAND_STOP = 3,
+	COMMAND_CONFIG = 4, //config key, then the key's values (see CommandConfig)
+	COMMAND_MOTION = 5, //0 aborts, 1 starts the queued steps, 2 runs the test route (like Blynk V3)
+	COMMAND_PING = 6, //any payload
+	COMMAND_RECORD = 7, //joystick recorder command (like Blynk V4)
+	COMMAND_CALIBRATE = 8, //wheel, curve, point, duty: wheel calibration command (like Blynk V5)
+	COMMAND_PONG = 0x86, //robot to host: COMMAND_PING | COMMAND_REPLY
+	COMMAND_ERROR = 0xFF //robot to host: the rejected command's type, its first payload byte, CommandError
+};
+
+const uint8_t COMMAND_REPLY = 0x80; //set in the type of the frames the robot sends
+
+enum CommandConfig : uint8_t {
+	CONFIG_RAMP = 1, //accel step, decel step, reversal steps
+	CONFIG_MIXING = 2, //0 threshold joystick decoding, 1 continuous mixing
+	CONFIG_SPEED_TOLERANCE = 3 //int16 little endian, 0 to half the wheels' speed range (67 on MurahBot)
+};
+
+enum CommandError : uint8_t {
+	ERROR_OUT_OF_RANGE = 1 //a value the robot does not accept, nothing was changed
+};
+
+//the frame as it sits in the receive buffer, the parser hands it out without copying
+struct CommandFrame {
+	static const uint8_t SYNC = 0x5A;
+	static const uint8_t SIZE = 8;
+
+	uint8_t sync;
+	uint8_t type;
+	uint8_t seq;
+	uint8_t payload[4];
+	uint8_t crc;
+
+	int8_t getInt8(uint8_t offset) const { return (int8_t)payload[offset & 3]; }
+	int16_t getInt16(uint8_t offset) const {
+		return (int16_t)(payload[offset & 3] | ((uint16_t)payload[(offset + 1) & 3] << 8));
+	}
+};
+
+//CRC-8 of the frame, from type to the last payload byte
+uint8_t commandCrc8(const uint8_t* bytes, uint8_t length);
+
+//fills out with a complete frame
+void encodeCommandFrame(uint8_t type, uint8_t seq, const uint8_t payload[4], CommandFrame& out);
+
+//incremental frame parser, fed one byte at a time. the CRC is updated per byte, so completing a frame
+//costs no extra pass. after a bad CRC it resynchronizes on the next 0x5A among the bytes it already has
+class CommandParser {
+
+public:
+	CommandParser();
+
+	//returns true when the byte completed a valid frame, read it with getFrame() before the next feed()
+	bool feed(uint8_t byte);
+	const CommandFrame& getFrame() { return _frame; }
+
+	unsigned long getFrameCount() { return _frameCount; }
+	unsigned long getCrcErrors() { return _crcErrors; }
+	unsigned long getDiscardedBytes() { return _discardedBytes; } //bytes outside of any frame
+	void resetCounters();
+
+private:
+	union {
+		CommandFrame _frame;
+		uint8_t _bytes[CommandFrame::SIZE];
+	};
+	uint8_t _length; //bytes of the frame received so far
+	uint8_t _crc; //CRC of _bytes[1] to _bytes[_length - 1]
+
+	unsigned long _frameCount;
+	unsigned long _crcErrors;
+	unsigned long _discardedBytes;
+
+	void _resync(); //drops the bad frame up to the next sync byte in it
+};
+
+//lock-free single producer single consumer byte ring between an ISR and the main loop
+//the producer only writes _head and the consumer only _tail, one byte each, so neither needs
+//interrupts masked. SIZE is a power of two up to 128
+template <uint8_t SIZE>
+class SpscBuffer {
+	static_assert(SIZE > 1 && SIZE <= 128 && (SIZE & (SIZE - 1)) == 0, "SpscBuffer SIZE is a power of two up to 128");
+
+public:
+	//producer side
+	bool push(uint8_t byte) {
+		uint8_t head = _head;
+		if ((uint8_t)(head - _tail) >= SIZE) return false;
+		_buffer[head & (SIZE - 1)] = byte;
+		_head = head + 1; //published after the byte is stored
+		return true;
+	}
+	uint8_t space() { return SIZE - (uint8_t)(_head - _tail); }
+
+	//consumer side
+	bool pop(uint8_t& byte) {
+		uint8_t tail = _tail;
+		if (tail == _head) return false;
+		byte = _buffer[tail & (SIZE - 1)];
+		_tail = tail + 1;
+		return true;
+	}
+	uint8_t available() { return (uint8_t)(_head - _tail); }
+	void clear() { _tail = _head; }
+
+private:
+	uint8_t _buffer[SIZE];
+	volatile uint8_t _head = 0;
+	volatile uint8_t _tail = 0;
+};
+
+//the protocol on USART1 with its own interrupt driven receive and transmit rings, Serial1 is not
+//used at all (the core's Serial1 ISRs are only linked in if Serial1 is referenced, so this build
+//must not use Serial1 or Blynk). one instance only, the rings are shared with the ISRs
+class CommandLink {
+
+public:
+	static const uint8_t RX_BUFFER_SIZE = 64;
+	static const uint8_t TX_BUFFER_SIZE = 32;
+
+	void begin(unsigned long baud); //takes over USART1, 8N1
+
+	//parses the received bytes up to the next complete frame, true if there is one (getFrame())
+	//call it until it returns false to drain the receive ring
+	bool poll();
+	const CommandFrame& getFrame() { return _parser.getFrame(); }
+
+	//queues one frame, false if the transmit ring has no room for all of it (nothing is queued)
+	bool send(uint8_t type, uint8_t seq, const uint8_t payload[4]);
+	bool reply(const CommandFrame& request); //pong of a ping
+	bool replyError(const CommandFrame& request, CommandError error); //COMMAND_ERROR for the request
+
+	CommandParser& getParser() { return _parser; }
+	unsigned long getRxOverruns(); //bytes lost because the receive ring was full or the UART overran
+	void resetCounters();
+
+	//ISR side, also the host's way to feed and read the link
+	static void receiveByte(uint8_t byte, bool lostBefore = false);
+	static bool nextTransmitByte(uint8_t& byte);
+
+private:
+	CommandParser _parser;
+
+	static SpscBuffer<RX_BUFFER_SIZE> _rx;
+	static SpscBuffer<TX_BUFFER_SIZE> _tx;
+	static volatile uint16_t _rxOverruns;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <Crc8.h>
+
+#include "CommandLink.h"
+
+uint8_t commandCrc8(const uint8_t* bytes, uint8_t length) {
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < length; i++) crc = crc8Update(crc, bytes[i]);
+	return crc;
+}
+
+void encodeCommandFrame(uint8_t type, uint8_t seq, const uint8_t payload[4], CommandFrame& out) {
+	out.sync = CommandFrame::SYNC;
+	out.type = type;
+	out.seq = seq;
+	for (uint8_t i = 0; i < 4; i++) out.payload[i] = payload[i];
+	out.crc = commandCrc8(&out.type, CommandFrame::SIZE - 2);
+}
+
+//default constructor: waits for a sync byte
+CommandParser::CommandParser()
+	:_length(0), _crc(0) {
+	resetCounters();
+}
+
+bool CommandParser::feed(uint8_t byte) {
+	if (_length == 0) {
+		if (byte != CommandFrame::SYNC) {
+			_discardedBytes++;
+			return false;
+		}
+		_bytes[0] = byte;
+		_length = 1;
+		_crc = 0;
+		return false;
+	}
+	_bytes[_length++] = byte;
+	if (_length < CommandFrame::SIZE) {
+		_crc = crc8Update(_crc, byte);
+		return false;
+	}
+	if (byte == _crc) {
+		_length = 0;
+		_frameCount++;
+		return true;
+	}
+	_crcErrors++;
+	_resync();
+	return false;
+}
+
+void CommandParser::resetCounters() {
+	_frameCount = 0;
+	_crcErrors = 0;
+	_discardedBytes = 0;
+}
+
+//the sync byte may have been a payload byte: restart at the next sync byte after it, if any
+void CommandParser::_resync() {
+	uint8_t start = 1;
+	while (start < CommandFrame::SIZE && _bytes[start] != CommandFrame::SYNC) start++;
+	_discardedBytes += start;
+	_length = 0;
+	_crc = 0;
+	for (uint8_t i = start; i < CommandFrame::SIZE; i++) {
+		_bytes[_length] = _bytes[i];
+		if (_length > 0) _crc = crc8Update(_crc, _bytes[_length]);
+		_length++;
+	}
+}
@@ -0,0 +1,141 @@
+#include <Arduino.h>
+
+#include "ControlLoop.h"
+
+void(*ControlLoop::_step)() = 0;
+ControlLoop::CatchUpPolicy ControlLoop::_policy = ControlLoop::SKIP;
+bool ControlLoop::_running = false;
+uint16_t ControlLoop::_periodTicks = 0;
+unsigned long ControlLoop::_nextDue = 0;
+volatile unsigned long ControlLoop::_steps = 0;
+volatile unsigned long ControlLoop::_overruns = 0;
+volatile unsigned long ControlLoop::_skipped = 0;
+volatile unsigned long ControlLoop::_missed = 0;
+volatile unsigned long ControlLoop::_latencySum = 0;
+volatile uint16_t ControlLoop::_latencyMax = 0;
+volatile uint16_t ControlLoop::_runtimeMax = 0;
+
+bool ControlLoop::begin(uint16_t rateHz, void(*step)(), CatchUpPolicy policy) {
+	if (rateHz < 31 || rateHz > 20000 || !step) return false;
+	end();
+	_step = step;
+	_policy = policy;
+	_periodTicks = (uint16_t)(2000000UL / rateHz);
+	resetStats();
+	_nextDue = micros() * 2 + _periodTicks;
+#ifdef ARDUINO
+	//CTC on OCR5A, prescaler 8: one tick is 0.5 us at 16 MHz
+	TCCR5A = 0;
+	TCCR5B = 0;
+	TCNT5 = 0;
+	OCR5A = _periodTicks - 1;
+	TIFR5 = _BV(OCF5A);
+	TIMSK5 = _BV(OCIE5A);
+	TCCR5B = _BV(WGM52) | _BV(CS51);
+#endif
+	_running = true;
+	return true;
+}
+
+void ControlLoop::end() {
+#ifdef ARDUINO
+	TIMSK5 &= ~_BV(OCIE5A);
+	TCCR5B = 0;
+#endif
+	_running = false;
+}
+
+void ControlLoop::getStats(Stats& stats) {
+	noInterrupts();
+	stats.steps = _steps;
+	stats.overruns = _overruns;
+	stats.skipped = _skipped;
+	stats.missed = _missed;
+	unsigned long latencySum = _latencySum;
+	uint16_t latencyMax = _latencyMax;
+	uint16_t runtimeMax = _runtimeMax;
+	interrupts();
+	stats.latencyMean = stats.steps ? latencySum / stats.steps / 2 : 0;
+	stats.latencyMax = latencyMax / 2;
+	stats.runtimeMax = runtimeMax / 2;
+}
+
+void ControlLoop::resetStats() {
+	noInterrupts();
+	_steps = 0;
+	_overruns = 0;
+	_skipped = 0;
+	_missed = 0;
+	_latencySum = 0;
+	_latencyMax = 0;
+	_runtimeMax = 0;
+	interrupts();
+}
+
+//a step more than a period behind the grid means compare matches came and went without a step: the
+//timer holds one of them at most. the division only runs after such a loss
+void ControlLoop::_countMissed() {
+	unsigned long late = micros() * 2 - _nextDue;
+	if ((long)late >= (long)_periodTicks) {
+		unsigned long missed = late / _periodTicks;
+		_missed += missed;
+		_nextDue += missed * _periodTicks;
+	}
+	_nextDue += _periodTicks;
+}
+
+#ifdef ARDUINO
+
+//the step runs with interrupts masked, as ISRs do, so it delays the UART and encoder ISRs by its runtime
+void ControlLoop::_onCompare(uint16_t latencyTicks) {
+	_countMissed();
+	_step();
+	uint16_t endTicks = TCNT5;
+	bool overrun = TIFR5 & _BV(OCF5A); //the next compare match came during the step
+	uint16_t runtime = overrun ? _periodTicks : endTicks - latencyTicks;
+
+	_steps++;
+	_latencySum += latencyTicks;
+	if (latencyTicks > _latencyMax) _latencyMax = latencyTicks;
+	if (runtime > _runtimeMax) _runtimeMax = runtime;
+	if (!overrun) return;
+	_overruns++;
+	if (_policy == SKIP) {
+		TIFR5 = _BV(OCF5A); //drops the flagged step, the next one runs on the grid
+		_skipped++;
+		_nextDue += _periodTicks;
+	}
+}
+
+ISR(TIMER5_COMPA_vect) {
+	ControlLoop::_onCompare(TCNT5); //ticks since the compare match cleared the counter
+}
+
+void ControlLoop::tick() {}
+
+#else
+
+//the host has no timer, tick() is the compare match: no latency, overruns from the measured runtime.
+//ticks more than a period late miss steps like a Lock does on the robot
+void ControlLoop::_onCompare(uint16_t latencyTicks) {
+	_countMissed();
+	unsigned long start = micros();
+	_step();
+	unsigned long runtime = (micros() - start) * 2;
+	_steps++;
+	_latencySum += latencyTicks;
+	if (runtime > _runtimeMax) _runtimeMax = (uint16_t)min(runtime, 0xFFFFUL);
+	if (runtime > _periodTicks) {
+		_overruns++;
+		if (_policy == SKIP) { //drops the one step the timer would have flagged, like on the robot
+			_skipped++;
+			_nextDue += _periodTicks;
+		}
+	}
+}
+
+void ControlLoop::tick() {
+	if (_running) _onCompare(0);
+}
+
+#endif
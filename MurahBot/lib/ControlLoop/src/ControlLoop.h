@@ -0,0 +1,88 @@
+// ControlLoop.h
+#include <Arduino.h>
+
+#ifndef _CONTROLLOOP_h
+#define _CONTROLLOOP_h
+
+//fixed rate control step run from the Timer5 compare interrupt (CTC, 0.5 us resolution), so its
+//timing does not depend on how long the scheduler's tasks (Blynk.run()) take. keep the step short,
+//a ramp step or a speed control update. state shared with the step is changed by the main loop
+//inside a ControlLoop::Lock, which holds off the step (and nothing else) for that long.
+//the ISR measures its start latency after the compare match and its runtime, and counts overruns:
+//steps still running when the next one was due. the timer flags one pending compare match at most,
+//so the ISR also keeps the step grid in micros() and counts the matches lost behind a Lock or a long
+//step as missed
+//Timer5 also runs the PWM of pins 44 - 46, analogWrite() on them does not work while the loop runs
+class ControlLoop {
+public:
+	enum CatchUpPolicy : uint8_t {
+		SKIP, //an overrun drops the missed steps, the next step runs on the grid
+		CATCH_UP //an overrun runs one missed step right after the late one (the timer flags only one)
+	};
+
+	struct Stats {
+		unsigned long steps;
+		unsigned long overruns;
+		unsigned long skipped; //steps dropped by SKIP
+		unsigned long missed; //steps of the grid that never ran: lost behind a Lock or a step over two periods long
+		unsigned long latencyMean; //us from the compare match to the step, i.e. the period jitter
+		unsigned long latencyMax;
+		unsigned long runtimeMax; //us
+	};
+
+	//starts the loop, false if the rate is outside 31 - 20000 Hz
+	static bool begin(uint16_t rateHz, void(*step)(), CatchUpPolicy policy = SKIP);
+	static void end();
+	static bool isRunning() { return _running; }
+	static unsigned long getPeriod() { return _periodTicks / 2; } //us
+
+	static void getStats(Stats& stats);
+	static void resetStats();
+
+	//holds off the step for its scope, nests
+	class Lock {
+	public:
+		Lock();
+		~Lock();
+	private:
+		uint8_t _mask;
+	};
+
+	//host: runs one step like the timer would, the runtime is measured with micros()
+	static void tick();
+
+	static void _onCompare(uint16_t latencyTicks); //ISR body, not for users
+private:
+	static void(*_step)();
+	static CatchUpPolicy _policy;
+	static bool _running;
+	static uint16_t _periodTicks; //0.5 us ticks
+	static unsigned long _nextDue; //0.5 us ticks of micros() (times 2) of the next step on the grid
+
+	static void _countMissed(); //moves the grid past the matches that came without a step
+
+	//written by the ISR only
+	static volatile unsigned long _steps;
+	static volatile unsigned long _overruns;
+	static volatile unsigned long _skipped;
+	static volatile unsigned long _missed;
+	static volatile unsigned long _latencySum; //ticks
+	static volatile uint16_t _latencyMax; //ticks
+	static volatile uint16_t _runtimeMax; //ticks
+};
+
+#ifdef ARDUINO
+inline ControlLoop::Lock::Lock() {
+	_mask = TIMSK5 & _BV(OCIE5A);
+	TIMSK5 &= ~_BV(OCIE5A); //a compare match meanwhile stays flagged, the step runs on the unlock
+}
+
+inline ControlLoop::Lock::~Lock() {
+	TIMSK5 |= _mask;
+}
+#else
+inline ControlLoop::Lock::Lock() :_mask(0) {}
+inline ControlLoop::Lock::~Lock() {}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+// Crc8.h
+#include <Arduino.h>
+#ifdef ARDUINO
+#include <util/crc16.h>
+#endif
+
+#ifndef _CRC8_h
+#define _CRC8_h
+
+//CRC-8 step, poly 0x07, shared by the command frames and the EEPROM images (calibration, recorder)
+//inline so the frame parser keeps it in its byte loop, the avr-libc version is a few instructions
+//of inline assembly
+static inline uint8_t crc8Update(uint8_t crc, uint8_t byte) {
+#ifdef ARDUINO
+	return _crc8_ccitt_update(crc, byte);
+#else
+	crc ^= byte;
+	for (uint8_t bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+#endif
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include <Arduino.h>
+
+#include "DrivePacer.h"
+
+//default constructor: no run pending, the first sample runs the drive at once
+DrivePacer::DrivePacer(LinkHealth& link, unsigned long minIntervalMs, unsigned long decayStepMs)
+	:_link(&link), _minInterval(minIntervalMs), _decayStep(decayStepMs), _lastDriveMillis(millis() - minIntervalMs),
+	_sampleMicros(0), _pending(false), _coalesced(0) {
+}
+
+unsigned long DrivePacer::onSample() {
+	if (_pending) {
+		_coalesced++; //the pending run picks up the new values
+		return NO_RUN;
+	}
+	_pending = true;
+	_sampleMicros = micros();
+	unsigned long sinceLastDrive = millis() - _lastDriveMillis;
+	return (sinceLastDrive >= _minInterval) ? 0 : _minInterval - sinceLastDrive;
+}
+
+//no sample, no run: come back when the input goes stale, then every decay step until stopped
+unsigned long DrivePacer::onDrive(uint16_t commandScale) {
+	_lastDriveMillis = millis();
+	_pending = false;
+	if (commandScale == 0) return NO_RUN;
+	return _link->isStale() ? _decayStep : _link->getTimeToStale() + 1;
+}
+
+void DrivePacer::reset() {
+	_pending = false;
+}
+
+bool DrivePacer::isPending() {
+	return _pending;
+}
+
+unsigned long DrivePacer::getSampleMicros() {
+	return _sampleMicros;
+}
+
+unsigned long DrivePacer::getCoalesced() {
+	return _coalesced;
+}
+
+void DrivePacer::resetCounters() {
+	_coalesced = 0;
+}
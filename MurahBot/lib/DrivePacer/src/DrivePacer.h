@@ -0,0 +1,43 @@
+// DrivePacer.h
+#include <Arduino.h>
+#include <LinkHealth.h>
+
+#ifndef _DRIVEPACER_h
+#define _DRIVEPACER_h
+
+//pacing of the event driven drive runs of a joystick link, shared by src/main.cpp and the simulator
+//a sample runs the drive right away, at most once per minimum interval. samples arriving while a run
+//is pending are coalesced, the run uses the newest one. without samples the drive comes back when
+//the link goes stale, then every decay step until LinkHealth has scaled the command to a stop.
+//the caller owns the timer (taskDrive on the robot, the virtual clock in the simulator) and runs the
+//drive once the returned delay has passed
+class DrivePacer {
+public:
+	static const unsigned long NO_RUN = 0xFFFFFFFF; //no run to schedule
+
+	DrivePacer(LinkHealth& link, unsigned long minIntervalMs, unsigned long decayStepMs);
+
+	//call after link.sample(): ms until the run that takes the sample, NO_RUN if it was coalesced
+	//into the pending run
+	unsigned long onSample();
+	//call after every drive run with the command scale it used (0 if nothing was driven): ms until
+	//the run that decays a stale input, NO_RUN once the command is at a stop
+	unsigned long onDrive(uint16_t commandScale);
+	void reset(); //drops the pending run
+
+	bool isPending(); //a sample waits for its run
+	unsigned long getSampleMicros(); //arrival of the oldest sample not yet driven
+	unsigned long getCoalesced(); //samples merged into a pending run
+	void resetCounters();
+
+private:
+	LinkHealth* _link;
+	unsigned long _minInterval; //ms
+	unsigned long _decayStep; //ms
+	unsigned long _lastDriveMillis;
+	unsigned long _sampleMicros;
+	bool _pending;
+	unsigned long _coalesced;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+
+#include "DriveTelemetry.h"
+
+//default constructor: the first sample() always queues a frame
+DriveTelemetry::DriveTelemetry(Drive4Wheel& drive, uint16_t minIntervalMs, uint16_t maxIntervalMs)
+	:_drive(&drive), _minInterval(minIntervalMs), _maxInterval(maxIntervalMs), _lastState(Drive4Wheel::DRIVE_STOP) {
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) _lastDuty[i] = -1; //never a valid duty
+}
+
+//queues a frame on a change of the drive (throttled) or on the heartbeat interval
+bool DriveTelemetry::sample() {
+	unsigned long sinceLastFrame = millis() - _lastFrameMillis;
+	if (sinceLastFrame < _minInterval) return false;
+	if (!_changed() && sinceLastFrame < _maxInterval) return false;
+	queueFrame();
+	return true;
+}
+
+bool DriveTelemetry::queueFrame() {
+	_lastFrameMillis = millis();
+	_lastState = _drive->getCurrentDriveState();
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) _lastDuty[i] = _drive->getCurrentDuty((Drive4Wheel::WheelIndex)i);
+	_sequence++;
+
+	uint8_t room = (uint8_t)(_tail - _head - 1) & (BUFFER_SIZE - 1);
+	if (room < TELEMETRY_FRAME_SIZE) {
+		_droppedFrames++;
+		return false;
+	}
+
+	uint8_t checksum = 0;
+	_buffer[_head] = TELEMETRY_SYNC;
+	_head = (_head + 1) & (BUFFER_SIZE - 1);
+	_put(_sequence, checksum);
+	unsigned long timestamp = _lastFrameMillis;
+	for (uint8_t i = 0; i < 4; i++) {
+		_put((uint8_t)timestamp, checksum);
+		timestamp >>= 8;
+	}
+	_put(_lastState, checksum);
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		_put((uint8_t)_lastDuty[i], checksum);
+		_put((uint8_t)((uint16_t)_lastDuty[i] >> 8), checksum);
+	}
+	uint8_t unused = 0;
+	_put(checksum, unused);
+	_sentFrames++;
+	return true;
+}
+
+uint8_t DriveTelemetry::getQueuedBytes() {
+	return (uint8_t)(_head - _tail) & (BUFFER_SIZE - 1);
+}
+
+unsigned long DriveTelemetry::getSentFrames() {
+	return _sentFrames;
+}
+
+unsigned long DriveTelemetry::getDroppedFrames() {
+	return _droppedFrames;
+}
+
+void DriveTelemetry::resetCounters() {
+	_sentFrames = 0;
+	_droppedFrames = 0;
+}
+
+//private method comparing the drive with the last frame
+bool DriveTelemetry::_changed() {
+	if (_drive->getCurrentDriveState() != _lastState) return true;
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		if (_drive->getCurrentDuty((Drive4Wheel::WheelIndex)i) != _lastDuty[i]) return true;
+	}
+	return false;
+}
+
+//private method appending one byte to the ring buffer and the checksum
+void DriveTelemetry::_put(uint8_t value, uint8_t& checksum) {
+	_buffer[_head] = value;
+	_head = (_head + 1) & (BUFFER_SIZE - 1);
+	checksum += value;
+}
@@ -0,0 +1,94 @@
+// DriveTelemetry.h
+#include <Arduino.h>
+#include <Wheels.h>
+
+#ifndef _DRIVETELEMETRY_h
+#define _DRIVETELEMETRY_h
+
+//binary drive telemetry frame, little endian, 16 bytes:
+//  0     sync 0xA5
+//  1     sequence number, +1 per frame queued (gaps show dropped frames)
+//  2-5   timestamp, millis()
+//  6     Drive4Wheel::DriveState
+//  7-14  signed duty of each wheel in WheelIndex order, int16, the sign is the direction
+//  15    checksum, sum of bytes 1-14 modulo 256
+//tools/decode_telemetry.py turns a capture back into a readable log
+const uint8_t TELEMETRY_SYNC = 0xA5;
+const uint8_t TELEMETRY_FRAME_SIZE = 16; //a power of 2
+
+//queues a frame when the drive changes (at most every minInterval) or every maxInterval as a heartbeat
+//frames go into a fixed size ring buffer, flush() moves only what the output can take without
+//blocking. a frame that does not fit is dropped and counted, the drive tick never waits on the link
+class DriveTelemetry {
+public:
+	static const uint8_t BUFFER_SIZE = 128; //power of 2, holds 7 frames (one byte stays free)
+
+	DriveTelemetry(Drive4Wheel& drive, uint16_t minIntervalMs = 100, uint16_t maxIntervalMs = 1000);
+
+	bool sample(); //queues a frame if due, returns false if nothing was queued
+	bool queueFrame(); //queues a frame now, false if it was dropped
+
+	//writes queued bytes while output.availableForWrite() allows, returns the bytes written
+	//Output is a HardwareSerial on the robot, anything with availableForWrite() and write(uint8_t) on the host
+	//nothing is written while suspended
+	template <class Output>
+	uint8_t flush(Output& output) {
+		uint8_t written = 0;
+		if (_suspended) return 0;
+		int room = output.availableForWrite();
+		while (_head != _tail && room-- > 0) {
+			_send(output);
+			written++;
+		}
+		return written;
+	}
+
+	//text on the same output goes between suspend() and resume(): suspend() finishes the frame being
+	//sent (blocking, at most 15 bytes) and the queued frames wait until resume(), so a text line never
+	//lands inside a frame. nests, frames are sent again after the last resume()
+	template <class Output>
+	void suspend(Output& output) {
+		while (_frameOffset != 0) _send(output); //the ring only holds whole frames, the rest is queued
+		_suspended++;
+	}
+	void resume() {
+		if (_suspended > 0) _suspended--;
+	}
+	bool isSuspended() { return _suspended > 0; }
+
+	uint8_t getQueuedBytes();
+	unsigned long getSentFrames(); //frames queued
+	unsigned long getDroppedFrames();
+	void resetCounters();
+
+private:
+	Drive4Wheel* _drive;
+	uint16_t _minInterval;
+	uint16_t _maxInterval;
+	unsigned long _lastFrameMillis = 0;
+	uint8_t _sequence = 0;
+	unsigned long _sentFrames = 0;
+	unsigned long _droppedFrames = 0;
+
+	//last reported drive, a frame is due when it changes
+	Drive4Wheel::DriveState _lastState;
+	int16_t _lastDuty[Drive4Wheel::WHEEL_COUNT];
+
+	uint8_t _buffer[BUFFER_SIZE];
+	volatile uint8_t _head = 0; //next byte written by queueFrame()
+	volatile uint8_t _tail = 0; //next byte sent by flush()
+	uint8_t _frameOffset = 0; //bytes of the frame at _tail already sent
+	uint8_t _suspended = 0;
+
+	template <class Output>
+	void _send(Output& output) {
+		output.write(_buffer[_tail]);
+		_tail = (_tail + 1) & (BUFFER_SIZE - 1);
+		_frameOffset = (_frameOffset + 1) & (TELEMETRY_FRAME_SIZE - 1);
+	}
+
+	bool _changed();
+	void _put(uint8_t value, uint8_t& checksum);
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include <Arduino.h>
+
+#include "InterruptButton.h"
+
+InterruptButton* InterruptButton::_instances[3] = { 0, 0, 0 };
+
+//default constructor: the pin is set up in begin()
+InterruptButton::InterruptButton(uint8_t pin, uint16_t debounceMs)
+	:_pin(pin), _debounce(debounceMs), _interruptDriven(false), _state(HIGH), _rawLevel(HIGH),
+	_edgePending(false), _edgeMillis(0), _edgeCount(0) {
+}
+
+bool InterruptButton::isInterruptDriven() {
+	return _interruptDriven;
+}
+
+//accepts the pin level once no edge was seen for the debounce time
+bool InterruptButton::update() {
+	if (!_interruptDriven) {
+		uint8_t level = digitalRead(_pin);
+		if (level != _rawLevel) {
+			_rawLevel = level;
+			_onEdge();
+		}
+	}
+	if (!_edgePending) return false;
+
+	noInterrupts();
+	unsigned long edgeMillis = _edgeMillis;
+	interrupts();
+	if (millis() - edgeMillis < _debounce) return false;
+
+	_edgePending = false;
+	uint8_t level = digitalRead(_pin);
+	if (level == _state) return false; //bounced back
+	_state = level;
+	return true;
+}
+
+uint8_t InterruptButton::read() {
+	return _state;
+}
+
+unsigned long InterruptButton::getEdgeCount() {
+	noInterrupts();
+	unsigned long edgeCount = _edgeCount;
+	interrupts();
+	return edgeCount;
+}
+
+void InterruptButton::_onEdge() {
+	_edgeMillis = millis();
+	_edgePending = true;
+	_edgeCount++;
+}
+
+//every pin of a bank shares its vector, the button ignores edges of the other pins in the bank
+void InterruptButton::_onPinChange(uint8_t bank) {
+	InterruptButton* button = _instances[bank];
+	if (button) button->_onEdge();
+}
+
+#ifdef ARDUINO
+
+bool InterruptButton::begin() {
+	pinMode(_pin, INPUT_PULLUP);
+	_state = digitalRead(_pin);
+	_rawLevel = _state;
+
+	volatile uint8_t* pcicr = digitalPinToPCICR(_pin);
+	uint8_t bank = digitalPinToPCICRbit(_pin);
+	if (!pcicr || bank >= 3 || _instances[bank]) return false;
+
+	_instances[bank] = this;
+	_interruptDriven = true;
+	*digitalPinToPCMSK(_pin) |= _BV(digitalPinToPCMSKbit(_pin));
+	PCIFR = _BV(bank); //drops a stale flag
+	*pcicr |= _BV(bank);
+	return true;
+}
+
+#if defined(PCINT0_vect)
+ISR(PCINT0_vect) { InterruptButton::_onPinChange(0); }
+#endif
+#if defined(PCINT1_vect)
+ISR(PCINT1_vect) { InterruptButton::_onPinChange(1); }
+#endif
+#if defined(PCINT2_vect)
+ISR(PCINT2_vect) { InterruptButton::_onPinChange(2); }
+#endif
+
+#else
+
+//no interrupts on the host, the button is polled
+bool InterruptButton::begin() {
+	pinMode(_pin, INPUT_PULLUP);
+	_state = digitalRead(_pin);
+	_rawLevel = _state;
+	return false;
+}
+
+#endif
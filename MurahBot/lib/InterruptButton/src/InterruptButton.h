@@ -0,0 +1,45 @@
+// InterruptButton.h
+#include <Arduino.h>
+
+#ifndef _INTERRUPTBUTTON_h
+#define _INTERRUPTBUTTON_h
+
+//push button with timestamp based debouncing
+//on a pin with a pin change interrupt the ISR only timestamps the edges, so update() has nothing to
+//poll and the MCU can sleep between updates. other pins (e.g. 22, PA0 has no PCINT on the Mega) fall
+//back to sampling the pin in update(). either way a new level is accepted once the pin has been
+//quiet for the debounce time. one interrupt driven button per PCINT bank (3 on the Mega)
+//the PCINT vectors are defined here, which rules out SoftwareSerial in the same sketch
+class InterruptButton {
+public:
+	InterruptButton(uint8_t pin, uint16_t debounceMs = 10);
+
+	bool begin(); //INPUT_PULLUP and the pin change interrupt, false if the pin has to be polled
+	bool isInterruptDriven();
+
+	bool update(); //returns true if the debounced level changed, call every few ms
+	//true from an edge until update() has taken the new level: an interrupt driven button only needs
+	//update() while this is true, so its caller can sleep in between
+	bool isPending() { return _edgePending; }
+	uint8_t read(); //debounced level
+	unsigned long getEdgeCount(); //raw edges seen, bounces included
+
+private:
+	uint8_t _pin;
+	uint16_t _debounce;
+	bool _interruptDriven;
+	uint8_t _state; //debounced level
+	uint8_t _rawLevel; //last sampled level, polling only
+	volatile bool _edgePending;
+	volatile unsigned long _edgeMillis; //time of the last edge
+	volatile unsigned long _edgeCount;
+
+	void _onEdge(); //called by the ISR or by update() when polling
+
+public:
+	static void _onPinChange(uint8_t bank); //dispatch from the PCINT vectors, not for users
+private:
+	static InterruptButton* _instances[3];
+};
+
+#endif
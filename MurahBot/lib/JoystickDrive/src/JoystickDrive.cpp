@@ -0,0 +1,224 @@
+#include <Arduino.h>
+
+#include "JoystickDrive.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//compile time joystick lookup table
+//each entry packs the DriveState (bits 0-7), the normalized drive speed (bits 8-15)
+//and the normalized sway ratio (bits 16-23) of one bucket, evaluated near the middle of the bucket
+//(see joystickTableBucket() for the bucket bounds). the table holds no absolute speeds,
+//they are scaled at run time with the current drive speeds (see _refreshTableScaling())
+
+constexpr int tableBucketValue(int bucket) {
+	return (bucket < JOYSTICK_TABLE_LOW_EDGE) ? (bucket << JOYSTICK_TABLE_SHIFT) + 3 :
+		(bucket == JOYSTICK_TABLE_LOW_EDGE) ? X_THRESHOLD_LOW :
+		(bucket == JOYSTICK_TABLE_CENTER) ? 128 :
+		(bucket == JOYSTICK_TABLE_HIGH_EDGE) ? X_THRESHOLD_HIGH :
+		(X_THRESHOLD_HIGH + 3 + ((bucket - JOYSTICK_TABLE_HIGH_EDGE - 1) << JOYSTICK_TABLE_SHIFT) > 255) ? 255 :
+		X_THRESHOLD_HIGH + 3 + ((bucket - JOYSTICK_TABLE_HIGH_EDGE - 1) << JOYSTICK_TABLE_SHIFT);
+}
+
+constexpr bool tableInX(int x) {
+	return (x > X_THRESHOLD_LOW && x < X_THRESHOLD_HIGH);
+}
+
+constexpr bool tableInY(int y) {
+	return (y > Y_THRESHOLD_LOW && y < Y_THRESHOLD_HIGH);
+}
+
+//same mapping as map(value, from, to, 0, 255), clipped to 0-255
+constexpr uint8_t tableFraction(int value, int from, int to) {
+	return ((long)(value - from) * 255 / (to - from) < 0) ? 0 :
+		(((long)(value - from) * 255 / (to - from) > 255) ? 255 : (long)(value - from) * 255 / (to - from));
+}
+
+constexpr uint32_t tablePack(Drive4Wheel::DriveState driveState, uint8_t speedFraction, uint8_t ratioFraction) {
+	return (uint32_t)driveState | ((uint32_t)speedFraction << 8) | ((uint32_t)ratioFraction << 16);
+}
+
+//same regions as drivePrimary() and driveSecondary(), the threshold values themselves stop the drive
+constexpr uint32_t tableEntry(int x, int y) {
+	return (tableInX(x) && tableInY(y)) ? tablePack(Drive4Wheel::DRIVE_STOP, 0, 0) :
+		(tableInX(x) && y < Y_THRESHOLD_LOW) ? tablePack(Drive4Wheel::DRIVE_BACKWARD, tableFraction(y, Y_THRESHOLD_LOW, 0), 0) :
+		(tableInX(x) && y > Y_THRESHOLD_HIGH) ? tablePack(Drive4Wheel::DRIVE_FORWARD, tableFraction(y, Y_THRESHOLD_HIGH, 255), 0) :
+		(tableInY(y) && x < X_THRESHOLD_LOW) ? tablePack(Drive4Wheel::DRIVE_LEFT, tableFraction(x, X_THRESHOLD_LOW, 0), 0) :
+		(tableInY(y) && x > X_THRESHOLD_HIGH) ? tablePack(Drive4Wheel::DRIVE_RIGHT, tableFraction(x, X_THRESHOLD_HIGH, 255), 0) :
+		(x < X_THRESHOLD_LOW && y > Y_THRESHOLD_HIGH) ?
+			tablePack(Drive4Wheel::DRIVE_FORWARD_LEFT, tableFraction(y, Y_THRESHOLD_HIGH, 255), tableFraction(x, X_THRESHOLD_LOW, 0)) :
+		(x < X_THRESHOLD_LOW && y < Y_THRESHOLD_LOW) ?
+			tablePack(Drive4Wheel::DRIVE_BACKWARD_LEFT, tableFraction(y, Y_THRESHOLD_LOW, 0), tableFraction(x, X_THRESHOLD_LOW, 0)) :
+		(x > X_THRESHOLD_HIGH && y > Y_THRESHOLD_HIGH) ?
+			tablePack(Drive4Wheel::DRIVE_FORWARD_RIGHT, tableFraction(y, Y_THRESHOLD_HIGH, 255), tableFraction(x, X_THRESHOLD_HIGH, 255)) :
+		(x > X_THRESHOLD_HIGH && y < Y_THRESHOLD_LOW) ?
+			tablePack(Drive4Wheel::DRIVE_BACKWARD_RIGHT, tableFraction(y, Y_THRESHOLD_LOW, 0), tableFraction(x, X_THRESHOLD_HIGH, 255)) :
+		tablePack(Drive4Wheel::DRIVE_STOP, 0, 0);
+}
+
+#define JOYSTICK_TABLE_ENTRY(bx, by) tableEntry(tableBucketValue(bx), tableBucketValue(by))
+#define JOYSTICK_TABLE_ROW(by) \
+	JOYSTICK_TABLE_ENTRY(0, by), JOYSTICK_TABLE_ENTRY(1, by), JOYSTICK_TABLE_ENTRY(2, by), JOYSTICK_TABLE_ENTRY(3, by), JOYSTICK_TABLE_ENTRY(4, by), JOYSTICK_TABLE_ENTRY(5, by), JOYSTICK_TABLE_ENTRY(6, by), JOYSTICK_TABLE_ENTRY(7, by), \
+	JOYSTICK_TABLE_ENTRY(8, by), JOYSTICK_TABLE_ENTRY(9, by), JOYSTICK_TABLE_ENTRY(10, by), JOYSTICK_TABLE_ENTRY(11, by), JOYSTICK_TABLE_ENTRY(12, by), JOYSTICK_TABLE_ENTRY(13, by), JOYSTICK_TABLE_ENTRY(14, by), JOYSTICK_TABLE_ENTRY(15, by), \
+	JOYSTICK_TABLE_ENTRY(16, by), JOYSTICK_TABLE_ENTRY(17, by), JOYSTICK_TABLE_ENTRY(18, by), JOYSTICK_TABLE_ENTRY(19, by), JOYSTICK_TABLE_ENTRY(20, by), JOYSTICK_TABLE_ENTRY(21, by), JOYSTICK_TABLE_ENTRY(22, by), JOYSTICK_TABLE_ENTRY(23, by), \
+	JOYSTICK_TABLE_ENTRY(24, by), JOYSTICK_TABLE_ENTRY(25, by), JOYSTICK_TABLE_ENTRY(26, by), JOYSTICK_TABLE_ENTRY(27, by), JOYSTICK_TABLE_ENTRY(28, by), JOYSTICK_TABLE_ENTRY(29, by), JOYSTICK_TABLE_ENTRY(30, by)
+static_assert(JOYSTICK_TABLE_BUCKETS == 31, "JOYSTICK_TABLE_ROW and JOYSTICK_TABLE list 31 buckets");
+
+//indexed [bucketY * JOYSTICK_TABLE_BUCKETS + bucketX], 3.8 kB of flash
+const uint32_t JOYSTICK_TABLE[JOYSTICK_TABLE_BUCKETS * JOYSTICK_TABLE_BUCKETS] PROGMEM = {
+	JOYSTICK_TABLE_ROW(0), JOYSTICK_TABLE_ROW(1), JOYSTICK_TABLE_ROW(2), JOYSTICK_TABLE_ROW(3), JOYSTICK_TABLE_ROW(4), JOYSTICK_TABLE_ROW(5), JOYSTICK_TABLE_ROW(6), JOYSTICK_TABLE_ROW(7),
+	JOYSTICK_TABLE_ROW(8), JOYSTICK_TABLE_ROW(9), JOYSTICK_TABLE_ROW(10), JOYSTICK_TABLE_ROW(11), JOYSTICK_TABLE_ROW(12), JOYSTICK_TABLE_ROW(13), JOYSTICK_TABLE_ROW(14), JOYSTICK_TABLE_ROW(15),
+	JOYSTICK_TABLE_ROW(16), JOYSTICK_TABLE_ROW(17), JOYSTICK_TABLE_ROW(18), JOYSTICK_TABLE_ROW(19), JOYSTICK_TABLE_ROW(20), JOYSTICK_TABLE_ROW(21), JOYSTICK_TABLE_ROW(22), JOYSTICK_TABLE_ROW(23),
+	JOYSTICK_TABLE_ROW(24), JOYSTICK_TABLE_ROW(25), JOYSTICK_TABLE_ROW(26), JOYSTICK_TABLE_ROW(27), JOYSTICK_TABLE_ROW(28), JOYSTICK_TABLE_ROW(29), JOYSTICK_TABLE_ROW(30)
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+//default constructor: stores the address of the drive to be commanded and the sway turn ratio range
+JoystickDrive::JoystickDrive(Drive4Wheel& drive, uint8_t smallestRatio, uint8_t biggestRatio)
+	:_drive(&drive), _smallestRatio(percentToSpeedRatioQ8(smallestRatio)), _biggestRatio(percentToSpeedRatioQ8(biggestRatio)) {
+	_refreshTableScaling();
+}
+
+bool JoystickDrive::drivePrimary(int joystickX, int joystickY) {
+	if (_lookupTableEnabled) {
+		driveFromTable(joystickX, joystickY);
+		return true;
+	}
+
+	//boolean conditions for the threshold regions
+	bool joystickXInThreshold = (joystickX > X_THRESHOLD_LOW && joystickX < X_THRESHOLD_HIGH);
+	bool joystickYInThreshold = (joystickY > Y_THRESHOLD_LOW && joystickY < Y_THRESHOLD_HIGH);
+
+	//if joystick not in the threshold region the Secondary controls have to handle it
+	if (!joystickXInThreshold && !joystickYInThreshold) return false;
+
+	//initializes the current allowable driveSpeeds as temp variable
+	int minSpeed = _drive->getDriveSpeed(MIN);
+	int maxSpeed = _drive->getDriveSpeed(MAX);
+
+	// temp variable
+	int speed;
+
+	//various statement to check the appropriate Primary actions
+	if (joystickXInThreshold && joystickYInThreshold) {
+		_drive->stop();	//stop the drive if in absolute center
+	}
+	else if (joystickY < Y_THRESHOLD_LOW && joystickXInThreshold) {
+		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed); //map speed between joystick coordinate and allowable drive Speeds
+		_drive->goBackward(speed);
+	}
+	else if (joystickY > Y_THRESHOLD_HIGH && joystickXInThreshold) {
+		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
+		_drive->goForward(speed);
+	}
+	else if (joystickX < X_THRESHOLD_LOW && joystickYInThreshold) {
+		speed = map(joystickX, X_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
+		_drive->goLeft(speed);
+	}
+	else if (joystickX > X_THRESHOLD_HIGH && joystickYInThreshold) {
+		speed = map(joystickX, X_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
+		_drive->goRight(speed);
+	}
+	else _drive->stop(); //just in case call stop always
+
+	return true;
+}
+
+void JoystickDrive::driveSecondary(int joystickX, int joystickY) {
+	//initializes the current allowable drive Speeds
+	int minSpeed = _drive->getDriveSpeed(MIN);
+	int maxSpeed = _drive->getDriveSpeed(MAX);
+
+	//temp variables
+	int speed;
+	SpeedRatioQ8 turnRatio;
+
+	//various statements to check for the Secondary conditions
+	if (joystickX < X_THRESHOLD_LOW && joystickY > Y_THRESHOLD_HIGH) {
+		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
+		turnRatio.raw = map(joystickX, X_THRESHOLD_LOW, 0, _smallestRatio.raw, _biggestRatio.raw); //map speed ratio directly in Q8.8
+		_drive->swayLeft(speed, turnRatio);
+	}
+	else if (joystickX < X_THRESHOLD_LOW && joystickY < Y_THRESHOLD_LOW) {
+		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
+		turnRatio.raw = map(joystickX, X_THRESHOLD_LOW, 0, _smallestRatio.raw, _biggestRatio.raw);
+		_drive->swayLeft(speed, turnRatio, true);
+	}
+	else if (joystickX > X_THRESHOLD_HIGH && joystickY > Y_THRESHOLD_HIGH) {
+		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
+		turnRatio.raw = map(joystickX, X_THRESHOLD_HIGH, 255, _smallestRatio.raw, _biggestRatio.raw);
+		_drive->swayRight(speed, turnRatio);
+	}
+	else if (joystickX > X_THRESHOLD_HIGH && joystickY < Y_THRESHOLD_LOW) {
+		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
+		turnRatio.raw = map(joystickX, X_THRESHOLD_HIGH, 255, _smallestRatio.raw, _biggestRatio.raw);
+		_drive->swayRight(speed, turnRatio, true);
+	}
+	else _drive->stop();
+}
+
+void JoystickDrive::drive(int joystickX, int joystickY) {
+	if (_mixingEnabled) {
+		driveMixed(joystickX, joystickY);
+		return;
+	}
+	if (!drivePrimary(joystickX, joystickY)) driveSecondary(joystickX, joystickY);
+}
+
+void JoystickDrive::driveFromTable(int joystickX, int joystickY) {
+	if (_tableRevision != _drive->getDriveSpeedRevision()) _refreshTableScaling(); //setSpeedToleranceRange() was called
+
+	uint8_t bucketX = joystickTableBucket(constrain(joystickX, 0, 255));
+	uint8_t bucketY = joystickTableBucket(constrain(joystickY, 0, 255));
+	uint32_t entry = pgm_read_dword(&JOYSTICK_TABLE[(bucketY * JOYSTICK_TABLE_BUCKETS) + bucketX]);
+
+	Drive4Wheel::DriveState driveState = (Drive4Wheel::DriveState)(entry & 0xFF);
+	uint8_t speedFraction = (entry >> 8) & 0xFF;
+	uint8_t ratioFraction = (entry >> 16) & 0xFF;
+
+	//span * (fraction + 1) / 256 reaches the full span at fraction 255 without a division
+	int speed = _tableMinSpeed + (((uint16_t)_tableSpeedSpan * speedFraction + _tableSpeedSpan) >> 8);
+	SpeedRatioQ8 speedRatio = toSpeedRatioQ8(1.0); //turns use the full ratio, like goLeft(speed)
+	if (driveState >= Drive4Wheel::DRIVE_FORWARD_LEFT) {
+		uint16_t ratioSpan = _biggestRatio.raw - _smallestRatio.raw;
+		speedRatio.raw = _smallestRatio.raw + ((ratioSpan * ratioFraction + ratioSpan) >> 8);
+	}
+
+	_drive->applyDriveState(driveState, speed, speedRatio);
+}
+
+void JoystickDrive::useLookupTable(bool enable) {
+	_lookupTableEnabled = enable;
+}
+
+bool JoystickDrive::isLookupTableEnabled() {
+	return _lookupTableEnabled;
+}
+
+//joystick axis to a -255 to 255 command, zero inside the threshold region around the center
+static int joystickAxisCommand(int value, byte thresholdLow, byte thresholdHigh) {
+	value = constrain(value, 0, 255);
+	if (value >= thresholdHigh) return (int)((long)(value - thresholdHigh + 1) * 255 / (256 - thresholdHigh));
+	if (value <= thresholdLow) return -(int)((long)(thresholdLow - value + 1) * 255 / (thresholdLow + 1));
+	return 0;
+}
+
+void JoystickDrive::driveMixed(int joystickX, int joystickY) {
+	int linear = joystickAxisCommand(joystickY, Y_THRESHOLD_LOW, Y_THRESHOLD_HIGH);
+	int angular = -joystickAxisCommand(joystickX, X_THRESHOLD_LOW, X_THRESHOLD_HIGH); //joystick left turns left
+	_drive->driveMix(linear, angular);
+}
+
+void JoystickDrive::useMixing(bool enable) {
+	_mixingEnabled = enable;
+}
+
+bool JoystickDrive::isMixingEnabled() {
+	return _mixingEnabled;
+}
+
+//caches the drive speeds used to scale the normalized table values
+void JoystickDrive::_refreshTableScaling() {
+	_tableMinSpeed = _drive->getDriveSpeed(MIN);
+	_tableSpeedSpan = _drive->getDriveSpeed(MAX) - _tableMinSpeed;
+	_tableRevision = _drive->getDriveSpeedRevision();
+}
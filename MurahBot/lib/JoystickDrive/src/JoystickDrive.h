@@ -0,0 +1,79 @@
+// JoystickDrive.h
+#include <Arduino.h>
+#include <Wheels.h>
+
+#ifndef _JOYSTICKDRIVE_h
+#define _JOYSTICKDRIVE_h
+
+//constant values for jostick pad region
+const byte X_THRESHOLD_LOW = 108; //X: 128 - 20
+const byte X_THRESHOLD_HIGH = 148; //X: 128 + 20
+const byte Y_THRESHOLD_LOW = 108;
+const byte Y_THRESHOLD_HIGH = 148;
+
+//the lookup table quantizes each axis into buckets of 8 joystick counts that start at the thresholds:
+//14 below the low threshold, one for each threshold value (neither center nor outside, they stop the
+//drive), one for the whole center region and 14 above the high threshold. no bucket straddles a
+//region, so the table picks the same drive state as the threshold branches for every joystick sample
+const uint8_t JOYSTICK_TABLE_SHIFT = 3;
+const uint8_t JOYSTICK_TABLE_LOW_EDGE = ((X_THRESHOLD_LOW - 1) >> JOYSTICK_TABLE_SHIFT) + 1;
+const uint8_t JOYSTICK_TABLE_CENTER = JOYSTICK_TABLE_LOW_EDGE + 1;
+const uint8_t JOYSTICK_TABLE_HIGH_EDGE = JOYSTICK_TABLE_CENTER + 1;
+const uint8_t JOYSTICK_TABLE_BUCKETS = JOYSTICK_TABLE_HIGH_EDGE + 1 + ((255 - X_THRESHOLD_HIGH - 1) >> JOYSTICK_TABLE_SHIFT) + 1;
+static_assert(X_THRESHOLD_LOW == Y_THRESHOLD_LOW && X_THRESHOLD_HIGH == Y_THRESHOLD_HIGH,
+	"the lookup table buckets both axes the same way");
+
+//bucket of one joystick axis value (0-255) in the lookup table
+inline uint8_t joystickTableBucket(uint8_t value) {
+	if (value < X_THRESHOLD_LOW) return value >> JOYSTICK_TABLE_SHIFT;
+	if (value == X_THRESHOLD_LOW) return JOYSTICK_TABLE_LOW_EDGE;
+	if (value < X_THRESHOLD_HIGH) return JOYSTICK_TABLE_CENTER;
+	if (value == X_THRESHOLD_HIGH) return JOYSTICK_TABLE_HIGH_EDGE;
+	return JOYSTICK_TABLE_HIGH_EDGE + 1 + ((value - X_THRESHOLD_HIGH - 1) >> JOYSTICK_TABLE_SHIFT);
+}
+
+//class to translate the joystick coordinates (0-255 on each axis) into Drive4Wheel commands
+//kept free of Blynk and TaskScheduler so the same decision logic runs on the robot and on the host
+class JoystickDrive {
+public:
+	JoystickDrive(Drive4Wheel& drive, uint8_t smallestRatio = 45, uint8_t biggestRatio = 60); //ratios as a multiple of 100
+
+	//updates the Primary controls for Joystick in four directions: Front, Back, Left, Right
+	//returns false without driving if the joystick is in a Secondary (diagonal) region
+	bool drivePrimary(int joystickX, int joystickY);
+
+	//updates the Secondary controls for Joystick: Sway Left and Right in Forward and Backward
+	void driveSecondary(int joystickX, int joystickY);
+
+	//Primary and Secondary controls evaluated in a single pass
+	void drive(int joystickX, int joystickY);
+
+	//drives from the precomputed PROGMEM table: two threshold compares per axis, one table fetch and one
+	//Drive4Wheel apply per sample
+	//all the regions are covered, so drivePrimary() never hands over to driveSecondary() when enabled
+	void driveFromTable(int joystickX, int joystickY);
+	void useLookupTable(bool enable);
+	bool isLookupTableEnabled();
+
+	//continuous mode: Y is the linear and X the angular command of Drive4Wheel::driveMix(), one pass per
+	//sample and no discrete drive states. the center threshold region stays a dead zone on each axis
+	//takes precedence over the lookup table and the threshold branches in drive() when enabled
+	void driveMixed(int joystickX, int joystickY);
+	void useMixing(bool enable);
+	bool isMixingEnabled();
+
+private:
+	Drive4Wheel* _drive;
+	bool _lookupTableEnabled = false;
+	bool _mixingEnabled = false;
+
+	//scaling of the normalized table values, refreshed when the drive speed revision changes
+	void _refreshTableScaling();
+	uint8_t _tableRevision;
+	int _tableMinSpeed;
+	uint16_t _tableSpeedSpan;
+	SpeedRatioQ8 _smallestRatio; //ratio range for the sway speedRatios, Q8.8 so no float math per sample
+	SpeedRatioQ8 _biggestRatio;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+
+#include "SharedJoystick.h"
+
+//keeps the compiler from moving memory accesses across it, the ATmega2560 itself does not reorder
+static inline void compilerBarrier() {
+	asm volatile("" ::: "memory");
+}
+
+//default constructor: the center sample, sequence 0 (no sample yet)
+SharedJoystick::SharedJoystick(uint8_t x, uint8_t y)
+	:_version(0), _x(x), _y(y), _timeUs(0), _sequence(0), _lastConsumed(0) {
+	resetCounters();
+}
+
+void SharedJoystick::write(uint8_t x, uint8_t y) {
+	writeAt(micros(), x, y);
+}
+
+void SharedJoystick::writeAt(unsigned long timeUs, uint8_t x, uint8_t y) {
+	_version = _version + 1; //odd: readers in between discard their copy
+	compilerBarrier();
+	_x = x;
+	_y = y;
+	_timeUs = timeUs;
+	_sequence = _sequence + 1;
+	compilerBarrier();
+	_version = _version + 1;
+}
+
+bool SharedJoystick::tryRead(JoystickSnapshot& snapshot) const {
+	uint8_t version = _version;
+	if (version & 1) return false;
+	compilerBarrier();
+	snapshot.x = _x;
+	snapshot.y = _y;
+	snapshot.timeUs = _timeUs;
+	snapshot.sequence = _sequence;
+	compilerBarrier();
+	return _version == version;
+}
+
+//a write takes a few cycles, so a retry is rare and short
+void SharedJoystick::read(JoystickSnapshot& snapshot) const {
+	while (!tryRead(snapshot)) {
+	}
+}
+
+bool SharedJoystick::consume(JoystickSnapshot& snapshot) {
+	read(snapshot);
+	uint16_t newSamples = snapshot.sequence - _lastConsumed; //wraps with the sequence
+	if (newSamples == 0) return false;
+	_skipped += newSamples - 1;
+	_consumed++;
+	_lastConsumed = snapshot.sequence;
+	return true;
+}
+
+void SharedJoystick::resetCounters() {
+	_consumed = 0;
+	_skipped = 0;
+}
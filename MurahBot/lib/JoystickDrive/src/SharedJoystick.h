@@ -0,0 +1,53 @@
+// SharedJoystick.h
+#include <Arduino.h>
+
+#ifndef _SHAREDJOYSTICK_h
+#define _SHAREDJOYSTICK_h
+
+//one joystick sample as the drive sees it
+struct JoystickSnapshot {
+	uint8_t x;
+	uint8_t y;
+	unsigned long timeUs; //micros() of the arrival
+	uint16_t sequence; //+1 per sample written, 0 before the first one
+};
+
+//the latest joystick sample shared between ONE writer (the Blynk handler, the command link, or an ISR)
+//and the drive tasks, without masking interrupts. a sequence lock: the writer makes _version odd,
+//writes the fields and makes it even again. a reader copies the fields between two reads of _version
+//and keeps the copy only if _version was even and unchanged, so X, Y and the time always belong to
+//the same sample, never an X of one sample with the Y of the next.
+//read() retries until it gets a clean copy: it must not run in an ISR that can interrupt the writer,
+//such a reader uses tryRead() and keeps its last snapshot when it fails
+class SharedJoystick {
+public:
+	SharedJoystick(uint8_t x = 127, uint8_t y = 127);
+
+	void write(uint8_t x, uint8_t y); //timestamped with micros()
+	void writeAt(unsigned long timeUs, uint8_t x, uint8_t y);
+
+	bool tryRead(JoystickSnapshot& snapshot) const; //false if a write overlapped the copy
+	void read(JoystickSnapshot& snapshot) const;
+	uint16_t getSequence() const { return _sequence; }
+
+	//the consumer's read: true if the sample is newer than the one of its last consume(), the samples
+	//written in between and never consumed are counted as skipped. one consumer (the drive task)
+	bool consume(JoystickSnapshot& snapshot);
+	unsigned long getConsumed() { return _consumed; }
+	unsigned long getSkipped() { return _skipped; }
+	void resetCounters();
+
+private:
+	volatile uint8_t _version; //odd while a write is in progress, a single byte so its reads are atomic
+	volatile uint8_t _x;
+	volatile uint8_t _y;
+	volatile unsigned long _timeUs;
+	volatile uint16_t _sequence;
+
+	//consumer side, only touched by consume()
+	uint16_t _lastConsumed;
+	unsigned long _consumed;
+	unsigned long _skipped;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Crc8.h>
+
+#include "JoystickRecorder.h"
+
+const uint8_t recorderEepromVersion = 1;
+
+//default constructor: empty and not recording
+JoystickRecorder::JoystickRecorder()
+	:_recording(false) {
+	clear();
+}
+
+void JoystickRecorder::start() {
+	clear();
+	_recording = true;
+}
+
+void JoystickRecorder::stop() {
+	_recording = false;
+}
+
+void JoystickRecorder::record(uint8_t x, uint8_t y) {
+	if (_recording) recordAt(millis(), x, y);
+}
+
+void JoystickRecorder::recordAt(unsigned long timeMs, uint8_t x, uint8_t y) {
+	unsigned long delta = _hasLast ? timeMs - _lastMs : 0;
+	_records[_next].deltaMs = (delta > 0xFFFF) ? 0xFFFF : (uint16_t)delta;
+	_records[_next].x = x;
+	_records[_next].y = y;
+	_next = (_next + 1) % CAPACITY;
+	if (_count < CAPACITY) _count++;
+	else _overwritten++;
+	_hasLast = true;
+	_lastMs = timeMs;
+}
+
+void JoystickRecorder::clear() {
+	_next = 0;
+	_count = 0;
+	_hasLast = false;
+	_lastMs = 0;
+	_overwritten = 0;
+}
+
+JoystickRecord JoystickRecorder::get(uint16_t index) const {
+	uint16_t oldest = (_next + CAPACITY - _count) % CAPACITY;
+	return _records[(oldest + index) % CAPACITY];
+}
+
+void JoystickRecorder::save(int address) const {
+	uint8_t crc = 0;
+	uint8_t header[5] = { 'J', 'R', recorderEepromVersion, (uint8_t)(_count & 0xFF), (uint8_t)(_count >> 8) };
+	for (uint8_t i = 0; i < 5; i++) {
+		EEPROM.update(address++, header[i]);
+		crc = crc8Update(crc, header[i]);
+	}
+	for (uint16_t i = 0; i < _count; i++) {
+		JoystickRecord record = get(i);
+		const uint8_t* bytes = (const uint8_t*)&record;
+		for (uint8_t b = 0; b < sizeof(JoystickRecord); b++) {
+			EEPROM.update(address++, bytes[b]);
+			crc = crc8Update(crc, bytes[b]);
+		}
+	}
+	EEPROM.update(address, crc);
+}
+
+bool JoystickRecorder::load(int address) {
+	clear();
+	_recording = false;
+	uint8_t crc = 0;
+	uint8_t header[5];
+	for (uint8_t i = 0; i < 5; i++) {
+		header[i] = EEPROM.read(address++);
+		crc = crc8Update(crc, header[i]);
+	}
+	uint16_t count = header[3] | ((uint16_t)header[4] << 8);
+	if (header[0] != 'J' || header[1] != 'R' || header[2] != recorderEepromVersion || count > CAPACITY) return false;
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t* bytes = (uint8_t*)&_records[i];
+		for (uint8_t b = 0; b < sizeof(JoystickRecord); b++) {
+			bytes[b] = EEPROM.read(address++);
+			crc = crc8Update(crc, bytes[b]);
+		}
+	}
+	if (EEPROM.read(address) != crc) return false; //_count is still 0, the partial copy is not used
+	_count = count;
+	_next = count % CAPACITY;
+	return true;
+}
+
+//default constructor: plays the recorder's current samples
+JoystickReplay::JoystickReplay(const JoystickRecorder& recorder)
+	:_recorder(recorder), _running(false), _index(0), _nextDue(0) {
+}
+
+void JoystickReplay::start() {
+	_index = 0;
+	_nextDue = millis(); //the first sample right away, its gap is to the previous recording
+	_running = _recorder.getCount() > 0;
+}
+
+void JoystickReplay::stop() {
+	_running = false;
+}
+
+bool JoystickReplay::poll(uint8_t& x, uint8_t& y) {
+	if (!_running || (long)(millis() - _nextDue) < 0) return false;
+	JoystickRecord record = _recorder.get(_index++);
+	x = record.x;
+	y = record.y;
+	if (_index >= _recorder.getCount()) _running = false;
+	else _nextDue += _recorder.get(_index).deltaMs;
+	return true;
+}
+
+unsigned long JoystickReplay::getTimeToNext() {
+	long remaining = (long)(_nextDue - millis());
+	return (remaining > 0) ? remaining : 0;
+}
@@ -0,0 +1,72 @@
+// JoystickRecorder.h
+#include <Arduino.h>
+
+#ifndef _JOYSTICKRECORDER_h
+#define _JOYSTICKRECORDER_h
+
+//one joystick sample as recorded: 4 bytes, the time is kept as the gap to the previous sample
+struct JoystickRecord {
+	uint16_t deltaMs; //ms since the previous sample, saturates at 65535
+	uint8_t x;
+	uint8_t y;
+};
+
+//records the timestamped joystick samples into a RAM ring, the oldest are overwritten, so the ring
+//holds the last CAPACITY samples before a field issue (about 10 s of a 25 Hz joystick)
+//save() copies them to the EEPROM, which keeps them over a reset
+class JoystickRecorder {
+public:
+	static const uint16_t CAPACITY = 256;
+
+	JoystickRecorder();
+
+	void start(); //clears the ring and records from the next sample
+	void stop();
+	bool isRecording() { return _recording; }
+
+	void record(uint8_t x, uint8_t y); //timestamped with millis(), only while recording
+	void recordAt(unsigned long timeMs, uint8_t x, uint8_t y); //explicit time, for generated traces
+	void clear();
+
+	uint16_t getCount() const { return _count; }
+	JoystickRecord get(uint16_t index) const; //0 is the oldest sample
+	unsigned long getOverwritten() { return _overwritten; } //samples lost to the ring wrapping
+
+	//EEPROM image: "JR", version, count, the records and a CRC-8. only changed bytes are written,
+	//still about 3.4 ms per changed byte with interrupts running: save while the robot is stopped
+	static int getEepromSize() { return 6 + CAPACITY * sizeof(JoystickRecord); }
+	void save(int address) const;
+	bool load(int address); //false (and the ring cleared) if there is no valid recording
+
+private:
+	JoystickRecord _records[CAPACITY];
+	uint16_t _next; //index of the next write
+	uint16_t _count;
+	bool _recording;
+	bool _hasLast;
+	unsigned long _lastMs;
+	unsigned long _overwritten;
+};
+
+//replays a recording in real time, each sample after its recorded gap to the previous one
+//the gaps are added up from the start, so a late poll does not shift the samples after it
+class JoystickReplay {
+public:
+	JoystickReplay(const JoystickRecorder& recorder);
+
+	void start();
+	void stop();
+	bool isRunning() { return _running; }
+
+	//true when the next sample is due, with its values. call until it returns false
+	bool poll(uint8_t& x, uint8_t& y);
+	unsigned long getTimeToNext(); //ms until the next sample, 0 if it is due
+
+private:
+	const JoystickRecorder& _recorder;
+	bool _running;
+	uint16_t _index;
+	unsigned long _nextDue; //millis() of the next sample
+};
+
+#endif
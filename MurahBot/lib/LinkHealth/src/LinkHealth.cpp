@@ -0,0 +1,82 @@
+#include <Arduino.h>
+
+#include "LinkHealth.h"
+
+//default constructor: no samples yet, the input starts stale
+LinkHealth::LinkHealth(unsigned long staleTimeoutMs, unsigned long decayMs)
+	:_staleTimeout(staleTimeoutMs), _decay(decayMs) {
+	reset();
+}
+
+void LinkHealth::sample() {
+	unsigned long nowMicros = micros();
+	unsigned long nowMillis = millis();
+	if (_hasSample) {
+		unsigned long interval = nowMicros - _lastMicros;
+		if (nowMillis - _lastMillis > _staleTimeout) _staleEvents++; //an outage, not the input rate
+		else {
+			_intervals.add(interval);
+			if (_smoothedInterval == 0) _smoothedInterval = interval * 8;
+			unsigned long smoothed = _smoothedInterval / 8;
+			_jitter.add((interval > smoothed) ? interval - smoothed : smoothed - interval);
+			_smoothedInterval = _smoothedInterval - smoothed + interval;
+		}
+	}
+	_lastMicros = nowMicros;
+	_lastMillis = nowMillis;
+	_hasSample = true;
+}
+
+void LinkHealth::reset() {
+	_hasSample = false;
+	_lastMillis = 0;
+	_lastMicros = 0;
+	_smoothedInterval = 0;
+	_staleEvents = 0;
+	_intervals.reset();
+	_jitter.reset();
+}
+
+void LinkHealth::setTimeouts(unsigned long staleTimeoutMs, unsigned long decayMs) {
+	_staleTimeout = staleTimeoutMs;
+	_decay = decayMs;
+}
+
+bool LinkHealth::isStale() {
+	return !_hasSample || getAge() > _staleTimeout;
+}
+
+unsigned long LinkHealth::getAge() {
+	return millis() - _lastMillis;
+}
+
+unsigned long LinkHealth::getTimeToStale() {
+	if (!_hasSample) return 0;
+	unsigned long age = getAge();
+	return (age < _staleTimeout) ? _staleTimeout - age : 0;
+}
+
+uint16_t LinkHealth::getCommandScale() {
+	if (!_hasSample) return 0;
+	unsigned long age = getAge();
+	if (age <= _staleTimeout) return 256;
+	unsigned long decayed = age - _staleTimeout;
+	if (decayed >= _decay) return 0;
+	return (uint16_t)(256 - decayed * 256 / _decay);
+}
+
+unsigned long LinkHealth::getSmoothedInterval() {
+	return _smoothedInterval / 8;
+}
+
+TimingStats& LinkHealth::getIntervals() {
+	return _intervals;
+}
+
+TimingStats& LinkHealth::getJitter() {
+	return _jitter;
+}
+
+unsigned long LinkHealth::getStaleEvents() {
+	return _staleEvents;
+}
@@ -0,0 +1,45 @@
+// LinkHealth.h
+#include <Arduino.h>
+#include <TimingStats.h>
+
+#ifndef _LINKHEALTH_h
+#define _LINKHEALTH_h
+
+//arrival monitor of a periodic input (the joystick samples of the app)
+//every sample is timestamped, the intervals between them and their jitter are kept as TimingStats
+//and as a smoothed interval (1/8 exponential average) that a consumer can pace itself with.
+//once no sample arrived for the stale timeout the input is stale: getCommandScale() then falls
+//linearly from full to zero over the decay time, so a stalled link brings the robot to a stop
+class LinkHealth {
+public:
+	LinkHealth(unsigned long staleTimeoutMs, unsigned long decayMs);
+
+	void sample(); //call on every arrival
+	void reset(); //forgets the samples, the input is stale until the next one
+
+	void setTimeouts(unsigned long staleTimeoutMs, unsigned long decayMs);
+	unsigned long getStaleTimeout() { return _staleTimeout; }
+
+	bool isStale();
+	unsigned long getAge(); //ms since the last sample
+	unsigned long getTimeToStale(); //ms until the input goes stale, 0 if it is
+	uint16_t getCommandScale(); //Q8.8: 256 while fresh, 0 after the decay or without samples
+
+	unsigned long getSmoothedInterval(); //us, 0 until two samples arrived
+	TimingStats& getIntervals(); //us between samples, outages (gaps over the stale timeout) excluded
+	TimingStats& getJitter(); //us, deviation of each interval from the smoothed interval
+	unsigned long getStaleEvents(); //outages the link recovered from
+
+private:
+	unsigned long _staleTimeout; //ms
+	unsigned long _decay; //ms
+	bool _hasSample;
+	unsigned long _lastMillis;
+	unsigned long _lastMicros;
+	unsigned long _smoothedInterval; //us, times 8
+	unsigned long _staleEvents;
+	TimingStats _intervals;
+	TimingStats _jitter;
+};
+
+#endif
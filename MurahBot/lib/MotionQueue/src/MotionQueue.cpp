@@ -0,0 +1,77 @@
+#include <Arduino.h>
+
+#include "MotionQueue.h"
+
+//default constructor: empty queue, not running
+MotionQueue::MotionQueue(Drive4Wheel& drive) :_drive(&drive), _stepStart(0), _stepDuration(0) {
+}
+
+bool MotionQueue::push(const MotionPrimitive& primitive) {
+	if (_count == CAPACITY) return false;
+	_queue[_head] = primitive;
+	_head = (_head + 1) & (CAPACITY - 1);
+	_count++;
+	return true;
+}
+
+uint8_t MotionQueue::loadRoute(const MotionPrimitive* route, uint8_t count) {
+	uint8_t queued = 0;
+	for (; queued < count; queued++) {
+		MotionPrimitive primitive;
+		memcpy_P(&primitive, &route[queued], sizeof(MotionPrimitive));
+		if (!push(primitive)) break;
+	}
+	return queued;
+}
+
+uint8_t MotionQueue::getQueued() {
+	return _count;
+}
+
+void MotionQueue::clear() {
+	_tail = _head;
+	_count = 0;
+}
+
+void MotionQueue::start() {
+	if (_running) return;
+	_stepStart = millis();
+	_running = _startNext();
+}
+
+void MotionQueue::abort() {
+	clear();
+	if (_running) _drive->stop();
+	_running = false;
+}
+
+bool MotionQueue::isRunning() {
+	return _running;
+}
+
+//moves on to the next step once the running one has lasted its duration
+unsigned long MotionQueue::update() {
+	if (!_running) return 0;
+	unsigned long now = millis();
+	while (now - _stepStart >= _stepDuration) {
+		_stepStart += _stepDuration; //planned, not actual, end of the step
+		if (!_startNext()) {
+			_drive->stop();
+			_running = false;
+			return 0;
+		}
+	}
+	return _stepDuration - (now - _stepStart);
+}
+
+//private method applying the step at the tail of the queue
+bool MotionQueue::_startNext() {
+	if (_count == 0) return false;
+	MotionPrimitive& step = _queue[_tail];
+	if (step.kind == MotionPrimitive::MOTION_MIX) _drive->driveMix(step.a, step.b);
+	else _drive->applyDriveState(step.state, step.a, SpeedRatioQ8{ (uint16_t)step.b });
+	_stepDuration = step.durationMs;
+	_tail = (_tail + 1) & (CAPACITY - 1);
+	_count--;
+	return true;
+}
@@ -0,0 +1,68 @@
+// MotionQueue.h
+#include <Arduino.h>
+#include <Wheels.h>
+
+#ifndef _MOTIONQUEUE_h
+#define _MOTIONQUEUE_h
+
+//one timed motion step, 8 bytes
+//MOTION_DRIVE: applyDriveState(state, speed, ratio), MOTION_MIX: driveMix(linear, angular)
+struct MotionPrimitive {
+	enum Kind : uint8_t {
+		MOTION_DRIVE, MOTION_MIX
+	};
+	Kind kind;
+	Drive4Wheel::DriveState state; //MOTION_DRIVE only
+	int16_t a; //speed (MOTION_DRIVE) or linear (MOTION_MIX)
+	int16_t b; //ratio as raw Q8.8 (MOTION_DRIVE) or angular (MOTION_MIX)
+	uint16_t durationMs;
+};
+
+//builders for the primitives, usable in PROGMEM route tables
+constexpr MotionPrimitive motionDrive(Drive4Wheel::DriveState state, int16_t speed, uint16_t durationMs,
+	SpeedRatioQ8 speedRatio = toSpeedRatioQ8(1.0)) {
+	return MotionPrimitive{ MotionPrimitive::MOTION_DRIVE, state, speed, (int16_t)speedRatio.raw, durationMs };
+}
+constexpr MotionPrimitive motionMix(int16_t linear, int16_t angular, uint16_t durationMs) {
+	return MotionPrimitive{ MotionPrimitive::MOTION_MIX, Drive4Wheel::DRIVE_STOP, linear, angular, durationMs };
+}
+constexpr MotionPrimitive motionStop(uint16_t durationMs) {
+	return motionDrive(Drive4Wheel::DRIVE_STOP, 0, durationMs);
+}
+
+//fixed capacity queue of motion primitives executed in order against a Drive4Wheel
+//the steps are timed from the planned end of the previous step, not from when update() ran,
+//so scheduler delays do not add up over a route. commands can be queued (or streamed in over the link)
+//ahead of their execution, the drive is stopped when the queue runs empty
+class MotionQueue {
+public:
+	static const uint8_t CAPACITY = 16; //steps, power of 2, all of them usable
+
+	MotionQueue(Drive4Wheel& drive);
+
+	bool push(const MotionPrimitive& primitive); //false if the queue is full
+	uint8_t loadRoute(const MotionPrimitive* route, uint8_t count); //route in PROGMEM, returns the steps queued
+	uint8_t getQueued(); //steps waiting, the running one excluded
+	void clear(); //drops the waiting steps
+
+	void start(); //starts with the first queued step
+	void abort(); //clears the queue and stops the drive
+	bool isRunning();
+
+	//executes the due steps, returns the ms until the next step starts (0 if not running)
+	unsigned long update();
+
+private:
+	Drive4Wheel* _drive;
+	MotionPrimitive _queue[CAPACITY];
+	uint8_t _head = 0; //next free slot
+	uint8_t _tail = 0; //next step to run
+	uint8_t _count = 0; //steps waiting, tells a full queue from an empty one when _head == _tail
+	bool _running = false;
+	unsigned long _stepStart; //planned start of the running step, ms
+	uint16_t _stepDuration;
+
+	bool _startNext(); //applies the next step, false if there is none
+};
+
+#endif
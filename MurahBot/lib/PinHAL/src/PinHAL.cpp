@@ -0,0 +1,406 @@
+#include "PinHAL.h"
+
+PortBatch::PortBatch() {
+	clear();
+}
+
+void PortBatch::clear() {
+	_portCount = 0;
+	_pwmCount = 0;
+}
+
+//stages a direction pin level, pins of the same port share one PortWrite
+void PortBatch::stage(OutputPin& pin, bool level) {
+	uint8_t bitMask;
+	PortWrite* portWrite = _findPort(pin, bitMask);
+	if (portWrite == 0) { //invalid pin or more ports than MAX_PORTS
+		pin.write(level);
+		return;
+	}
+	if (level) {
+		portWrite->setMask |= bitMask;
+		portWrite->clearMask &= ~bitMask;
+	}
+	else {
+		portWrite->clearMask |= bitMask;
+		portWrite->setMask &= ~bitMask;
+	}
+}
+
+//stages a PWM duty, the duties are written in staging order
+void PortBatch::stagePwm(PwmPin& pin, uint8_t duty) {
+	if (_pwmCount == MAX_PWM_PINS) {
+		pin.write(duty);
+		return;
+	}
+	_pwmPins[_pwmCount] = &pin;
+	_pwmDuty[_pwmCount] = duty;
+	_pwmCount++;
+}
+
+#ifdef ARDUINO
+
+///////////////////////////////////////////////////////////////////////////////
+//PwmPin direct timer register driver
+
+//the Arduino core runs every timer at TOP 255 (8 bit PWM), about 490 Hz (980 Hz on Timer0)
+uint16_t PwmPin::_timerTop[6] = { 255, 255, 255, 255, 255, 255 };
+unsigned long PwmPin::_timerFrequency[6] = { 976, 490, 490, 490, 490, 490 };
+
+//same pin to timer mapping as the core's analogWrite(), resolved once
+void PwmPin::begin() {
+	pinMode(_pin, OUTPUT);
+	if (_pin < 0 || _pin >= NUM_DIGITAL_PINS) return;
+	digitalWrite(_pin, LOW); //PORT bit LOW, the pin idles LOW while the compare output is disconnected
+
+	switch (digitalPinToTimer(_pin)) {
+#if defined(TCCR0A) && defined(COM0A1)
+	case TIMER0A: _tccrA = &TCCR0A; _comMask = _BV(COM0A1); _ocr8 = &OCR0A; _timer = 1; break;
+#endif
+#if defined(TCCR0A) && defined(COM0B1)
+	case TIMER0B: _tccrA = &TCCR0A; _comMask = _BV(COM0B1); _ocr8 = &OCR0B; _timer = 1; break;
+#endif
+#if defined(TCCR1A) && defined(COM1A1)
+	case TIMER1A: _tccrA = &TCCR1A; _comMask = _BV(COM1A1); _ocr16 = &OCR1A; _timer = 2; break;
+#endif
+#if defined(TCCR1A) && defined(COM1B1)
+	case TIMER1B: _tccrA = &TCCR1A; _comMask = _BV(COM1B1); _ocr16 = &OCR1B; _timer = 2; break;
+#endif
+#if defined(TCCR1A) && defined(COM1C1)
+	case TIMER1C: _tccrA = &TCCR1A; _comMask = _BV(COM1C1); _ocr16 = &OCR1C; _timer = 2; break;
+#endif
+#if defined(TCCR2A) && defined(COM2A1)
+	case TIMER2A: _tccrA = &TCCR2A; _comMask = _BV(COM2A1); _ocr8 = &OCR2A; _timer = 3; break;
+#endif
+#if defined(TCCR2A) && defined(COM2B1)
+	case TIMER2B: _tccrA = &TCCR2A; _comMask = _BV(COM2B1); _ocr8 = &OCR2B; _timer = 3; break;
+#endif
+#if defined(TCCR3A) && defined(COM3A1)
+	case TIMER3A: _tccrA = &TCCR3A; _comMask = _BV(COM3A1); _ocr16 = &OCR3A; _timer = 4; break;
+#endif
+#if defined(TCCR3A) && defined(COM3B1)
+	case TIMER3B: _tccrA = &TCCR3A; _comMask = _BV(COM3B1); _ocr16 = &OCR3B; _timer = 4; break;
+#endif
+#if defined(TCCR3A) && defined(COM3C1)
+	case TIMER3C: _tccrA = &TCCR3A; _comMask = _BV(COM3C1); _ocr16 = &OCR3C; _timer = 4; break;
+#endif
+#if defined(TCCR4A) && defined(COM4A1)
+	case TIMER4A: _tccrA = &TCCR4A; _comMask = _BV(COM4A1); _ocr16 = &OCR4A; _timer = 5; break;
+#endif
+#if defined(TCCR4A) && defined(COM4B1)
+	case TIMER4B: _tccrA = &TCCR4A; _comMask = _BV(COM4B1); _ocr16 = &OCR4B; _timer = 5; break;
+#endif
+#if defined(TCCR4A) && defined(COM4C1)
+	case TIMER4C: _tccrA = &TCCR4A; _comMask = _BV(COM4C1); _ocr16 = &OCR4C; _timer = 5; break;
+#endif
+#if defined(TCCR5A) && defined(COM5A1)
+	case TIMER5A: _tccrA = &TCCR5A; _comMask = _BV(COM5A1); _ocr16 = &OCR5A; _timer = 6; break;
+#endif
+#if defined(TCCR5A) && defined(COM5B1)
+	case TIMER5B: _tccrA = &TCCR5A; _comMask = _BV(COM5B1); _ocr16 = &OCR5B; _timer = 6; break;
+#endif
+#if defined(TCCR5A) && defined(COM5C1)
+	case TIMER5C: _tccrA = &TCCR5A; _comMask = _BV(COM5C1); _ocr16 = &OCR5C; _timer = 6; break;
+#endif
+	default: break; //not a PWM pin, write() falls back to analogWrite()
+	}
+	_connected = false;
+}
+
+void PwmPin::write(uint8_t duty) {
+	if (_timer == 0) {
+		analogWrite(_pin, duty);
+		return;
+	}
+	//a zero duty disconnects the compare output like analogWrite(0), Timer0 fast PWM would still pulse
+	if (duty == 0) {
+		if (_connected) {
+			*_tccrA &= ~_comMask;
+			_connected = false;
+		}
+		return;
+	}
+
+	uint8_t oldSREG = SREG;
+	noInterrupts(); //16 bit registers share the TEMP register with every other 16 bit timer access
+	if (_ocr8) *_ocr8 = duty;
+	else {
+		uint16_t top = _timerTop[_timer - 1];
+		//top * (duty + 1) / 256 reaches TOP at duty 255 and is the plain duty for the default TOP 255
+		*_ocr16 = (top == 255) ? duty : (uint16_t)(((uint32_t)top * duty + top) >> 8);
+	}
+	if (!_connected) {
+		*_tccrA |= _comMask;
+		_connected = true;
+	}
+	SREG = oldSREG;
+}
+
+//phase correct PWM with TOP = ICRn (mode 10): frequency = F_CPU / (2 * prescaler * TOP)
+//has to be called from setup(), the core's init() reconfigures the timers after the constructors ran
+bool PwmPin::setPwmFrequency(unsigned long frequency, uint16_t resolution) {
+	volatile uint8_t* tccrB;
+	volatile uint16_t* icr;
+	volatile uint16_t* tcnt;
+	switch (_timer) {
+#if defined(TCCR1B)
+	case 2: tccrB = &TCCR1B; icr = &ICR1; tcnt = &TCNT1; break;
+#endif
+#if defined(TCCR3B)
+	case 4: tccrB = &TCCR3B; icr = &ICR3; tcnt = &TCNT3; break;
+#endif
+#if defined(TCCR4B)
+	case 5: tccrB = &TCCR4B; icr = &ICR4; tcnt = &TCNT4; break;
+#endif
+#if defined(TCCR5B)
+	case 6: tccrB = &TCCR5B; icr = &ICR5; tcnt = &TCNT5; break;
+#endif
+	default: return false; //no timer, 8 bit timer or Timer0
+	}
+	if (frequency == 0 || resolution == 1) return false;
+
+	//with a resolution: the smallest prescaler whose frequency at that TOP is not above the request
+	//without: the smallest prescaler whose TOP fits in 16 bits, which is the highest resolution
+	static const uint16_t prescalers[5] = { 1, 8, 64, 256, 1024 };
+	uint8_t clockSelect = 0;
+	uint32_t top = 0;
+	for (uint8_t i = 0; i < 5; i++) {
+		uint32_t exactTop = F_CPU / (2UL * prescalers[i] * frequency);
+		if (resolution != 0) {
+			if (exactTop <= resolution || i == 4) {
+				top = resolution;
+				clockSelect = i + 1;
+				break;
+			}
+		}
+		else if (exactTop <= 0xFFFF) {
+			if (exactTop < 2) return false; //frequency too high for the timer
+			top = exactTop;
+			clockSelect = i + 1;
+			break;
+		}
+	}
+	if (clockSelect == 0) return false; //frequency too low for the timer
+
+	uint8_t oldSREG = SREG;
+	noInterrupts();
+	*tccrB = 0; //stops the timer
+	*_tccrA = (*_tccrA & ~(_BV(WGM10) | _BV(WGM11))) | _BV(WGM11);
+	*icr = top;
+	*tcnt = 0;
+	*tccrB = _BV(WGM13) | clockSelect;
+	_timerTop[_timer - 1] = top;
+	_timerFrequency[_timer - 1] = F_CPU / (2UL * prescalers[clockSelect - 1] * top);
+	SREG = oldSREG;
+	return true;
+}
+
+unsigned long PwmPin::getPwmFrequency() {
+	if (_timer == 0) return 0;
+	return _timerFrequency[_timer - 1];
+}
+
+uint16_t PwmPin::getPwmResolution() {
+	if (_timer == 0) return 0;
+	return _timerTop[_timer - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//PortBatch
+
+PortBatch::PortWrite* PortBatch::_findPort(OutputPin& pin, uint8_t& bitMask) {
+	volatile uint8_t* portRegister = pin.getPortRegister();
+	bitMask = pin.getBitMask();
+	if (portRegister == 0) return 0;
+	for (uint8_t i = 0; i < _portCount; i++) {
+		if (_ports[i].portRegister == portRegister) return &_ports[i];
+	}
+	if (_portCount == MAX_PORTS) return 0;
+	PortWrite* portWrite = &_ports[_portCount++];
+	portWrite->portRegister = portRegister;
+	portWrite->setMask = 0;
+	portWrite->clearMask = 0;
+	return portWrite;
+}
+
+//one read-modify-write per port with the interrupts masked, then the PWM duties
+void PortBatch::commit() {
+	uint8_t oldSREG = SREG;
+	noInterrupts();
+	for (uint8_t i = 0; i < _portCount; i++) {
+		*_ports[i].portRegister = (*_ports[i].portRegister & ~_ports[i].clearMask) | _ports[i].setMask;
+	}
+	for (uint8_t i = 0; i < _pwmCount; i++) _pwmPins[i]->write(_pwmDuty[i]);
+	SREG = oldSREG;
+	clear();
+}
+
+#else
+
+PortBatch::PortWrite* PortBatch::_findPort(OutputPin& pin, uint8_t& bitMask) {
+	int pinNumber = pin.getPin();
+	if (pinNumber < 0 || pinNumber >= PinHALMock::PIN_COUNT) return 0;
+	uint8_t port = pinNumber >> 3;
+	bitMask = 1 << (pinNumber & 7);
+	for (uint8_t i = 0; i < _portCount; i++) {
+		if (_ports[i].port == port) return &_ports[i];
+	}
+	if (_portCount == MAX_PORTS) return 0;
+	PortWrite* portWrite = &_ports[_portCount++];
+	portWrite->port = port;
+	portWrite->setMask = 0;
+	portWrite->clearMask = 0;
+	return portWrite;
+}
+
+void PortBatch::commit() {
+	for (uint8_t i = 0; i < _portCount; i++) {
+		PinHALMock::writePort(_ports[i].port, _ports[i].setMask, _ports[i].clearMask);
+	}
+	for (uint8_t i = 0; i < _pwmCount; i++) _pwmPins[i]->write(_pwmDuty[i]);
+	clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//PinHALMock backend
+
+#include <chrono>
+
+uint8_t PinHALMock::_pinMode[PinHALMock::PIN_COUNT];
+uint8_t PinHALMock::_pinLevel[PinHALMock::PIN_COUNT];
+uint8_t PinHALMock::_pwmDuty[PinHALMock::PIN_COUNT];
+unsigned long PinHALMock::_digitalWrites = 0;
+unsigned long PinHALMock::_portWrites = 0;
+unsigned long PinHALMock::_pwmWrites = 0;
+bool PinHALMock::_virtualClock = false;
+unsigned long PinHALMock::_virtualMicros = 0;
+
+//clears all the pin states and counters, the clock is left untouched
+void PinHALMock::reset() {
+	for (uint8_t i = 0; i < PIN_COUNT; i++) {
+		_pinMode[i] = INPUT;
+		_pinLevel[i] = LOW;
+		_pwmDuty[i] = 0;
+	}
+	_digitalWrites = 0;
+	_portWrites = 0;
+	_pwmWrites = 0;
+}
+
+bool PinHALMock::_validPin(int pin) {
+	return (pin >= 0 && pin < PIN_COUNT);
+}
+
+void PinHALMock::pinMode(int pin, uint8_t mode) {
+	if (!_validPin(pin)) return;
+	_pinMode[pin] = mode;
+	if (mode == INPUT_PULLUP) _pinLevel[pin] = HIGH; //an open input is pulled up, digitalWrite() drives it
+}
+
+void PinHALMock::digitalWrite(int pin, uint8_t level) {
+	_digitalWrites++;
+	if (!_validPin(pin)) return;
+	_pinLevel[pin] = level;
+}
+
+uint8_t PinHALMock::digitalRead(int pin) {
+	if (!_validPin(pin)) return LOW;
+	return _pinLevel[pin];
+}
+
+//same as the Arduino core, a 0 or 255 duty turns the pin fully LOW or HIGH
+void PinHALMock::analogWrite(int pin, int duty) {
+	_pwmWrites++;
+	if (!_validPin(pin)) return;
+	duty = constrain(duty, 0, 255);
+	_pwmDuty[pin] = duty;
+	_pinLevel[pin] = (duty < 128) ? LOW : HIGH;
+}
+
+void PinHALMock::writePort(uint8_t port, uint8_t setMask, uint8_t clearMask) {
+	_portWrites++;
+	for (uint8_t bit = 0; bit < 8; bit++) {
+		int pin = (port << 3) + bit;
+		if (!_validPin(pin)) break;
+		if (setMask & (1 << bit)) _pinLevel[pin] = HIGH;
+		else if (clearMask & (1 << bit)) _pinLevel[pin] = LOW;
+	}
+}
+
+uint8_t PinHALMock::getPinMode(int pin) {
+	return _validPin(pin) ? _pinMode[pin] : INPUT;
+}
+
+uint8_t PinHALMock::getPinLevel(int pin) {
+	return _validPin(pin) ? _pinLevel[pin] : LOW;
+}
+
+uint8_t PinHALMock::getPwmDuty(int pin) {
+	return _validPin(pin) ? _pwmDuty[pin] : 0;
+}
+
+unsigned long PinHALMock::getDigitalWrites() {
+	return _digitalWrites;
+}
+
+unsigned long PinHALMock::getPortWrites() {
+	return _portWrites;
+}
+
+unsigned long PinHALMock::getPwmWrites() {
+	return _pwmWrites;
+}
+
+unsigned long PinHALMock::getPinWrites() {
+	return _digitalWrites + _portWrites + _pwmWrites;
+}
+
+void PinHALMock::useVirtualClock(bool enable) {
+	_virtualClock = enable;
+	_virtualMicros = 0;
+}
+
+bool PinHALMock::isVirtualClock() {
+	return _virtualClock;
+}
+
+void PinHALMock::advanceMicros(unsigned long us) {
+	_virtualMicros += us;
+}
+
+unsigned long PinHALMock::getMicros() {
+	if (_virtualClock) return _virtualMicros;
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//Arduino core functions declared in native/Arduino.h, routed to the mock backend
+void pinMode(uint8_t pin, uint8_t mode) { PinHALMock::pinMode(pin, mode); }
+void digitalWrite(uint8_t pin, uint8_t level) { PinHALMock::digitalWrite(pin, level); }
+int digitalRead(uint8_t pin) { return PinHALMock::digitalRead(pin); }
+void analogWrite(uint8_t pin, int duty) { PinHALMock::analogWrite(pin, duty); }
+
+unsigned long micros() { return PinHALMock::getMicros(); }
+unsigned long millis() { return PinHALMock::getMicros() / 1000; }
+
+//on the virtual clock a delay only moves the clock forward, on real time it busy waits
+void delayMicroseconds(unsigned int us) {
+	if (PinHALMock::isVirtualClock()) {
+		PinHALMock::advanceMicros(us);
+		return;
+	}
+	unsigned long start = micros();
+	while (micros() - start < us);
+}
+
+void delay(unsigned long ms) {
+	delayMicroseconds(ms * 1000);
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+	return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+#endif
@@ -0,0 +1,200 @@
+// PinHAL.h
+// thin hardware abstraction for the direction and PWM pins of the drive system
+// on the Arduino target the direction pins map onto DigitalIO PinIO and the PWM pins write
+// their timer compare register directly (analogWrite() only for pins without a timer)
+// on the native (host) target every write goes to the in-memory PinHALMock backend
+#include <Arduino.h>
+#ifdef ARDUINO
+#include <DigitalIO.h>
+#endif
+
+#ifndef _PINHAL_h
+#define _PINHAL_h
+
+#ifdef ARDUINO
+
+//digital output pin, used for the wheel direction pins
+//the port register and bit are resolved once so PortBatch can combine pins of the same port
+class OutputPin {
+public:
+	OutputPin(int pin = -1) :_pin(pin), _pinNumber(pin), _portRegister(0), _bitMask(0) {
+		if (pin >= 0 && pin < NUM_DIGITAL_PINS) {
+			_portRegister = portOutputRegister(digitalPinToPort(pin));
+			_bitMask = digitalPinToBitMask(pin);
+		}
+	}
+
+	void mode(uint8_t pinMode) { _pin.mode(pinMode); }
+	void high() { _pin.high(); }
+	void low() { _pin.low(); }
+	void write(bool level) { _pin.write(level); }
+	int getPin() { return _pinNumber; }
+
+	volatile uint8_t* getPortRegister() { return _portRegister; }
+	uint8_t getBitMask() { return _bitMask; }
+
+private:
+	PinIO _pin;
+	int _pinNumber;
+	volatile uint8_t* _portRegister;
+	uint8_t _bitMask;
+};
+
+//PWM output pin, used for the wheel speed pins
+//begin() resolves the timer and compare register of the pin once, write() then only
+//updates the OCRnx register instead of repeating the analogWrite() pin to timer lookup
+class PwmPin {
+public:
+	PwmPin(int pin = -1) :_pin(pin), _tccrA(0), _ocr8(0), _ocr16(0), _timer(0), _connected(false) {}
+
+	void begin(); //sets the pin up as a LOW output and resolves its timer registers
+	void write(uint8_t duty); //duty 0-255, scaled to the timer resolution
+	int getPin() { return _pin; }
+
+	//sets the PWM frequency of the pin's 16 bit timer (phase correct PWM, TOP = ICRn)
+	//resolution is the number of duty steps (TOP), 0 picks the highest one for the frequency
+	//with a fixed resolution the frequency is the closest one at or below the request
+	//every pin on the same timer changes with it (pins 6 and 7 share Timer4 on the Mega)
+	//returns false for 8 bit timers, Timer0 also runs millis() so it keeps the core setup
+	bool setPwmFrequency(unsigned long frequency, uint16_t resolution = 0);
+	unsigned long getPwmFrequency();
+	uint16_t getPwmResolution();
+
+private:
+	int _pin;
+	volatile uint8_t* _tccrA; //timer control register holding the COMnx bits of the pin
+	uint8_t _comMask; //COMnx1 bit, connects the compare output to the pin
+	volatile uint8_t* _ocr8; //compare register of 8 bit timers
+	volatile uint16_t* _ocr16; //compare register of 16 bit timers
+	uint8_t _timer; //timer number + 1, 0 if the pin has no timer
+	bool _connected;
+
+	static uint16_t _timerTop[6]; //TOP of each timer, shared by all the pins of the timer
+	static unsigned long _timerFrequency[6];
+};
+
+#else //native host build
+
+//in-memory pin backend for host builds. records the pin levels, modes and PWM duties
+//and counts every write so the drive logic can be unit-tested and benchmarked on a PC
+class PinHALMock {
+public:
+	static const uint8_t PIN_COUNT = 70; //same pin count as the Mega 2560
+
+	static void reset(); //clears all the pin states and counters
+
+	static void pinMode(int pin, uint8_t mode);
+	static void digitalWrite(int pin, uint8_t level);
+	static uint8_t digitalRead(int pin);
+	static void analogWrite(int pin, int duty);
+
+	static uint8_t getPinMode(int pin);
+	static uint8_t getPinLevel(int pin);
+	static uint8_t getPwmDuty(int pin);
+
+	//the mock groups the pins into 8 pin ports by pin number (port = pin / 8)
+	//one call updates all the masked pins of a port as a single write, like a PORTx register write
+	static void writePort(uint8_t port, uint8_t setMask, uint8_t clearMask);
+
+	//write counters since the last reset()
+	static unsigned long getDigitalWrites();
+	static unsigned long getPortWrites();
+	static unsigned long getPwmWrites();
+	static unsigned long getPinWrites(); //digital + port + PWM writes
+
+	//clock used by millis()/micros() on the host, real time by default
+	//a virtual clock makes simulations deterministic and faster than real time
+	static void useVirtualClock(bool enable);
+	static bool isVirtualClock();
+	static void advanceMicros(unsigned long us);
+	static unsigned long getMicros();
+
+private:
+	static bool _validPin(int pin);
+
+	static uint8_t _pinMode[PIN_COUNT];
+	static uint8_t _pinLevel[PIN_COUNT];
+	static uint8_t _pwmDuty[PIN_COUNT];
+	static unsigned long _digitalWrites;
+	static unsigned long _portWrites;
+	static unsigned long _pwmWrites;
+	static bool _virtualClock;
+	static unsigned long _virtualMicros;
+};
+
+class OutputPin {
+public:
+	OutputPin(int pin = -1) :_pin(pin) {}
+
+	void mode(uint8_t pinMode) { PinHALMock::pinMode(_pin, pinMode); }
+	void high() { PinHALMock::digitalWrite(_pin, HIGH); }
+	void low() { PinHALMock::digitalWrite(_pin, LOW); }
+	void write(bool level) { PinHALMock::digitalWrite(_pin, level ? HIGH : LOW); }
+	int getPin() { return _pin; }
+
+private:
+	int _pin;
+};
+
+class PwmPin {
+public:
+	PwmPin(int pin = -1) :_pin(pin), _frequency(490), _resolution(255) {}
+
+	void begin() { PinHALMock::pinMode(_pin, OUTPUT); }
+	void write(uint8_t duty) { PinHALMock::analogWrite(_pin, duty); }
+	int getPin() { return _pin; }
+
+	//the mock only records the settings, the duty stays 0-255 in the backend
+	bool setPwmFrequency(unsigned long frequency, uint16_t resolution = 0) {
+		if (frequency == 0) return false;
+		_frequency = frequency;
+		_resolution = resolution ? resolution : 255;
+		return true;
+	}
+	unsigned long getPwmFrequency() { return _frequency; }
+	uint16_t getPwmResolution() { return _resolution; }
+
+private:
+	int _pin;
+	unsigned long _frequency;
+	uint16_t _resolution;
+};
+
+#endif
+
+//collects the direction pin levels and PWM duties of several wheels and commits them together
+//commit() writes every port with one read-modify-write while the interrupts are masked,
+//so all the direction pins change at the same instant, and then writes all the PWM duties
+class PortBatch {
+public:
+	static const uint8_t MAX_PORTS = 4;
+	static const uint8_t MAX_PWM_PINS = 8;
+
+	PortBatch();
+
+	void clear(); //empties the batch without writing anything
+	void stage(OutputPin& pin, bool level);
+	void stagePwm(PwmPin& pin, uint8_t duty);
+	void commit(); //writes and empties the batch
+
+private:
+	struct PortWrite {
+#ifdef ARDUINO
+		volatile uint8_t* portRegister;
+#else
+		uint8_t port;
+#endif
+		uint8_t setMask;
+		uint8_t clearMask;
+	};
+
+	PortWrite _ports[MAX_PORTS];
+	uint8_t _portCount;
+	PwmPin* _pwmPins[MAX_PWM_PINS];
+	uint8_t _pwmDuty[MAX_PWM_PINS];
+	uint8_t _pwmCount;
+
+	PortWrite* _findPort(OutputPin& pin, uint8_t& bitMask); //finds or adds the port of the pin
+};
+
+#endif
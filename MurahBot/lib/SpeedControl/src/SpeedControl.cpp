@@ -0,0 +1,143 @@
+#include <Arduino.h>
+
+#include "SpeedControl.h"
+
+//default constructor: every wheel starts without an encoder (open loop)
+DriveSpeedControl::DriveSpeedControl(Drive4Wheel& drive, int maxTicksPerSecond, uint16_t periodMs)
+	:_drive(&drive), _maxTicksPerSecond(maxTicksPerSecond), _periodMs(periodMs) {
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) _encoder[i] = 0;
+	_reset();
+}
+
+void DriveSpeedControl::attachEncoder(Drive4Wheel::WheelIndex wheel, WheelEncoder& encoder) {
+	if (wheel < Drive4Wheel::WHEEL_COUNT) _encoder[wheel] = &encoder;
+	_reset();
+}
+
+void DriveSpeedControl::setGains(uint16_t kp, uint16_t ki, uint16_t kd) {
+	_kp = kp;
+	_ki = ki;
+	_kd = kd;
+}
+
+void DriveSpeedControl::setMaxCorrection(uint8_t maxCorrection) {
+	_maxCorrection = maxCorrection;
+}
+
+void DriveSpeedControl::enable(bool enable) {
+	_enabled = enable;
+	_reset();
+	if (!enable) _drive->clearDutyCorrections();
+}
+
+bool DriveSpeedControl::isEnabled() {
+	return _enabled;
+}
+
+//measures the speed of every wheel since the last update and corrects its duty
+void DriveSpeedControl::update() {
+	unsigned long now = micros();
+	unsigned long elapsed = now - _lastMicros;
+	_lastMicros = now;
+	if (!_enabled || elapsed == 0) return;
+
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		int duty = _drive->getCurrentDuty((Drive4Wheel::WheelIndex)i);
+		_targetSpeed[i] = (int16_t)((long)duty * _maxTicksPerSecond / 255);
+		if (!_encoder[i]) continue;
+
+		int16_t count = _encoder[i]->getCount();
+		int16_t ticks = count - _lastCount[i]; //wraps correctly across the 16 bit overflow
+		_lastCount[i] = count;
+		if (!_encoder[i]->isQuadrature() && duty < 0) ticks = -ticks; //tick encoders only count up
+
+		int16_t previousSpeed = _measuredSpeed[i];
+		_measuredSpeed[i] = (int16_t)((long)ticks * 1000000L / (long)elapsed);
+		_correction[i] = (duty == 0) ? 0 : _pid(i, previousSpeed);
+		if (duty == 0) _errorSum[i] = 0;
+	}
+	_drive->setDutyCorrections(_correction);
+}
+
+int DriveSpeedControl::getTargetSpeed(Drive4Wheel::WheelIndex wheel) {
+	return (wheel < Drive4Wheel::WHEEL_COUNT) ? _targetSpeed[wheel] : 0;
+}
+
+int DriveSpeedControl::getMeasuredSpeed(Drive4Wheel::WheelIndex wheel) {
+	return (wheel < Drive4Wheel::WHEEL_COUNT) ? _measuredSpeed[wheel] : 0;
+}
+
+int DriveSpeedControl::getCorrection(Drive4Wheel::WheelIndex wheel) {
+	return (wheel < Drive4Wheel::WHEEL_COUNT) ? _correction[wheel] : 0;
+}
+
+uint16_t DriveSpeedControl::getPeriod() {
+	return _periodMs;
+}
+
+void DriveSpeedControl::_reset() {
+	_lastMicros = micros();
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		_lastCount[i] = _encoder[i] ? _encoder[i]->getCount() : 0;
+		_targetSpeed[i] = 0;
+		_measuredSpeed[i] = 0;
+		_errorSum[i] = 0;
+		_correction[i] = 0;
+	}
+}
+
+//private PID step of one wheel, in magnitudes so a positive correction always speeds the wheel up
+int16_t DriveSpeedControl::_pid(uint8_t wheel, int16_t previousSpeed) {
+	bool backward = _targetSpeed[wheel] < 0;
+	int32_t target = abs(_targetSpeed[wheel]);
+	int32_t measured = backward ? -_measuredSpeed[wheel] : _measuredSpeed[wheel];
+	int32_t previous = backward ? -previousSpeed : previousSpeed;
+	int32_t error = target - measured;
+
+	//the integral is clamped so its share alone never exceeds the max correction. without ki nothing
+	//bounds it, so it is not summed at all and ki starts from a clean sum when it is switched on
+	if (_ki) {
+		int32_t sumLimit = ((int32_t)_maxCorrection << 8) / _ki;
+		_errorSum[wheel] = constrain(_errorSum[wheel] + error, -sumLimit, sumLimit);
+	}
+	else _errorSum[wheel] = 0;
+
+	int32_t output = (int32_t)_kp * error + (int32_t)_ki * _errorSum[wheel] - (int32_t)_kd * (measured - previous);
+	output >>= 8;
+	return (int16_t)constrain(output, (int32_t)-_maxCorrection, (int32_t)_maxCorrection);
+}
+
+
+//default constructor: the motor starts at rest
+MotorModel::MotorModel(int maxTicksPerSecond, uint8_t deadbandDuty, uint16_t timeConstantMs, uint8_t gainPercent)
+	:_maxTicksPerSecond(maxTicksPerSecond), _deadbandDuty(deadbandDuty), _timeConstantMs(timeConstantMs),
+	_gainPercent(gainPercent), _speed(0), _tickFraction(0) {
+}
+
+void MotorModel::setGainPercent(uint8_t gainPercent) {
+	_gainPercent = gainPercent;
+}
+
+//advances the motor by elapsedMicros at the given duty and counts the ticks on the encoder
+void MotorModel::update(int signedDuty, unsigned long elapsedMicros, WheelEncoder& encoder) {
+	int duty = abs(signedDuty);
+	float steady = 0;
+	if (duty > _deadbandDuty) {
+		steady = (float)(duty - _deadbandDuty) / (255 - _deadbandDuty) * _maxTicksPerSecond * _gainPercent / 100;
+		if (signedDuty < 0) steady = -steady;
+	}
+	float seconds = elapsedMicros * 1e-6f;
+	float blend = seconds * 1000 / (_timeConstantMs + seconds * 1000);
+	_speed += (steady - _speed) * blend;
+
+	_tickFraction += _speed * seconds;
+	int16_t ticks = (int16_t)_tickFraction;
+	_tickFraction -= ticks;
+	if (ticks == 0) return;
+	if (!encoder.isQuadrature()) ticks = abs(ticks);
+	encoder.injectTicks(ticks);
+}
+
+float MotorModel::getSpeed() {
+	return _speed;
+}
@@ -0,0 +1,76 @@
+// SpeedControl.h
+#include <Arduino.h>
+#include <Wheels.h>
+#include <WheelEncoder.h>
+
+#ifndef _SPEEDCONTROL_h
+#define _SPEEDCONTROL_h
+
+//closed loop wheel speed control for Drive4Wheel
+//the commanded (ramped) duty of each wheel is the feedforward and sets the speed target in ticks/sec,
+//a fixed rate integer PID on the measured encoder speed adds a duty correction on top of it
+//wheels without an encoder stay open loop. call update() from a scheduler task every periodMs
+class DriveSpeedControl {
+public:
+	//maxTicksPerSecond is the encoder rate of a free running wheel at duty 255, duty d targets d/255 of it
+	DriveSpeedControl(Drive4Wheel& drive, int maxTicksPerSecond, uint16_t periodMs = 20);
+
+	void attachEncoder(Drive4Wheel::WheelIndex wheel, WheelEncoder& encoder);
+
+	//gains in Q8.8 (256 == 1.0) duty per tick/sec of speed error: kp on the error, ki on the error
+	//summed every update, kd on the change of the measured speed (no kick on target steps)
+	void setGains(uint16_t kp, uint16_t ki, uint16_t kd);
+	void setMaxCorrection(uint8_t maxCorrection); //limit of the correction and of the integral (anti-windup)
+
+	void enable(bool enable); //disabling clears the corrections, the drive is open loop again
+	bool isEnabled();
+	void update(); //one control step, non-blocking
+
+	int getTargetSpeed(Drive4Wheel::WheelIndex wheel); //ticks/sec, signed like the duties
+	int getMeasuredSpeed(Drive4Wheel::WheelIndex wheel);
+	int getCorrection(Drive4Wheel::WheelIndex wheel);
+	uint16_t getPeriod();
+
+private:
+	Drive4Wheel* _drive;
+	WheelEncoder* _encoder[Drive4Wheel::WHEEL_COUNT];
+	int _maxTicksPerSecond;
+	uint16_t _periodMs;
+	uint16_t _kp = 0;
+	uint16_t _ki = 0;
+	uint16_t _kd = 0;
+	int16_t _maxCorrection = 60;
+	bool _enabled = false;
+
+	unsigned long _lastMicros;
+	int16_t _lastCount[Drive4Wheel::WHEEL_COUNT];
+	int16_t _targetSpeed[Drive4Wheel::WHEEL_COUNT];
+	int16_t _measuredSpeed[Drive4Wheel::WHEEL_COUNT];
+	int32_t _errorSum[Drive4Wheel::WHEEL_COUNT];
+	int16_t _correction[Drive4Wheel::WHEEL_COUNT];
+
+	void _reset(); //restarts the measurement and clears the PID state
+	int16_t _pid(uint8_t wheel, int16_t previousSpeed);
+};
+
+//first order DC motor and encoder model for host simulations of the speed control
+//speed follows the duty above the stall deadband with the time constant, update() feeds the
+//resulting ticks into the wheel's encoder. gainPercent models a weaker or loaded motor
+class MotorModel {
+public:
+	MotorModel(int maxTicksPerSecond, uint8_t deadbandDuty = 100, uint16_t timeConstantMs = 80, uint8_t gainPercent = 100);
+
+	void setGainPercent(uint8_t gainPercent);
+	void update(int signedDuty, unsigned long elapsedMicros, WheelEncoder& encoder);
+	float getSpeed(); //ticks/sec
+
+private:
+	int _maxTicksPerSecond;
+	uint8_t _deadbandDuty;
+	uint16_t _timeConstantMs;
+	uint8_t _gainPercent;
+	float _speed;
+	float _tickFraction; //ticks not yet handed to the encoder
+};
+
+#endif
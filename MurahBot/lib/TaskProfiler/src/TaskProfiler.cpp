@@ -0,0 +1,64 @@
+#include <Arduino.h>
+
+#include "TaskProfiler.h"
+
+//default constructor: starts without samples
+TaskProfile::TaskProfile(const char* name) :_name(name) {
+	reset();
+}
+
+TaskProfile::Scope::Scope(TaskProfile& profile, unsigned long intervalMs) :_profile(&profile), _start(micros()) {
+	_profile->_begin(_start, intervalMs);
+}
+
+TaskProfile::Scope::~Scope() {
+	_profile->_end(_start, micros());
+}
+
+void TaskProfile::reset() {
+	_interval = 0;
+	_lastStart = 0;
+	_started = false;
+	_overruns = 0;
+	_runtime.reset();
+	_jitter.reset();
+}
+
+const char* TaskProfile::getName() {
+	return _name;
+}
+
+unsigned long TaskProfile::getCount() {
+	return _runtime.getCount();
+}
+
+unsigned long TaskProfile::getOverruns() {
+	return _overruns;
+}
+
+TimingStats& TaskProfile::getRuntime() {
+	return _runtime;
+}
+
+TimingStats& TaskProfile::getJitter() {
+	return _jitter;
+}
+
+//private method comparing the start with the one the interval scheduled
+void TaskProfile::_begin(unsigned long start, unsigned long intervalMs) {
+	unsigned long interval = intervalMs * 1000;
+	if (_started && interval && interval == _interval) {
+		unsigned long period = start - _lastStart;
+		_jitter.add(period > interval ? period - interval : interval - period);
+		if (period > 2 * interval) _overruns++;
+	}
+	_interval = interval; //a changed interval restarts the jitter measurement
+	_lastStart = start;
+	_started = true;
+}
+
+void TaskProfile::_end(unsigned long start, unsigned long end) {
+	unsigned long runtime = end - start;
+	_runtime.add(runtime);
+	if (_interval && runtime > _interval) _overruns++;
+}
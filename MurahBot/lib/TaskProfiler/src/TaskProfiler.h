@@ -0,0 +1,51 @@
+// TaskProfiler.h
+#include <Arduino.h>
+#include <TimingStats.h>
+
+#ifndef _TASKPROFILER_h
+#define _TASKPROFILER_h
+
+//per task execution time and start jitter, measured with micros()
+//a callback is profiled by putting PROFILE_TASK(profile, task.getInterval()) on its first line
+//without -D MURAHBOT_PROFILE the macro expands to nothing and the profiles need not exist
+#ifdef MURAHBOT_PROFILE
+#define PROFILE_TASK(profile, intervalMs) TaskProfile::Scope _taskProfileScope(profile, intervalMs)
+#else
+#define PROFILE_TASK(profile, intervalMs)
+#endif
+
+class TaskProfile {
+public:
+	TaskProfile(const char* name); //name is kept as a pointer, pass a string literal
+
+	//measures one callback run from construction to the end of the scope
+	class Scope {
+	public:
+		Scope(TaskProfile& profile, unsigned long intervalMs);
+		~Scope();
+	private:
+		TaskProfile* _profile;
+		unsigned long _start;
+	};
+
+	void reset();
+	const char* getName();
+	unsigned long getCount(); //callback runs
+	unsigned long getOverruns(); //runs longer than the interval or started more than an interval late
+	TimingStats& getRuntime(); //us per run
+	TimingStats& getJitter(); //us between the scheduled and the actual start, tasks with an interval only
+
+private:
+	const char* _name;
+	unsigned long _interval; //us
+	unsigned long _lastStart;
+	bool _started;
+	unsigned long _overruns;
+	TimingStats _runtime;
+	TimingStats _jitter;
+
+	void _begin(unsigned long start, unsigned long intervalMs);
+	void _end(unsigned long start, unsigned long end);
+};
+
+#endif
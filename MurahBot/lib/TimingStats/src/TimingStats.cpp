@@ -0,0 +1,45 @@
+#include <Arduino.h>
+
+#include "TimingStats.h"
+
+//default constructor: starts without samples
+TimingStats::TimingStats() {
+	reset();
+}
+
+void TimingStats::add(unsigned long sample) {
+	if (_count == 0 || sample < _min) _min = sample;
+	if (sample > _max) _max = sample;
+	_last = sample;
+	_sum += sample;
+	_count++;
+}
+
+void TimingStats::reset() {
+	_count = 0;
+	_min = 0;
+	_max = 0;
+	_last = 0;
+	_sum = 0;
+}
+
+unsigned long TimingStats::getCount() {
+	return _count;
+}
+
+unsigned long TimingStats::getMin() {
+	return _min;
+}
+
+unsigned long TimingStats::getMax() {
+	return _max;
+}
+
+//the 64 bit division only runs when the mean is read, not per sample
+unsigned long TimingStats::getMean() {
+	return _count ? (unsigned long)(_sum / _count) : 0;
+}
+
+unsigned long TimingStats::getLast() {
+	return _last;
+}
@@ -0,0 +1,30 @@
+// TimingStats.h
+#include <Arduino.h>
+
+#ifndef _TIMINGSTATS_h
+#define _TIMINGSTATS_h
+
+//running min/max/mean of a timing sample (latency, runtime, jitter), usually in microseconds
+//constant time and memory per sample, nothing is stored but the aggregates
+class TimingStats {
+public:
+	TimingStats();
+
+	void add(unsigned long sample);
+	void reset();
+
+	unsigned long getCount();
+	unsigned long getMin(); //0 without samples
+	unsigned long getMax();
+	unsigned long getMean();
+	unsigned long getLast();
+
+private:
+	unsigned long _count;
+	unsigned long _min;
+	unsigned long _max;
+	unsigned long _last;
+	unsigned long long _sum;
+};
+
+#endif
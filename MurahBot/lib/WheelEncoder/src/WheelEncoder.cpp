@@ -0,0 +1,80 @@
+#include <Arduino.h>
+
+#include "WheelEncoder.h"
+
+WheelEncoder* WheelEncoder::_instances[WheelEncoder::MAX_ENCODERS];
+uint8_t WheelEncoder::_instanceCount = 0;
+
+//default constructor: stores the pins, the interrupt is attached in begin()
+WheelEncoder::WheelEncoder(int pinA, int pinB, bool reverse)
+	:_pinA(pinA), _pinB(pinB), _reverse(reverse), _count(0) {
+#ifdef ARDUINO
+	_pinBRegister = 0;
+	_pinBMask = 0;
+#endif
+}
+
+bool WheelEncoder::isQuadrature() {
+	return _pinB >= 0;
+}
+
+int16_t WheelEncoder::getCount() {
+	int16_t first;
+	int16_t second;
+	do {
+		first = _count;
+		second = _count;
+	} while (first != second); //an ISR hit between the two byte reads, try again
+	return first;
+}
+
+void WheelEncoder::injectTicks(int16_t ticks) {
+	noInterrupts();
+	_count += _reverse ? -ticks : ticks;
+	interrupts();
+}
+
+//ISR body: one tick per rising edge of pinA, direction from pinB if there is one
+void WheelEncoder::_onEdge() {
+	bool backward = _reverse;
+#ifdef ARDUINO
+	if (_pinBRegister && (*_pinBRegister & _pinBMask)) backward = !backward;
+#endif
+	if (backward) _count--;
+	else _count++;
+}
+
+void WheelEncoder::_isr0() { _instances[0]->_onEdge(); }
+void WheelEncoder::_isr1() { _instances[1]->_onEdge(); }
+void WheelEncoder::_isr2() { _instances[2]->_onEdge(); }
+void WheelEncoder::_isr3() { _instances[3]->_onEdge(); }
+
+#ifdef ARDUINO
+
+bool WheelEncoder::begin() {
+	if (_pinA < 0 || digitalPinToInterrupt(_pinA) == NOT_AN_INTERRUPT) return false;
+	if (_instanceCount == MAX_ENCODERS) return false;
+
+	pinMode(_pinA, INPUT_PULLUP);
+	if (_pinB >= 0) {
+		pinMode(_pinB, INPUT_PULLUP);
+		_pinBRegister = portInputRegister(digitalPinToPort(_pinB));
+		_pinBMask = digitalPinToBitMask(_pinB);
+	}
+
+	static void (* const isrs[MAX_ENCODERS])() = { &_isr0, &_isr1, &_isr2, &_isr3 };
+	_instances[_instanceCount] = this;
+	attachInterrupt(digitalPinToInterrupt(_pinA), isrs[_instanceCount], RISING);
+	_instanceCount++;
+	return true;
+}
+
+#else
+
+//no interrupts on the host, the simulation drives the count through injectTicks()
+bool WheelEncoder::begin() {
+	if (_instanceCount < MAX_ENCODERS) _instances[_instanceCount++] = this;
+	return true;
+}
+
+#endif
@@ -0,0 +1,47 @@
+// WheelEncoder.h
+#include <Arduino.h>
+
+#ifndef _WHEELENCODER_h
+#define _WHEELENCODER_h
+
+//interrupt counted wheel encoder. ONE instance for EACH wheel!!
+//pinA is counted on its rising edges in an external interrupt (Mega: pins 2, 3, 20, 21; 18/19 are Serial1)
+//with a pinB (quadrature) the level of B at the edge gives the direction, a tick encoder only counts up
+//the count is written by the ISR only and read lock-free (see getCount())
+class WheelEncoder {
+public:
+	static const uint8_t MAX_ENCODERS = 4; //one ISR trampoline per instance
+
+	WheelEncoder(int pinA = -1, int pinB = -1, bool reverse = false); //reverse flips the counting direction
+
+	bool begin(); //sets up the pins and attaches the interrupt, false if pinA has no interrupt
+	bool isQuadrature(); //true if the encoder gives the direction
+
+	//consistent snapshot of the free running 16 bit count, lock-free: the ISR never waits on the reader,
+	//the reader retries until two reads agree. differences of counts are valid across overflows
+	int16_t getCount();
+
+	//adds ticks from outside the ISR, used by the host simulation and the tests on the bench
+	void injectTicks(int16_t ticks);
+
+private:
+	int _pinA;
+	int _pinB;
+	bool _reverse;
+	volatile int16_t _count;
+#ifdef ARDUINO
+	volatile uint8_t* _pinBRegister; //input register of pinB, read directly in the ISR
+	uint8_t _pinBMask;
+#endif
+
+	void _onEdge(); //ISR body
+
+	static WheelEncoder* _instances[MAX_ENCODERS];
+	static uint8_t _instanceCount;
+	static void _isr0();
+	static void _isr1();
+	static void _isr2();
+	static void _isr3();
+};
+
+#endif
@@ -0,0 +1,588 @@
+// DriveN.h
+// included by Wheels.h, use Wheels.h
+#include <Arduino.h>
+
+#ifndef _DRIVEN_h
+#define _DRIVEN_h
+
+//compile time loop over the wheels [I, END): one call per wheel, unrolled by the template recursion
+//so the wheel index is a constant in every call (avr-gcc -Os does not unroll plain for loops)
+template <uint8_t I, uint8_t END>
+struct WheelLoop {
+	template <class Function>
+	static void run(const Function& function) {
+		function(I);
+		WheelLoop<I + 1, END>::run(function);
+	}
+};
+
+template <uint8_t END>
+struct WheelLoop<END, END> {
+	template <class Function>
+	static void run(const Function&) {}
+};
+
+//index list used to construct the wheels from a pin array in the member initializer
+template <uint8_t... I>
+struct WheelIndices {};
+
+template <uint8_t N, uint8_t... I>
+struct MakeWheelIndices : MakeWheelIndices<N - 1, N - 1, I...> {};
+
+template <uint8_t... I>
+struct MakeWheelIndices<0, I...> {
+	typedef WheelIndices<I...> type;
+};
+
+//drive types shared by all the wheel counts
+class DriveTypes {
+public:
+	enum DriveState : uint8_t {
+		DRIVE_STOP, DRIVE_FORWARD, DRIVE_BACKWARD, DRIVE_LEFT, DRIVE_RIGHT, DRIVE_FORWARD_LEFT,
+		DRIVE_FORWARD_RIGHT, DRIVE_BACKWARD_LEFT, DRIVE_BACKWARD_RIGHT
+	}; //all the robot drive states that are relevant to the Drive class
+
+	//wheel indices of the 4 wheel chassis, other wheel counts index their wheels 0 to N - 1
+	enum WheelIndex : uint8_t {
+		LEFT_FRONT, LEFT_REAR, RIGHT_FRONT, RIGHT_REAR
+	};
+};
+
+//skid steer drive of N wheels held in one array inside the drive object (no pointers to the wheels)
+//wheels 0 to LEFT - 1 are on the left side, LEFT to N - 1 on the right side
+//the wheels are constructed in place from their pins, so the drive object owns the only Wheel of
+//each motor: use getWheel() to reach them
+template <uint8_t N, uint8_t LEFT = N / 2>
+class DriveN : public DriveTypes {
+	static_assert(N > 0 && LEFT <= N, "DriveN needs at least one wheel and LEFT <= N");
+
+public:
+	static const uint8_t WHEEL_COUNT = N;
+
+	DriveN(const WheelPins (&pins)[N], int speedToleranceRange)
+		:DriveN(pins, speedToleranceRange, typename MakeWheelIndices<N>::type()) {}
+
+	//4 wheel constructor of Drive4Wheel, same argument order as always
+	DriveN(const WheelPins& leftFront, const WheelPins& rightFront,
+		const WheelPins& leftRear, const WheelPins& rightRear, int speedToleranceRange)
+		:_wheels{ _makeWheel(leftFront), _makeWheel(leftRear), _makeWheel(rightFront), _makeWheel(rightRear) },
+		_speedToleranceRange(speedToleranceRange) {
+		static_assert(N == 4 && LEFT == 2, "the 4 wheel constructor needs DriveN<4, 2>");
+		initDrive();
+	}
+	//speed tolerance range ensure that the wheel speeds are clipped below that range from the absolute max and min
+
+	//initialize the drive speed for the drive object
+	void initDrive() { _setDriveSpeed(); }
+
+	Wheel& getWheel(uint8_t wheel) { return _wheels[wheel < N ? wheel : N - 1]; }
+
+	//method to check and limit the speed before invoking the drive methods for users //not neccesary for all cases
+	int limitDriveSpeed(int driveSpeed);
+
+	//methods to drive
+	void goForward(int wheelSpeed);
+	void goBackward(int wheelSpeed);
+	void goLeft(int wheelSpeed, SpeedRatioQ8 speedRatio = toSpeedRatioQ8(1.0));
+	void goRight(int wheelSpeed, SpeedRatioQ8 speedRatio = toSpeedRatioQ8(1.0));
+	void swayLeft(int wheelSpeed, SpeedRatioQ8 speedRatio = toSpeedRatioQ8(0.8), bool reverse = false);
+	void swayRight(int wheelSpeed, SpeedRatioQ8 speedRatio = toSpeedRatioQ8(0.8), bool reverse = false);
+	//float speedRatio versions, converted once to Q8.8 (pulls in soft-float on the AVR)
+	void goLeft(int wheelSpeed, float speedRatio) { goLeft(wheelSpeed, toSpeedRatioQ8(speedRatio)); }
+	void goRight(int wheelSpeed, float speedRatio) { goRight(wheelSpeed, toSpeedRatioQ8(speedRatio)); }
+	void swayLeft(int wheelSpeed, float speedRatio, bool reverse = false) { swayLeft(wheelSpeed, toSpeedRatioQ8(speedRatio), reverse); }
+	void swayRight(int wheelSpeed, float speedRatio, bool reverse = false) { swayRight(wheelSpeed, toSpeedRatioQ8(speedRatio), reverse); }
+	void stop();
+
+	//continuous differential drive: linear (forward +) and angular (counterclockwise, i.e. left +) commands,
+	//each -255 to 255 of full speed, mixed into signed side speeds left = linear - angular, right = linear + angular
+	//in one integer pass. an over range pair is scaled down together, so the left/right ratio (the turn)
+	//is kept. both sides then map onto the drive speed with one common factor (255 is the max drive
+	//speed), so the duties keep the ratio of the commands. a side below MIX_DEADBAND stops, a side that
+	//would map below the min drive speed (where the motors stall) is raised to it. each side reverses on its own
+	static const uint8_t MIX_DEADBAND = 8;
+	void driveMix(int linear, int angular);
+
+	//direct per wheel command: signed duties (forward +, see WheelIndex), -255 to 255
+	//each wheel clips its duty to its own speed range, 0 stops it. ramped like the other commands
+	void driveWheels(const int16_t duty[N]);
+
+	//drives the given state with one call, speedRatio is only used by the turn and sway states
+	void applyDriveState(DriveState driveState, int wheelSpeed, SpeedRatioQ8 speedRatio = toSpeedRatioQ8(1.0));
+
+	//methods to get and set _speedToleranceRange that updates the drive speed values
+	//false, and the tolerance is unchanged, if it is negative or leaves the wheels no drive speed range
+	int getSpeedToleranceRange() { return _speedToleranceRange; }
+	bool setSpeedToleranceRange(int speedTolerance);
+
+	//methods to get the drive speed values and current drive state
+	int getDriveSpeed(MinMaxRange rangeValue);
+	DriveState getCurrentDriveState() { return _driveState; }
+
+	//incremented every time the drive speed values change, lets users cache values derived from them
+	uint8_t getDriveSpeedRevision() { return _driveSpeedRevision; }
+
+	//write-through cache statistics: drive commands issued versus hardware writes actually performed
+	unsigned long getCommandCount() { return _commandCount; } //drive commands (go*, sway*, stop)
+	unsigned long getHardwareWriteCount() { return _hardwareWriteCount; } //commands that changed at least one wheel
+	unsigned long getWheelWriteCount() { return _wheelWriteCount; } //wheels written, at most N per command
+	void resetCommandCounters();
+
+	//slew-rate limiter. with the ramp enabled the drive methods only set a target duty per wheel and
+	//updateRamp(), called at a fixed rate from its own scheduler task, moves the wheels towards it:
+	//at most accelStep (speeding up) or decelStep (slowing down) per call, never blocking.
+	//a wheel leaves standstill at the min drive speed (the motors do not turn below it) and a reversal
+	//first ramps down to a stop and holds it for reversalSteps calls before spinning the other way
+	void setRamp(uint8_t accelStep, uint8_t decelStep, uint8_t reversalSteps = 1);
+	void enableRamp(bool enable); //disabling it jumps the wheels to their targets
+	bool isRampEnabled() { return _rampEnabled; }
+	bool updateRamp(); //one ramp step, returns true while any wheel is still ramping
+
+	//signed duty per wheel, positive is forward (see WheelIndex)
+	int getTargetDuty(uint8_t wheel) { return (wheel < N) ? _targetDuty[wheel] : 0; }
+	int getCurrentDuty(uint8_t wheel) { return (wheel < N) ? _currentDuty[wheel] : 0; }
+
+	//closed loop duty corrections, added to the magnitude of each spinning wheel's duty on every commit
+	//set by a speed controller (lib/SpeedControl) at its own rate, the new duties are committed at once
+	//a stopped wheel stays stopped whatever its correction
+	void setDutyCorrections(const int16_t correction[N]);
+	void clearDutyCorrections();
+	int getDutyCorrection(uint8_t wheel) { return (wheel < N) ? _dutyCorrection[wheel] : 0; }
+
+	//supply compensation: every spinning wheel's duty is scaled by the Q8.8 ratio on every commit,
+	//nominal / measured supply voltage (lib/AdcSampler) gives the same motor voltage as the pack sags.
+	//the wheels clip the result to their range, a changed ratio is committed at once
+	void setSupplyScale(SpeedRatioQ8 scale);
+	SpeedRatioQ8 getSupplyScale() { return _supplyScale; }
+
+	//cut out (overcurrent): stops every wheel at once and keeps them stopped whatever is commanded
+	//the targets are dropped, the ramp starts from standstill once it is cleared
+	void setCutOut(bool cutOut);
+	bool isCutOut() { return _cutOut; }
+
+private:
+	template <uint8_t... I>
+	DriveN(const WheelPins (&pins)[N], int speedToleranceRange, WheelIndices<I...>)
+		:_wheels{ _makeWheel(pins[I])... }, _speedToleranceRange(speedToleranceRange) {
+		initDrive();
+	}
+	static Wheel _makeWheel(const WheelPins& pins) { return Wheel(pins.forward, pins.backward, pins.speed); }
+
+	Wheel _wheels[N];
+	int _speedToleranceRange; //the tolerance between the absolute speeds of the Wheel instance and allowable drive speed
+	int _maxDriveSpeed = 0;
+	int _minDriveSpeed = 0;
+	DriveState _driveState = DRIVE_STOP; //return to robot drive state based on the wheel spin conditions
+	uint8_t _driveSpeedRevision = 0; //incremented by _setDriveSpeed()
+
+	void _setDriveSpeed(); //private method to update the drive speeds with the current _speedToleranceRange value
+	int _scaleSpeed(int wheelSpeed, SpeedRatioQ8 speedRatio) { return (int)(((long)wheelSpeed * speedRatio.raw) >> 8); }
+
+	//stages the left and right wheels and commits all the wheels at once
+	void _driveSides(Wheel::WheelState leftState, int leftSpeed,
+		Wheel::WheelState rightState, int rightSpeed, DriveState driveState);
+	PortBatch _batch; //direction and PWM writes of one drive command
+	unsigned long _commandCount = 0;
+	unsigned long _hardwareWriteCount = 0;
+	unsigned long _wheelWriteCount = 0;
+
+	//ramp state, duties are signed (positive forward) and indexed like _wheels
+	bool _rampEnabled = false;
+	uint8_t _rampAccelStep = 10;
+	uint8_t _rampDecelStep = 20;
+	uint8_t _rampReversalSteps = 1;
+	int16_t _targetDuty[N] = {};
+	int16_t _currentDuty[N] = {};
+	uint8_t _reversalHold[N] = {};
+	bool _reversalForward[N] = {}; //direction the held wheel starts in, the hold ends if the target leaves it
+	int16_t _dutyCorrection[N] = {};
+	bool _correctionEnabled = false; //true while any correction is non-zero
+	SpeedRatioQ8 _supplyScale = toSpeedRatioQ8(1.0);
+	bool _cutOut = false;
+
+	//true if the duties need _commitDuties(): corrections, supply scale or cut out
+	bool _dutyAdjusted() { return _correctionEnabled || _supplyScale.raw != 256 || _cutOut; }
+
+	DriveState _sideState(int left, int right); //drive state of signed side commands
+	int16_t _rampStep(uint8_t wheel); //next current duty of the wheel
+	void _commitDuties(const int16_t duty[N]); //stages and commits signed duties (plus corrections)
+};
+
+template <uint8_t N, uint8_t LEFT>
+const uint8_t DriveN<N, LEFT>::WHEEL_COUNT;
+template <uint8_t N, uint8_t LEFT>
+const uint8_t DriveN<N, LEFT>::MIX_DEADBAND;
+
+//the robot's chassis
+typedef DriveN<4> Drive4Wheel;
+
+
+//checks the input speed and ensures that the speed is capped to the max or min Drive speeds allowed for the drive class
+//not invoked by any other methods of the drive class (made available for users of the drive class)
+template <uint8_t N, uint8_t LEFT>
+int DriveN<N, LEFT>::limitDriveSpeed(int driveSpeed) {
+	if (driveSpeed > _maxDriveSpeed) driveSpeed = _maxDriveSpeed;
+	else if (driveSpeed < _minDriveSpeed) driveSpeed = _minDriveSpeed;
+	return driveSpeed;
+}
+
+//methods for driving
+//every method resolves to a (state, speed) pair per side, all the wheels are committed together
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::goForward(int wheelSpeed) {
+	_driveSides(Wheel::WHEEL_SPIN_FORWARD, wheelSpeed, Wheel::WHEEL_SPIN_FORWARD, wheelSpeed, DRIVE_FORWARD);
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::goBackward(int wheelSpeed) {
+	_driveSides(Wheel::WHEEL_SPIN_BACKWARD, wheelSpeed, Wheel::WHEEL_SPIN_BACKWARD, wheelSpeed, DRIVE_BACKWARD);
+}
+
+//turn and sway speeds are scaled with the Q8.8 speedRatio, no float math on the drive path
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::goLeft(int wheelSpeed, SpeedRatioQ8 speedRatio) {
+	_driveSides(Wheel::WHEEL_SPIN_BACKWARD, _scaleSpeed(wheelSpeed, speedRatio),
+		Wheel::WHEEL_SPIN_FORWARD, wheelSpeed, DRIVE_LEFT);
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::goRight(int wheelSpeed, SpeedRatioQ8 speedRatio) {
+	_driveSides(Wheel::WHEEL_SPIN_FORWARD, wheelSpeed,
+		Wheel::WHEEL_SPIN_BACKWARD, _scaleSpeed(wheelSpeed, speedRatio), DRIVE_RIGHT);
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::swayLeft(int wheelSpeed, SpeedRatioQ8 speedRatio, bool reverse) {
+	if (reverse == true) {
+		_driveSides(Wheel::WHEEL_SPIN_BACKWARD, _scaleSpeed(wheelSpeed, speedRatio),
+			Wheel::WHEEL_SPIN_BACKWARD, wheelSpeed, DRIVE_BACKWARD_LEFT);
+	}
+	else {
+		_driveSides(Wheel::WHEEL_SPIN_FORWARD, _scaleSpeed(wheelSpeed, speedRatio),
+			Wheel::WHEEL_SPIN_FORWARD, wheelSpeed, DRIVE_FORWARD_LEFT);
+	}
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::swayRight(int wheelSpeed, SpeedRatioQ8 speedRatio, bool reverse) {
+	if (reverse == true) {
+		_driveSides(Wheel::WHEEL_SPIN_BACKWARD, wheelSpeed,
+			Wheel::WHEEL_SPIN_BACKWARD, _scaleSpeed(wheelSpeed, speedRatio), DRIVE_BACKWARD_RIGHT);
+	}
+	else {
+		_driveSides(Wheel::WHEEL_SPIN_FORWARD, wheelSpeed,
+			Wheel::WHEEL_SPIN_FORWARD, _scaleSpeed(wheelSpeed, speedRatio), DRIVE_FORWARD_RIGHT);
+	}
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::stop() {
+	_driveSides(Wheel::WHEEL_NO_SPIN, 0, Wheel::WHEEL_NO_SPIN, 0, DRIVE_STOP);
+}
+
+//mixes the linear and angular commands into the two sides
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::driveMix(int linear, int angular) {
+	int left = constrain(linear, -255, 255) - constrain(angular, -255, 255);
+	int right = constrain(linear, -255, 255) + constrain(angular, -255, 255);
+
+	//saturation: scale both sides by the same factor
+	int peak = max(abs(left), abs(right));
+	if (peak > 255) {
+		left = (int)((long)left * 255 / peak);
+		right = (int)((long)right * 255 / peak);
+	}
+
+	//drive state of the motion, for the users of getCurrentDriveState()
+	DriveState driveState = _sideState(left, right);
+
+	//side command to wheel state and duty, the same factor for both sides keeps the turn ratio
+	//only a side that would stall below the min drive speed is raised to it
+	Wheel::WheelState leftState = Wheel::WHEEL_NO_SPIN;
+	Wheel::WheelState rightState = Wheel::WHEEL_NO_SPIN;
+	int leftSpeed = 0;
+	int rightSpeed = 0;
+	if (abs(left) >= MIX_DEADBAND) {
+		leftState = (left > 0) ? Wheel::WHEEL_SPIN_FORWARD : Wheel::WHEEL_SPIN_BACKWARD;
+		leftSpeed = max(_minDriveSpeed, (int)((long)abs(left) * _maxDriveSpeed / 255));
+	}
+	if (abs(right) >= MIX_DEADBAND) {
+		rightState = (right > 0) ? Wheel::WHEEL_SPIN_FORWARD : Wheel::WHEEL_SPIN_BACKWARD;
+		rightSpeed = max(_minDriveSpeed, (int)((long)abs(right) * _maxDriveSpeed / 255));
+	}
+	_driveSides(leftState, leftSpeed, rightState, rightSpeed, driveState);
+}
+
+//drives the given state with one call, used by table driven and scripted users of the class
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::applyDriveState(DriveState driveState, int wheelSpeed, SpeedRatioQ8 speedRatio) {
+	switch (driveState) {
+	case DRIVE_FORWARD: goForward(wheelSpeed); break;
+	case DRIVE_BACKWARD: goBackward(wheelSpeed); break;
+	case DRIVE_LEFT: goLeft(wheelSpeed, speedRatio); break;
+	case DRIVE_RIGHT: goRight(wheelSpeed, speedRatio); break;
+	case DRIVE_FORWARD_LEFT: swayLeft(wheelSpeed, speedRatio); break;
+	case DRIVE_FORWARD_RIGHT: swayRight(wheelSpeed, speedRatio); break;
+	case DRIVE_BACKWARD_LEFT: swayLeft(wheelSpeed, speedRatio, true); break;
+	case DRIVE_BACKWARD_RIGHT: swayRight(wheelSpeed, speedRatio, true); break;
+	default: stop(); break;
+	}
+}
+
+//sets the tolerance value for speed ranges, at most half of the speed range all the wheels share
+template <uint8_t N, uint8_t LEFT>
+bool DriveN<N, LEFT>::setSpeedToleranceRange(int speedTolerance) {
+	int minWheelSpeed = _wheels[0].getWheelAbsoluteSpeed(MIN);
+	int maxWheelSpeed = _wheels[0].getWheelAbsoluteSpeed(MAX);
+	WheelLoop<1, N>::run([&](uint8_t i) {
+		minWheelSpeed = max(minWheelSpeed, _wheels[i].getWheelAbsoluteSpeed(MIN));
+		maxWheelSpeed = min(maxWheelSpeed, _wheels[i].getWheelAbsoluteSpeed(MAX));
+	});
+	if (speedTolerance < 0 || speedTolerance > (maxWheelSpeed - minWheelSpeed) / 2) return false;
+	_speedToleranceRange = speedTolerance;
+	_setDriveSpeed();
+	return true;
+}
+
+//returns drive speed
+template <uint8_t N, uint8_t LEFT>
+int DriveN<N, LEFT>::getDriveSpeed(MinMaxRange rangeValue) {
+	if (rangeValue == MIN)
+		return _minDriveSpeed;
+	else if (rangeValue == MAX)
+		return _maxDriveSpeed;
+	else
+		return -1;
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::resetCommandCounters() {
+	_commandCount = 0;
+	_hardwareWriteCount = 0;
+	_wheelWriteCount = 0;
+}
+
+//sets the ramp limits, in duty per updateRamp() call
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::setRamp(uint8_t accelStep, uint8_t decelStep, uint8_t reversalSteps) {
+	_rampAccelStep = max(accelStep, (uint8_t)1);
+	_rampDecelStep = max(decelStep, (uint8_t)1);
+	_rampReversalSteps = reversalSteps;
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::enableRamp(bool enable) {
+	_rampEnabled = enable;
+	if (!enable) _commitDuties(_targetDuty);
+}
+
+//moves every wheel one step towards its target duty and commits the wheels together
+template <uint8_t N, uint8_t LEFT>
+bool DriveN<N, LEFT>::updateRamp() {
+	if (!_rampEnabled) return false;
+	bool ramping = false;
+	int16_t nextDuty[N];
+	for (uint8_t i = 0; i < N; i++) {
+		nextDuty[i] = _rampStep(i);
+		if (nextDuty[i] != _targetDuty[i]) ramping = true;
+	}
+	_commitDuties(nextDuty);
+	return ramping;
+}
+
+//sets every wheel's target on its own, the drive state follows the side sums
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::driveWheels(const int16_t duty[N]) {
+	int left = 0;
+	int right = 0;
+	for (uint8_t i = 0; i < N; i++) {
+		_targetDuty[i] = constrain(duty[i], -255, 255);
+		if (i < LEFT) left += _targetDuty[i];
+		else right += _targetDuty[i];
+	}
+	_driveState = _sideState(left, right);
+	_commandCount++;
+	if (!_rampEnabled) _commitDuties(_targetDuty);
+}
+
+//stores the closed loop corrections and commits the current duties with them
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::setDutyCorrections(const int16_t correction[N]) {
+	_correctionEnabled = false;
+	for (uint8_t i = 0; i < N; i++) {
+		_dutyCorrection[i] = correction[i];
+		if (correction[i] != 0) _correctionEnabled = true;
+	}
+	_commitDuties(_currentDuty);
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::clearDutyCorrections() {
+	const int16_t noCorrection[N] = {};
+	setDutyCorrections(noCorrection);
+}
+
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::setSupplyScale(SpeedRatioQ8 scale) {
+	if (scale.raw == _supplyScale.raw) return;
+	_supplyScale = scale;
+	_commitDuties(_currentDuty);
+}
+
+//cutting out stops the wheels at once, without the ramp
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::setCutOut(bool cutOut) {
+	_cutOut = cutOut;
+	if (!cutOut) return;
+	for (uint8_t i = 0; i < N; i++) {
+		_targetDuty[i] = 0;
+		_reversalHold[i] = 0;
+	}
+	_driveState = DRIVE_STOP;
+	_commitDuties(_currentDuty);
+}
+
+//private method to update the drive speed values
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::_setDriveSpeed() {
+	//the minimum and maximum drivespeeds are evaluated from each absolute speed values of the wheels.
+	_minDriveSpeed = _wheels[0].getWheelAbsoluteSpeed(MIN);
+	_maxDriveSpeed = _wheels[0].getWheelAbsoluteSpeed(MAX);
+	WheelLoop<1, N>::run([this](uint8_t i) {
+		_minDriveSpeed = max(_minDriveSpeed, _wheels[i].getWheelAbsoluteSpeed(MIN));
+		_maxDriveSpeed = min(_maxDriveSpeed, _wheels[i].getWheelAbsoluteSpeed(MAX));
+	});
+	_minDriveSpeed = _minDriveSpeed + _speedToleranceRange;
+	_maxDriveSpeed = _maxDriveSpeed - _speedToleranceRange;
+	int biggerValue;
+	if (_minDriveSpeed > _maxDriveSpeed) {
+		biggerValue = _minDriveSpeed;
+		_minDriveSpeed = _maxDriveSpeed;
+		_maxDriveSpeed = biggerValue;
+	}//checks if the tolerance value given causes the values to reach an incorrect range
+	 //if yes the higher and lower values are reset appropriately minDriveSpeed < maxDriveSpeed
+	_driveSpeedRevision++;
+}
+
+//private method to stage the wheels of each side and commit the direction pins of all wheels
+//in one write per port (interrupts masked), followed by the PWM duties
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::_driveSides(Wheel::WheelState leftState, int leftSpeed,
+	Wheel::WheelState rightState, int rightSpeed, DriveState driveState) {
+	_driveState = driveState;
+
+	//signed targets, kept up to date so the ramp can take over from the current motion
+	int16_t leftDuty = (leftState == Wheel::WHEEL_NO_SPIN) ? 0 : max(leftSpeed, 1);
+	int16_t rightDuty = (rightState == Wheel::WHEEL_NO_SPIN) ? 0 : max(rightSpeed, 1);
+	if (leftState == Wheel::WHEEL_SPIN_BACKWARD) leftDuty = -leftDuty;
+	if (rightState == Wheel::WHEEL_SPIN_BACKWARD) rightDuty = -rightDuty;
+	WheelLoop<0, LEFT>::run([&](uint8_t i) { _targetDuty[i] = leftDuty; });
+	WheelLoop<LEFT, N>::run([&](uint8_t i) { _targetDuty[i] = rightDuty; });
+	_commandCount++;
+	if (_rampEnabled) return; //updateRamp() moves the wheels
+	if (_dutyAdjusted()) {
+		_commitDuties(_targetDuty); //the corrections, the supply scale and the cut out are applied there
+		return;
+	}
+
+	//unchanged wheels stage nothing, if no wheel changed the pins are not touched at all
+	uint8_t wheelWrites = 0;
+	WheelLoop<0, LEFT>::run([&](uint8_t i) {
+		if (_wheels[i].stageSpin(leftState, leftSpeed, _batch)) wheelWrites++;
+	});
+	WheelLoop<LEFT, N>::run([&](uint8_t i) {
+		if (_wheels[i].stageSpin(rightState, rightSpeed, _batch)) wheelWrites++;
+	});
+	if (wheelWrites) {
+		_batch.commit();
+		_hardwareWriteCount++;
+		_wheelWriteCount += wheelWrites;
+	}
+	for (uint8_t i = 0; i < N; i++) _currentDuty[i] = _targetDuty[i];
+}
+
+//private method mapping signed side commands to the drive state
+template <uint8_t N, uint8_t LEFT>
+typename DriveN<N, LEFT>::DriveState DriveN<N, LEFT>::_sideState(int left, int right) {
+	if (left == right) return (left > 0) ? DRIVE_FORWARD : ((left < 0) ? DRIVE_BACKWARD : DRIVE_STOP);
+	if (left < 0 && right > 0) return DRIVE_LEFT;
+	if (left > 0 && right < 0) return DRIVE_RIGHT;
+	if (left + right > 0) return (left < right) ? DRIVE_FORWARD_LEFT : DRIVE_FORWARD_RIGHT;
+	return (left > right) ? DRIVE_BACKWARD_LEFT : DRIVE_BACKWARD_RIGHT;
+}
+
+//private method computing the next ramp duty of one wheel
+template <uint8_t N, uint8_t LEFT>
+int16_t DriveN<N, LEFT>::_rampStep(uint8_t wheel) {
+	int16_t current = _currentDuty[wheel];
+	int16_t target = _targetDuty[wheel];
+	if (current == target) {
+		_reversalHold[wheel] = 0; //stopped, a later start is no longer a reversal
+		return current;
+	}
+
+	//standing still: hold after a reversal, then start at the min drive speed
+	if (current == 0) {
+		if (_reversalHold[wheel] > 0 && (target > 0) == _reversalForward[wheel]) {
+			_reversalHold[wheel]--;
+			return 0;
+		}
+		_reversalHold[wheel] = 0; //back to the direction the wheel came from
+		int16_t start = min(abs(target), _minDriveSpeed);
+		return (target > 0) ? start : -start;
+	}
+
+	int16_t magnitude = abs(current);
+	int16_t targetMagnitude = abs(target);
+	bool sameDirection = (current > 0) == (target > 0) && target != 0;
+
+	if (sameDirection && magnitude < targetMagnitude) {
+		magnitude = min(targetMagnitude, magnitude + _rampAccelStep);
+	}
+	else if (sameDirection) {
+		magnitude = max(targetMagnitude, magnitude - _rampDecelStep);
+	}
+	else {
+		//stopping or reversing, ramp down to zero first. below the min drive speed the motors stall anyway
+		magnitude = magnitude - _rampDecelStep;
+		if (magnitude < _minDriveSpeed) {
+			magnitude = 0;
+			if (target != 0) {
+				_reversalHold[wheel] = _rampReversalSteps;
+				_reversalForward[wheel] = target > 0;
+			}
+		}
+	}
+	return (current > 0) ? magnitude : -magnitude;
+}
+
+//private method to stage the signed duties of all wheels and commit them together
+template <uint8_t N, uint8_t LEFT>
+void DriveN<N, LEFT>::_commitDuties(const int16_t duty[N]) {
+	uint8_t wheelWrites = 0;
+	WheelLoop<0, N>::run([&](uint8_t i) {
+		Wheel::WheelState spinState = (duty[i] > 0) ? Wheel::WHEEL_SPIN_FORWARD :
+			((duty[i] < 0) ? Wheel::WHEEL_SPIN_BACKWARD : Wheel::WHEEL_NO_SPIN);
+		int magnitude = abs(duty[i]);
+		if (magnitude) {
+			magnitude = max(magnitude + _dutyCorrection[i], 1); //the wheel clips it to its range
+			if (_supplyScale.raw != 256) magnitude = max(_scaleSpeed(magnitude, _supplyScale), 1);
+		}
+		if (_cutOut) {
+			spinState = Wheel::WHEEL_NO_SPIN;
+			magnitude = 0;
+		}
+		if (_wheels[i].stageSpin(spinState, magnitude, _batch)) wheelWrites++;
+		_currentDuty[i] = _cutOut ? 0 : duty[i];
+	});
+	if (wheelWrites) {
+		_batch.commit();
+		_hardwareWriteCount++;
+		_wheelWriteCount += wheelWrites;
+	}
+}
+
+//the robot's drive is compiled once, in Wheels.cpp
+extern template class DriveN<4>;
+
+#endif
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Crc8.h>
+
+#include "WheelCalibration.h"
+
+static const uint8_t calibrationEepromVersion = 1;
+
+//duty of the curve point at index
+static uint8_t pointDuty(uint8_t index) {
+	return (index < WheelCalibration::POINTS - 1) ? index * 16 : 255;
+}
+
+//default constructor: identity curves
+WheelCalibration::WheelCalibration() {
+	setIdentity();
+}
+
+void WheelCalibration::setIdentity() {
+	for (uint8_t i = 0; i < POINTS; i++) {
+		_points[FORWARD][i] = pointDuty(i);
+		_points[BACKWARD][i] = pointDuty(i);
+	}
+}
+
+//the duty range 0..255 is squeezed into start..255
+void WheelCalibration::setDeadband(WheelCalibration::Curve curve, uint8_t start) {
+	if (curve > BACKWARD) return;
+	for (uint8_t i = 0; i < POINTS; i++) _points[curve][i] = start + ((uint16_t)pointDuty(i) * (255 - start) + 127) / 255;
+}
+
+void WheelCalibration::setPoint(WheelCalibration::Curve curve, uint8_t index, uint8_t duty) {
+	if (curve > BACKWARD || index >= POINTS) return;
+	_points[curve][index] = duty;
+}
+
+uint8_t WheelCalibration::getPoint(WheelCalibration::Curve curve, uint8_t index) const {
+	if (curve > BACKWARD || index >= POINTS) return 0;
+	return _points[curve][index];
+}
+
+void WheelCalibration::save(int address, const WheelCalibration* calibrations, uint8_t count) {
+	uint8_t crc = 0;
+	uint8_t header[4] = { 'W', 'C', calibrationEepromVersion, count };
+	for (uint8_t i = 0; i < 4; i++) {
+		EEPROM.update(address++, header[i]);
+		crc = crc8Update(crc, header[i]);
+	}
+	for (uint8_t wheel = 0; wheel < count; wheel++) {
+		for (uint8_t curve = FORWARD; curve <= BACKWARD; curve++) {
+			for (uint8_t i = 0; i < POINTS; i++) {
+				EEPROM.update(address++, calibrations[wheel]._points[curve][i]);
+				crc = crc8Update(crc, calibrations[wheel]._points[curve][i]);
+			}
+		}
+	}
+	EEPROM.update(address, crc);
+}
+
+//the image is checked before anything is copied, a bad image does not leave half loaded curves
+bool WheelCalibration::load(int address, WheelCalibration* calibrations, uint8_t count) {
+	uint8_t crc = 0;
+	uint8_t header[4];
+	for (uint8_t i = 0; i < 4; i++) {
+		header[i] = EEPROM.read(address + i);
+		crc = crc8Update(crc, header[i]);
+	}
+	if (header[0] != 'W' || header[1] != 'C' || header[2] != calibrationEepromVersion || header[3] != count) return false;
+	int curves = address + 4;
+	int size = count * 2 * POINTS;
+	for (int i = 0; i < size; i++) crc = crc8Update(crc, EEPROM.read(curves + i));
+	if (EEPROM.read(curves + size) != crc) return false;
+
+	for (uint8_t wheel = 0; wheel < count; wheel++) {
+		for (uint8_t curve = FORWARD; curve <= BACKWARD; curve++) {
+			for (uint8_t i = 0; i < POINTS; i++) calibrations[wheel]._points[curve][i] = EEPROM.read(curves++);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+// WheelCalibration.h
+// included by Wheels.h, use Wheels.h
+#include <Arduino.h>
+
+#ifndef _WHEELCALIBRATION_h
+#define _WHEELCALIBRATION_h
+
+//per wheel duty correction: the limited duty is looked up in a curve for the spin direction and the
+//corrected duty is written to the speed pin. each curve has POINTS corrected duties, one every 16 duty
+//steps (0, 16 .. 240 and 255), duties between two points are interpolated with integer math
+//the first point is the deadband: the lowest duty that turns the motor, a duty of 0 still writes 0
+//the curves start as identity, so an uncalibrated wheel drives as before
+class WheelCalibration {
+public:
+	static const uint8_t POINTS = 17;
+
+	enum Curve : uint8_t {
+		FORWARD, BACKWARD
+	};
+
+	WheelCalibration(); //identity curves
+
+	void setIdentity();
+	//straight curve from the start duty to 255, for a motor with a plain deadband
+	void setDeadband(WheelCalibration::Curve curve, uint8_t start);
+	void setPoint(WheelCalibration::Curve curve, uint8_t index, uint8_t duty); //index out of range is ignored
+	uint8_t getPoint(WheelCalibration::Curve curve, uint8_t index) const;
+
+	//corrected duty, one table read pair and one multiply
+	uint8_t apply(uint8_t duty, WheelCalibration::Curve curve) const {
+		if (duty == 0) return 0;
+		const uint8_t* points = _points[curve];
+		if (duty == 255) return points[POINTS - 1];
+		uint8_t index = duty >> 4;
+		int16_t step = (int16_t)points[index + 1] - points[index];
+		if (index < POINTS - 2) return (uint8_t)(points[index] + ((step * (duty & 0x0F) + 8) >> 4));
+		//the top segment 240..255 spans 15 duty steps, / 15 as * 4369 >> 16 (exact after rounding)
+		return (uint8_t)(points[index] + (((int32_t)step * (duty & 0x0F) * 4369 + 32768) >> 16));
+	}
+
+	//EEPROM image of the calibrations of all wheels: "WC", version, count, the curves and a CRC-8
+	//only changed bytes are written, save while the robot is stopped
+	static int getEepromSize(uint8_t count) { return 5 + count * 2 * POINTS; }
+	static void save(int address, const WheelCalibration* calibrations, uint8_t count);
+	//false if there is no valid image for count wheels, the calibrations are then left unchanged
+	static bool load(int address, WheelCalibration* calibrations, uint8_t count);
+
+private:
+	uint8_t _points[2][POINTS]; //[Curve][index], corrected duty for the duty min(index * 16, 255)
+};
+
+#endif
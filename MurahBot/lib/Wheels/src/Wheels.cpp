@@ -5,7 +5,7 @@
 //default constructor: upon instantiation all the pin values and absolute speeds are stored in class variables 
 Wheel::Wheel(int pin1, int pin2, int pinSetSpeed, int minWheelAbsoluteSpeed, int maxWheelAbsoluteSpeed)
 	:_pinForward(pin1), _pinBackward(pin2), _pinSetSpeed(pinSetSpeed), 
-	_minWheelAbsoluteSpeed(minWheelAbsoluteSpeed), _maxWheelAbsoluteSpeed(maxWheelAbsoluteSpeed)  {
+	_minWheelAbsoluteSpeed(minWheelAbsoluteSpeed), _maxWheelAbsoluteSpeed(maxWheelAbsoluteSpeed), _calibration(0)  {
 	initWheel();
 	
 }
@@ -17,14 +17,20 @@ Wheel::Wheel(const Wheel& AWheel) {
 	_pinSetSpeed = AWheel._pinSetSpeed;
 	_minWheelAbsoluteSpeed = AWheel._minWheelAbsoluteSpeed;
 	_maxWheelAbsoluteSpeed = AWheel._maxWheelAbsoluteSpeed;
+	_calibration = AWheel._calibration;
+	_spinState = AWheel._spinState;
+	_duty = AWheel._duty;
+	_cacheValid = false; //both wheels now share the pins, the copy writes them on its first command
 }
 
 //called during instantiation automatically, sets-up the pins and state variables to appropriate states 
 void Wheel::initWheel() {
 	_spinState = WHEEL_NO_SPIN;
+	_duty = 0;
+	_cacheValid = true; //output pins start LOW, which is WHEEL_NO_SPIN at duty 0
 	_pinForward.mode(OUTPUT);
 	_pinBackward.mode(OUTPUT);
-	pinMode(_pinSetSpeed, OUTPUT); //the analog pin
+	_pinSetSpeed.begin(); //the analog pin
 }
 
 // returns _spinState
@@ -32,30 +38,80 @@ Wheel::WheelState Wheel::getCurrentWheelState() {
 	return _spinState;
 }
 
-//set spin Forward 
+//set spin Forward, only the pins that change are written
 void Wheel::setSpinForward(int speed) {
 	speed = limitWheelSpeed(speed);
-	_pinForward.high();
-	_pinBackward.low();
-	analogWrite(_pinSetSpeed, speed);
+	if (_spinState != WHEEL_SPIN_FORWARD || !_cacheValid) {
+		_pinForward.high();
+		_pinBackward.low();
+	}
+	if (speed != _duty || !_cacheValid || (_spinState != WHEEL_SPIN_FORWARD && _calibration)) { //each direction has its own curve
+		_pinSetSpeed.write(calibrateDuty(speed, WheelCalibration::FORWARD));
+	}
 	_spinState = WHEEL_SPIN_FORWARD;
+	_duty = speed;
+	_cacheValid = true;
 }
 
 //set spin Backward 
 void Wheel::setSpinBackward(int speed) {
 	speed = limitWheelSpeed(speed);
-	_pinBackward.high();
-	_pinForward.low();
-	analogWrite(_pinSetSpeed, speed);
+	if (_spinState != WHEEL_SPIN_BACKWARD || !_cacheValid) {
+		_pinBackward.high();
+		_pinForward.low();
+	}
+	if (speed != _duty || !_cacheValid || (_spinState != WHEEL_SPIN_BACKWARD && _calibration)) { //each direction has its own curve
+		_pinSetSpeed.write(calibrateDuty(speed, WheelCalibration::BACKWARD));
+	}
 	_spinState = WHEEL_SPIN_BACKWARD;
+	_duty = speed;
+	_cacheValid = true;
 }
 
 //set spin Stop
 void Wheel::setSpinStop() {
-	_pinForward.low();
-	_pinBackward.low();
-	analogWrite(_pinSetSpeed, 0);
+	if (_spinState != WHEEL_NO_SPIN || !_cacheValid) {
+		_pinForward.low();
+		_pinBackward.low();
+	}
+	if (_duty != 0 || !_cacheValid) _pinSetSpeed.write(0);
 	_spinState = WHEEL_NO_SPIN;
+	_duty = 0;
+	_cacheValid = true;
+}
+
+//stage spin, same pin levels and speed limits as the setSpin methods
+bool Wheel::stageSpin(Wheel::WheelState spinState, int speed, PortBatch& batch) {
+	if (spinState == WHEEL_NO_SPIN) speed = 0;
+	else speed = limitWheelSpeed(speed);
+	if (spinState == _spinState && speed == _duty && _cacheValid) return false;
+
+	if (spinState != _spinState || !_cacheValid) {
+		batch.stage(_pinForward, spinState == WHEEL_SPIN_FORWARD);
+		batch.stage(_pinBackward, spinState == WHEEL_SPIN_BACKWARD);
+	}
+	if (speed != _duty || !_cacheValid || (spinState != _spinState && _calibration)) {
+		batch.stagePwm(_pinSetSpeed, (spinState == WHEEL_NO_SPIN) ? 0
+			: calibrateDuty(speed, (spinState == WHEEL_SPIN_FORWARD) ? WheelCalibration::FORWARD : WheelCalibration::BACKWARD));
+	}
+	_spinState = spinState;
+	_duty = speed;
+	_cacheValid = true;
+	return true;
+}
+
+//returns the last written duty
+int Wheel::getCurrentDuty() {
+	return _duty;
+}
+
+void Wheel::invalidateCache() {
+	_cacheValid = false;
+}
+
+//sets the PWM frequency of the speed pin 
+bool Wheel::setPwmFrequency(unsigned long frequency, uint16_t resolution) {
+	return _pinSetSpeed.setPwmFrequency(frequency, resolution);
 }
 
 // return _max/_min Wheel Absolute Speeds 
@@ -74,6 +130,11 @@ void Wheel::setWheelAbsoluteSpeed(int minSpeedAbsolute, int maxSpeedAbsolute) {
 	_maxWheelAbsoluteSpeed = maxSpeedAbsolute;
 }
 
+void Wheel::setCalibration(const WheelCalibration* calibration) {
+	_calibration = calibration;
+	_cacheValid = false;
+}
+
 int Wheel::limitWheelSpeed(int wheelSpeed) {
 	if (wheelSpeed > _maxWheelAbsoluteSpeed) wheelSpeed = _maxWheelAbsoluteSpeed;
 	else if (wheelSpeed < _minWheelAbsoluteSpeed) wheelSpeed = _minWheelAbsoluteSpeed;
@@ -81,162 +142,12 @@ int Wheel::limitWheelSpeed(int wheelSpeed) {
 	return wheelSpeed;
 }
 
-
-//default constructor for 4 wheel drives robot 
-//stores the address of each wheel objects to local wheel object pointer for easy access 
-//stores the speed tolerance range to set the min and max drive speed
-Drive4Wheel::Drive4Wheel(Wheel& LeftFrontWheel, Wheel& RightFrontWheel,
-	Wheel& LeftRearWheel, Wheel& RightRearWheel, int speedToleranceRange)
-	:_LeftFrontWheel(&LeftFrontWheel), _RightFrontWheel(&RightFrontWheel),
-	_LeftRearWheel(&LeftRearWheel), _RightRearWheel(&RightRearWheel), _speedToleranceRange(speedToleranceRange) {
-	initDrive4Wheel();
-}
-
-
-//called during the instantiation pf the Drive4Wheel class 
-void Drive4Wheel::initDrive4Wheel() {
-	_setDriveSpeed();
-}
-
-//returns drive speed 
-int Drive4Wheel::getDriveSpeed(MinMaxRange rangeValue) {
-	if (rangeValue == MIN)
-		return _minDriveSpeed;
-	else if (rangeValue == MAX)
-		return _maxDriveSpeed;
-	else
-		return -1;
-}
-
-//returns the tolerance value for speed ranges
-int Drive4Wheel::getSpeedToleranceRange() {
-	return _speedToleranceRange;
-}
-
-//sets the tolerance value for speed ranges
-void Drive4Wheel::setSpeedToleranceRange(int speedTolerance) {
-	_speedToleranceRange = speedTolerance;
-	_setDriveSpeed();
-}
-
-//checks the input speed and ensures that the speed is capped to the max or min Drive speeds allowed for the Drive4Wheel class 
-//not invoked by any other methods of Drive4Wheel class (made available for users of Drive4Wheel class)
-int Drive4Wheel::limitDriveSpeed(int driveSpeed) {
-	if (driveSpeed > _maxDriveSpeed)driveSpeed = _maxDriveSpeed;
-	else if (driveSpeed < _minDriveSpeed)driveSpeed = _minDriveSpeed;
-	else driveSpeed = driveSpeed;
-	return driveSpeed;
+//the cached _duty stays the uncorrected one, so the drive sees the duties it asked for
+uint8_t Wheel::calibrateDuty(int duty, WheelCalibration::Curve curve) {
+	if (!_calibration) return (uint8_t)duty;
+	return _calibration->apply((uint8_t)constrain(duty, 0, 255), curve);
 }
 
-//Drive4Wheel methods for driving 
-void Drive4Wheel::goForward(int wheelSpeed) {
-	_LeftFrontWheel->setSpinForward(wheelSpeed);
-	_LeftRearWheel->setSpinForward(wheelSpeed);
-	_RightFrontWheel->setSpinForward(wheelSpeed);
-	_RightRearWheel->setSpinForward(wheelSpeed);
-
-	_driveState = DRIVE_FORWARD;
-}
-
-void Drive4Wheel::goBackward(int wheelSpeed) {
-	_LeftFrontWheel->setSpinBackward(wheelSpeed);
-	_LeftRearWheel->setSpinBackward(wheelSpeed);
-	_RightFrontWheel->setSpinBackward(wheelSpeed);
-	_RightRearWheel->setSpinBackward(wheelSpeed);
-
-	_driveState = DRIVE_BACKWARD;
-}
-
-void Drive4Wheel::goLeft(int wheelSpeed, float speedRatio) {
-	_RightFrontWheel->setSpinForward(wheelSpeed);
-	_RightRearWheel->setSpinForward(wheelSpeed);
-	_LeftFrontWheel->setSpinBackward(wheelSpeed*speedRatio);
-	_LeftRearWheel->setSpinBackward(wheelSpeed*speedRatio);
-
-	_driveState = DRIVE_LEFT;
-		
-}
-
-void Drive4Wheel::goRight(int wheelSpeed, float speedRatio) {
-
-	_LeftFrontWheel->setSpinForward(wheelSpeed);
-	_LeftRearWheel->setSpinForward(wheelSpeed);
-	_RightFrontWheel->setSpinBackward(wheelSpeed*speedRatio);
-	_RightRearWheel->setSpinBackward(wheelSpeed*speedRatio);
-
-	_driveState = DRIVE_RIGHT;
-	
-}
-
-void Drive4Wheel::swayLeft(int wheelSpeed, float speedRatio, bool reverse) {
-	if (reverse == true) {
-		_LeftFrontWheel->setSpinBackward(wheelSpeed*speedRatio);
-		_LeftRearWheel->setSpinBackward(wheelSpeed*speedRatio);
-		_RightFrontWheel->setSpinBackward(wheelSpeed);
-		_RightRearWheel->setSpinBackward(wheelSpeed);
-
-		_driveState = DRIVE_BACKWARD_LEFT;
-	}
-	else {
-		_LeftFrontWheel->setSpinForward(wheelSpeed*speedRatio);
-		_LeftRearWheel->setSpinForward(wheelSpeed*speedRatio);
-		_RightFrontWheel->setSpinForward(wheelSpeed);
-		_RightRearWheel->setSpinForward(wheelSpeed);
-
-		_driveState = DRIVE_FORWARD_LEFT;
-	}
-}
-
-void Drive4Wheel::swayRight(int wheelSpeed, float speedRatio, bool reverse) {
-	if (reverse == true) {
-		_LeftFrontWheel->setSpinBackward(wheelSpeed);
-		_LeftRearWheel->setSpinBackward(wheelSpeed);
-		_RightFrontWheel->setSpinBackward(wheelSpeed*speedRatio);
-		_RightRearWheel->setSpinBackward(wheelSpeed*speedRatio);
-
-		_driveState = DRIVE_BACKWARD_RIGHT;
-	}
-	else {
-		_LeftFrontWheel->setSpinForward(wheelSpeed);
-		_LeftRearWheel->setSpinForward(wheelSpeed);
-		_RightFrontWheel->setSpinForward(wheelSpeed*speedRatio);
-		_RightRearWheel->setSpinForward(wheelSpeed*speedRatio);
-
-		_driveState = DRIVE_FORWARD_RIGHT;
-	}
-}
-
-void Drive4Wheel::stop() {
-	_LeftFrontWheel->setSpinStop();
-	_LeftRearWheel->setSpinStop();
-	_RightFrontWheel->setSpinStop();
-	_RightRearWheel->setSpinStop();
-
-	_driveState = DRIVE_STOP;
-}
-
-//Drive4Wheels method to identify the drive state of the drive systems
-Drive4Wheel::DriveState Drive4Wheel::getCurrentDriveState() {
-	return _driveState;	
-}
-
-//private method to update the drive speed values
-void Drive4Wheel::_setDriveSpeed() {
-	_minDriveSpeed = max(_LeftFrontWheel->getWheelAbsoluteSpeed(MIN), max(_RightFrontWheel->getWheelAbsoluteSpeed(MIN),
-		max(_LeftRearWheel->getWheelAbsoluteSpeed(MIN), _RightRearWheel->getWheelAbsoluteSpeed(MIN))));
-	_maxDriveSpeed = min(_LeftFrontWheel->getWheelAbsoluteSpeed(MAX), min(_RightFrontWheel->getWheelAbsoluteSpeed(MAX),
-		min(_LeftRearWheel->getWheelAbsoluteSpeed(MAX), _RightRearWheel->getWheelAbsoluteSpeed(MAX))));
-	//the minimum and maximum drivespeeds are evaluated from each absolute speed values of the wheels. 
-	_minDriveSpeed = _minDriveSpeed + _speedToleranceRange;
-	_maxDriveSpeed = _maxDriveSpeed - _speedToleranceRange;
-	int biggerValue;
-	if (_minDriveSpeed > _maxDriveSpeed) {
-		biggerValue = _minDriveSpeed;
-		_minDriveSpeed = _maxDriveSpeed;
-		_maxDriveSpeed = biggerValue;
-	}//checks if the tolerance value given causes the values to reach an incorrect range 
-	 //if yes the higher and lower values are reset appropriately minDriveSpeed < maxDriveSpeed 
-	else;
-
-}
 
+//the 4 wheel drive is instantiated here once, the other wheel counts where they are used
+template class DriveN<4>;
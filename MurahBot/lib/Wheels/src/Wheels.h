@@ -1,6 +1,7 @@
 // Wheels.h
 //#include <>
-#include <DigitalIO.h>
+#include <PinHAL.h>
+#include "WheelCalibration.h"
 
 #ifndef _WHEELS_h
 #define _WHEELS_h
@@ -10,6 +11,36 @@ enum MinMaxRange : uint8_t {
 	MIN, MAX
 }; 
 
+//Q8.8 fixed point speed ratio (raw value 256 == 1.0)
+//the ATmega2560 has no FPU, ratios in this format are applied with one integer multiply and shift
+struct SpeedRatioQ8 {
+	uint16_t raw;
+};
+
+//converts a float ratio to Q8.8, evaluated at compile time when given a constant
+constexpr SpeedRatioQ8 toSpeedRatioQ8(float ratio) {
+	return SpeedRatioQ8{ (uint16_t)(ratio * 256 + 0.5f) };
+}
+
+//converts a ratio given as a multiple of 100 to Q8.8 without float math
+inline SpeedRatioQ8 percentToSpeedRatioQ8(uint8_t percent) {
+	return SpeedRatioQ8{ (uint16_t)(((uint16_t)percent * 256 + 50) / 100) };
+}
+
+//supply compensation ratio nominal / measured voltage, up to 2.0. 1.0 below minMilliVolts: no pack
+//or a broken divider is not compensated
+inline SpeedRatioQ8 supplyScaleQ8(unsigned long milliVolts, unsigned long nominalMilliVolts, unsigned long minMilliVolts) {
+	if (milliVolts < minMilliVolts) return SpeedRatioQ8{ 256 };
+	unsigned long scale = nominalMilliVolts * 256 / milliVolts;
+	return SpeedRatioQ8{ (uint16_t)((scale > 512) ? 512 : scale) };
+}
+
+//true once the ratios are hysteresis Q8.8 steps apart or more, keeps a noisy reading from
+//committing the duties on every sample
+inline bool speedRatioMoved(SpeedRatioQ8 from, SpeedRatioQ8 to, uint16_t hysteresis) {
+	return to.raw + hysteresis <= from.raw || from.raw + hysteresis <= to.raw;
+}
+
 //class to initialize the wheels of the robot. ONE instance for EACH wheel!!
 class Wheel {
 
@@ -32,76 +63,59 @@ public:
 	void setSpinBackward(int speed); //set backward spin 
 	void setSpinStop(); //stop spin
 
+	//stages the spin into a PortBatch instead of writing the pins, the pins change on batch.commit()
+	//returns false and stages nothing if the wheel already spins that way at that duty
+	bool stageSpin(Wheel::WheelState spinState, int speed, PortBatch& batch);
+
+	//the last committed state and duty are cached and unchanged writes are skipped (write-through cache)
+	//invalidateCache() forces the next command to write the pins, e.g. after the pins were written directly
+	int getCurrentDuty();
+	void invalidateCache();
+
+	//sets the PWM frequency and resolution of the speed pin, see PwmPin::setPwmFrequency()
+	//call from setup(), returns false if the pin's timer cannot be reconfigured
+	bool setPwmFrequency(unsigned long frequency, uint16_t resolution = 0);
+
 	int getWheelAbsoluteSpeed(MinMaxRange rangeValue); //return _minWheelAbsoluteSpeed / _maxAbsoluteSpeed
 	void setWheelAbsoluteSpeed(int minSpeedAbsolute, int maxSpeedAbsolute); //resets the _min/_max Wheel Absolute Speed
+
+	//the limited duty goes through the calibration curves before it is written, 0 (default) writes it as is
+	//the calibration is not copied, it must outlive the wheel. call again after changing its points,
+	//the next command then writes the corrected duty even if the duty did not change
+	void setCalibration(const WheelCalibration* calibration);
+	const WheelCalibration* getCalibration() { return _calibration; }
 	
 	
 
 private:
 	//int _pinForward; //pin that turns wheel forward with a High (relative to the robot)
 	//int _pinBackward; //pin that turns wheel backward with a High (relative to the robot)
-	PinIO _pinForward;
-	PinIO _pinBackward;
-	int _pinSetSpeed; //pin that controls motor speed, analogWrite()
+	OutputPin _pinForward;
+	OutputPin _pinBackward;
+	PwmPin _pinSetSpeed; //pin that controls motor speed, analogWrite()
 	Wheel::WheelState _spinState; // tracks the state/direction of wheel spin
+	int _duty; //last duty written to _pinSetSpeed
+	bool _cacheValid; //false if the pins may not match _spinState and _duty
 	int _minWheelAbsoluteSpeed;  //lowest speed the wheel can turn 
 	int _maxWheelAbsoluteSpeed;	//highest speed the wheel can turn 
+	const WheelCalibration* _calibration; //duty correction of this motor, 0 if none
 
 	int limitWheelSpeed(int wheelSpeed); //checks if wheel speed within absolute range, if not clips it 
+	uint8_t calibrateDuty(int duty, WheelCalibration::Curve curve); //the duty written to _pinSetSpeed
 	
 	//PinIO* _pinSetSpeed;
 			
 };
 
-
-class Drive4Wheel {
-public:
-	Drive4Wheel(Wheel& LeftFrontWheel, Wheel& RightFrontWheel,
-		Wheel& LeftRearWheel, Wheel& RightRearWheel, int speedToleranceRange); //default constructor with 4 Wheel instatiation and speed tolerance 
-	//speed tolerance range ensure that the wheel speeds are clipped below that range from the absolute max and min  
-	
-	//initialize the drive speed for the drive4wheel object 
-	void initDrive4Wheel();  
-
-	//method to check and limit the speed before invoking the drive methods for users //not neccesary for all cases 
-	int limitDriveSpeed(int driveSpeed); 
-	
-	//methods to drive 
-	void goForward(int speed);
-	void goBackward(int speed);
-	void goLeft(int wheelSpeed, float speedRatio = 1.0);
-	void goRight(int wheelSpeed, float speedRatio = 1.0);
-	void swayLeft(int wheelSpeed, float speedRatio = 0.8, bool reverse = false);
-	void swayRight(int wheelSpeed, float speedRatio = 0.8, bool reverse = false);
-	void stop();
-
-	enum DriveState : uint8_t {
-		DRIVE_STOP, DRIVE_FORWARD, DRIVE_BACKWARD, DRIVE_LEFT, DRIVE_RIGHT, DRIVE_FORWARD_LEFT,
-		DRIVE_FORWARD_RIGHT, DRIVE_BACKWARD_LEFT, DRIVE_BACKWARD_RIGHT
-	}; //all the robot drive states that are relevant to the Drive class 
-
-	//methods to get and set _speedToleranceRange that updates the drive speed values 
-	int getSpeedToleranceRange();
-	void setSpeedToleranceRange(int speedTolerance);
-
-	//methods to get the drive speed values and current drive state 
-	int getDriveSpeed(MinMaxRange rangeValue);
-	DriveState getCurrentDriveState();
-
-private:
-	int _maxDriveSpeed = 0;
-	int _minDriveSpeed = 0;
-	DriveState _driveState; //return to robot drive state based on the wheel spin conditions
-
-	void _setDriveSpeed(); //private method to update the drive speeds with the current _speedToleranceRange value
-
-	Wheel* _LeftFrontWheel;
-	Wheel* _RightFrontWheel;
-	Wheel* _LeftRearWheel;
-	Wheel* _RightRearWheel;
-	int _speedToleranceRange; //the tolerance between the absolute speeds of the Wheel instance and allowable drive speed
+//pins of one wheel (forward, backward, PWM speed), the drives construct their wheels from them in place
+struct WheelPins {
+	uint8_t forward;
+	uint8_t backward;
+	uint8_t speed;
 };
 
+//the drive classes, DriveN<N> and its 4 wheel alias Drive4Wheel
+#include "DriveN.h"
 
 #endif
 
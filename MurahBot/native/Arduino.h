@@ -0,0 +1,57 @@
+// Arduino.h (native)
+// minimal stand-in for the Arduino core used by the [env:native] host build
+// only the parts of the core that the MurahBot libraries use are declared here,
+// pin and clock functions are implemented by the PinHALMock backend in lib/PinHAL
+
+#ifndef _NATIVE_ARDUINO_h
+#define _NATIVE_ARDUINO_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+//flash memory access is plain memory access on the host
+#define PROGMEM
+#define F(string_literal) (string_literal)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define memcpy_P(dest, src, n) memcpy((dest), (src), (n))
+
+//interrupts do not exist on the host, masking them is a no-op
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int duty);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+//the AVR core defines these as macros, templates keep the host standard headers usable
+template <class T, class U>
+inline typename std::common_type<T, U>::type min(T a, U b) { return (a < b) ? a : b; }
+template <class T, class U>
+inline typename std::common_type<T, U>::type max(T a, U b) { return (a > b) ? a : b; }
+template <class T, class L, class H>
+inline T constrain(T x, L low, H high) { return (x < low) ? low : ((x > high) ? high : x); }
+
+#endif
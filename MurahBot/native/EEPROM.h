@@ -0,0 +1,58 @@
+// EEPROM.h (native)
+// stand-in for the Arduino EEPROM library in the [env:native] host build
+// 4 KB like the ATmega2560, erased to 0xFF, kept in RAM for the life of the program
+// the writes are counted so host runs can check the wear of a save
+
+#ifndef _NATIVE_EEPROM_h
+#define _NATIVE_EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+//the memory and counter are shared by every translation unit, like the one EEPROM of the chip
+struct EEPROMStorage {
+	static const int SIZE = 4096;
+	uint8_t data[SIZE];
+	unsigned long writes;
+	EEPROMStorage() :writes(0) { memset(data, 0xFF, sizeof(data)); }
+};
+
+inline EEPROMStorage& eepromStorage() {
+	static EEPROMStorage storage;
+	return storage;
+}
+
+//stateless accessor, the Arduino library also gives every translation unit its own static instance
+class EEPROMClass {
+public:
+	uint8_t read(int address) { return inRange(address) ? eepromStorage().data[address] : 0xFF; }
+	void write(int address, uint8_t value) {
+		if (!inRange(address)) return;
+		eepromStorage().data[address] = value;
+		eepromStorage().writes++;
+	}
+	void update(int address, uint8_t value) { if (read(address) != value) write(address, value); }
+	uint16_t length() { return EEPROMStorage::SIZE; }
+
+	template <class T> T& get(int address, T& value) {
+		uint8_t* bytes = (uint8_t*)&value;
+		for (unsigned int i = 0; i < sizeof(T); i++) bytes[i] = read(address + i);
+		return value;
+	}
+	template <class T> const T& put(int address, const T& value) {
+		const uint8_t* bytes = (const uint8_t*)&value;
+		for (unsigned int i = 0; i < sizeof(T); i++) update(address + i, bytes[i]);
+		return value;
+	}
+
+	//host only
+	unsigned long getWrites() { return eepromStorage().writes; } //bytes actually written
+	void erase() { memset(eepromStorage().data, 0xFF, EEPROMStorage::SIZE); }
+
+private:
+	bool inRange(int address) { return address >= 0 && address < EEPROMStorage::SIZE; }
+};
+
+static EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,58 @@
+#include "BenchClock.h"
+
+#ifdef ARDUINO
+
+#include <avr/interrupt.h>
+
+//upper 16 bits of the cycle counter, extended in the Timer1 overflow interrupt
+static volatile uint16_t benchClockOverflows = 0;
+
+ISR(TIMER1_OVF_vect) {
+	benchClockOverflows++;
+}
+
+//Timer1 in normal mode without prescaler, no output compare pins are touched
+void BenchClock::begin() {
+	noInterrupts();
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1 = 0;
+	TIFR1 = _BV(TOV1);
+	TIMSK1 = _BV(TOIE1);
+	TCCR1B = _BV(CS10);
+	benchClockOverflows = 0;
+	interrupts();
+}
+
+uint32_t BenchClock::now() {
+	uint8_t oldSREG = SREG;
+	noInterrupts();
+	uint16_t low = TCNT1;
+	uint16_t high = benchClockOverflows;
+	if ((TIFR1 & _BV(TOV1)) && low < 0x8000) high++; //overflow pending but not yet serviced
+	SREG = oldSREG;
+	return ((uint32_t)high << 16) | low;
+}
+
+const char* BenchClock::unit() {
+	return "cycles";
+}
+
+#else
+
+#include <chrono>
+
+void BenchClock::begin() {
+}
+
+uint32_t BenchClock::now() {
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+const char* BenchClock::unit() {
+	return "ns";
+}
+
+#endif
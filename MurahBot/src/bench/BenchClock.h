@@ -0,0 +1,17 @@
+// BenchClock.h
+// time base for the drive benchmarks
+// on the AVR Timer1 free runs at F_CPU so one tick is one CPU cycle
+// on the host one tick is one nanosecond of the steady clock
+#include <Arduino.h>
+
+#ifndef _BENCHCLOCK_h
+#define _BENCHCLOCK_h
+
+class BenchClock {
+public:
+	static void begin(); //starts the time base, Timer1 on the AVR
+	static uint32_t now(); //current tick count
+	static const char* unit(); //"cycles" or "ns"
+};
+
+#endif
@@ -0,0 +1,324 @@
+// DriveBench.cpp
+// micro-benchmarks of the drive path, runs the real Wheel, Drive4Wheel and JoystickDrive code
+// [env:native]: against the PinHALMock backend, reports ns/call, calls/sec and pin writes per call
+// [env:megaatmega2560_bench]: on the robot, reports CPU cycles per call on Serial at 115200
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <JoystickDrive.h>
+#include <SharedJoystick.h>
+#include <DriveTelemetry.h>
+#include <CommandLink.h>
+#include <ControlLoop.h>
+#include <AppTelemetry.h>
+
+#include "BenchClock.h"
+
+#ifndef ARDUINO
+#include <stdio.h>
+
+void runSpeedControlBench(); //SpeedControlBench.cpp
+#endif
+void runReplayBench(); //ReplayBench.cpp
+
+int speedTolerance = 30;
+Drive4Wheel murahDrive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, speedTolerance); //same wiring as src/main.cpp
+JoystickDrive murahJoystick(murahDrive);
+
+#ifdef ARDUINO
+const unsigned long BENCH_ITERATIONS = 1000;
+#else
+const unsigned long BENCH_ITERATIONS = 1000000;
+#endif
+
+//prevents the compiler from dropping benchmark loops with no visible result
+volatile int benchSink;
+
+typedef void(*BenchFunction)(unsigned long iteration);
+
+//prints one result line
+void benchReport(const char* name, uint32_t ticks) {
+#ifdef ARDUINO
+	Serial.print(name);
+	Serial.print(F(": "));
+	Serial.print((float)ticks / BENCH_ITERATIONS);
+	Serial.print(' ');
+	Serial.print(BenchClock::unit());
+	Serial.println(F("/call"));
+#else
+	double seconds = ticks * 1e-9;
+	printf("%-28s %8.1f ns/call %12.0f calls/sec %6.2f pin writes/call (%.2f digital, %.2f port, %.2f pwm)\n",
+		name, (double)ticks / BENCH_ITERATIONS, BENCH_ITERATIONS / seconds,
+		(double)PinHALMock::getPinWrites() / BENCH_ITERATIONS,
+		(double)PinHALMock::getDigitalWrites() / BENCH_ITERATIONS,
+		(double)PinHALMock::getPortWrites() / BENCH_ITERATIONS,
+		(double)PinHALMock::getPwmWrites() / BENCH_ITERATIONS);
+#endif
+}
+
+//runs the function BENCH_ITERATIONS times and reports the time per call
+void runBench(const char* name, BenchFunction function) {
+#ifndef ARDUINO
+	PinHALMock::reset();
+#endif
+	uint32_t start = BenchClock::now();
+	for (unsigned long i = 0; i < BENCH_ITERATIONS; i++) function(i);
+	benchReport(name, BenchClock::now() - start);
+}
+
+//drive commands
+void benchGoForward(unsigned long i) { murahDrive.goForward(150 + (i & 63)); }
+void benchGoBackward(unsigned long i) { murahDrive.goBackward(150 + (i & 63)); }
+void benchGoLeft(unsigned long i) { murahDrive.goLeft(150 + (i & 63)); }
+void benchSwayRight(unsigned long i) { murahDrive.swayRight(150 + (i & 63), toSpeedRatioQ8(0.5), (i & 1)); }
+void benchStop(unsigned long i) { murahDrive.stop(); benchSink = i; }
+
+//repeated identical commands, what taskDrive sends while the joystick is held still
+void benchGoForwardUnchanged(unsigned long i) { murahDrive.goForward(200); benchSink = i; }
+
+//the wheel by wheel writes that goForward did before the batched PortBatch commit
+void benchSequentialForward(unsigned long i) {
+	murahDrive.getWheel(Drive4Wheel::LEFT_FRONT).setSpinForward(150 + (i & 63));
+	murahDrive.getWheel(Drive4Wheel::LEFT_REAR).setSpinForward(150 + (i & 63));
+	murahDrive.getWheel(Drive4Wheel::RIGHT_FRONT).setSpinForward(150 + (i & 63));
+	murahDrive.getWheel(Drive4Wheel::RIGHT_REAR).setSpinForward(150 + (i & 63));
+}
+
+//the 2 and 6 wheel chassis variants, on pins the robot does not use: not the start/stop button (pin 22),
+//no PWM on Timer1 (pins 11, 12), which runs BenchClock, or on Timer5 (pins 44-46), which the control
+//loop bench reprograms. the 2 wheel drive shares the Timer3 speed pins 2 and 3 with the 6 wheel one,
+//the benchmarks run one after the other
+const WheelPins benchPins2[2] = { { 24, 25, 2 }, { 26, 27, 3 } };
+const WheelPins benchPins6[6] = { { 28, 29, 2 }, { 30, 31, 3 }, { 32, 33, 8 },
+	{ 34, 35, 9 }, { 36, 37, 10 }, { 38, 39, 13 } };
+DriveN<2> benchDrive2(benchPins2, speedTolerance);
+DriveN<6> benchDrive6(benchPins6, speedTolerance);
+void benchDrive2Forward(unsigned long i) { benchDrive2.goForward(150 + (i & 63)); }
+void benchDrive6Forward(unsigned long i) { benchDrive6.goForward(150 + (i & 63)); }
+void benchDrive6Sway(unsigned long i) { benchDrive6.swayRight(150 + (i & 63), toSpeedRatioQ8(0.5), (i & 1)); }
+
+//PWM duty write through the direct timer register driver versus the core's analogWrite()
+PwmPin benchPwmPin(5);
+void benchPwmPinWrite(unsigned long i) { benchPwmPin.write(1 + (i & 127)); }
+void benchAnalogWrite(unsigned long i) { analogWrite(5, 1 + (i & 127)); }
+
+//joystick samples, the full pad is swept so every Primary and Secondary branch is taken
+void benchJoystickSweep(unsigned long i) { murahJoystick.drive(i & 0xFF, (i >> 8) & 0xFF); }
+void benchJoystickCenter(unsigned long i) { murahJoystick.drive(120 + (i & 7), 120 + ((i >> 3) & 7)); }
+
+//float versus Q8.8 drive tick for a forward sway left sample (joystick up and left)
+//the float tick is the joystick path before the fixed point speed ratios:
+//float turn ratio through map(), divided by 100 and handed to the float swayLeft()
+void benchSwayTickFloat(unsigned long i) {
+	int joystickX = i & 63;
+	int joystickY = 192 + (i & 63);
+	int speed = map(joystickY, Y_THRESHOLD_HIGH, 255, murahDrive.getDriveSpeed(MIN), murahDrive.getDriveSpeed(MAX));
+	float turnRatio = map(joystickX, X_THRESHOLD_LOW, 0, 45.0f, 60.0f);
+	murahDrive.swayLeft(speed, (turnRatio / 100));
+}
+
+void benchSwayTickFixed(unsigned long i) {
+	murahJoystick.driveSecondary(i & 63, 192 + (i & 63));
+}
+
+//telemetry of a changing drive into an output that takes 8 bytes per flush, about 9600 baud at a
+//1 ms tick: frames are queued until the ring buffer is full and then dropped, the tick never waits
+struct BenchTelemetryOutput {
+	unsigned long bytes = 0;
+	int availableForWrite() { return 8; }
+	void write(uint8_t value) { bytes++; benchSink = value; }
+};
+DriveTelemetry benchTelemetry(murahDrive, 0, 1000);
+BenchTelemetryOutput benchTelemetryOutput;
+void benchTelemetryTick(unsigned long i) {
+	murahDrive.goForward(150 + (i & 63));
+	benchTelemetry.sample();
+	benchTelemetry.flush(benchTelemetryOutput);
+}
+
+void benchReportTelemetry() {
+#ifdef ARDUINO
+	Serial.print(F("telemetry frames: "));
+	Serial.print(benchTelemetry.getSentFrames());
+	Serial.print(F(", dropped: "));
+	Serial.println(benchTelemetry.getDroppedFrames());
+#else
+	printf("telemetry frames: %lu, dropped: %lu, bytes out: %lu\n", benchTelemetry.getSentFrames(),
+		benchTelemetry.getDroppedFrames(), benchTelemetryOutput.bytes);
+#endif
+}
+
+//parser cost of one framed joystick command, byte by byte like taskCommandLink feeds it
+CommandParser benchParser;
+CommandFrame benchFrame;
+void benchCommandParse(unsigned long i) {
+	const uint8_t* bytes = &benchFrame.sync;
+	for (uint8_t b = 0; b < CommandFrame::SIZE; b++) {
+		if (benchParser.feed(bytes[b])) benchSink = benchParser.getFrame().payload[0] + i;
+	}
+}
+
+#ifndef ARDUINO
+//robot side of a ping round trip: ISR bytes in, parse, pong queued and drained by the TX ISR
+//the wire adds 2 x 8 bytes at 115200 baud (1.4 ms) plus the BLE module, see tools/link_latency.py
+CommandLink benchLink;
+void benchCommandRoundTrip(unsigned long i) {
+	const uint8_t* bytes = &benchFrame.sync;
+	for (uint8_t b = 0; b < CommandFrame::SIZE; b++) CommandLink::receiveByte(bytes[b]);
+	while (benchLink.poll()) benchLink.reply(benchLink.getFrame());
+	uint8_t byte;
+	while (CommandLink::nextTransmitByte(byte)) benchSink = byte + i;
+}
+#endif
+
+//the ramp at 500 Hz from the Timer5 interrupt for a second while the main loop keeps commanding
+//the drive inside a ControlLoop::Lock: period jitter, step runtime and overruns
+void benchControlStep() { murahDrive.updateRamp(); }
+void benchControlLoop() {
+	murahDrive.enableRamp(true);
+	ControlLoop::begin(500, &benchControlStep);
+	for (unsigned long i = 0; i < 500; i++) {
+		{
+			ControlLoop::Lock lock;
+			murahDrive.goForward(150 + (i & 63));
+		}
+#ifdef ARDUINO
+		delay(2);
+#else
+		ControlLoop::tick();
+#endif
+	}
+	ControlLoop::end();
+	murahDrive.enableRamp(false);
+	ControlLoop::Stats stats;
+	ControlLoop::getStats(stats);
+#ifdef ARDUINO
+	Serial.print(F("control loop 500 Hz: steps "));
+	Serial.print(stats.steps);
+	Serial.print(F(", overruns "));
+	Serial.print(stats.overruns);
+	Serial.print(F(", missed "));
+	Serial.print(stats.missed);
+	Serial.print(F(", jitter us mean/max "));
+	Serial.print(stats.latencyMean);
+	Serial.print('/');
+	Serial.print(stats.latencyMax);
+	Serial.print(F(", runtime us max "));
+	Serial.println(stats.runtimeMax);
+#else
+	printf("control loop 500 Hz: steps %lu, overruns %lu, missed %lu, jitter us mean/max %lu/%lu, runtime us max %lu\n",
+		stats.steps, stats.overruns, stats.missed, stats.latencyMean, stats.latencyMax, stats.runtimeMax);
+#endif
+}
+
+//drive commands issued versus the ones that reached the pins over all the benchmarks
+void benchReportCommandCounters() {
+#ifdef ARDUINO
+	Serial.print(F("drive commands: "));
+	Serial.print(murahDrive.getCommandCount());
+	Serial.print(F(", hardware writes: "));
+	Serial.print(murahDrive.getHardwareWriteCount());
+	Serial.print(F(", wheel writes: "));
+	Serial.println(murahDrive.getWheelWriteCount());
+#else
+	printf("drive commands: %lu, hardware writes: %lu, wheel writes: %lu\n", murahDrive.getCommandCount(),
+		murahDrive.getHardwareWriteCount(), murahDrive.getWheelWriteCount());
+#endif
+}
+
+//one joystick sample written and taken by the drive through the sequence lock
+SharedJoystick benchJoystickInput;
+void benchSharedJoystick(unsigned long i) {
+	JoystickSnapshot snapshot;
+	benchJoystickInput.writeAt(i, i & 0xFF, (i >> 8) & 0xFF);
+	benchJoystickInput.consume(snapshot);
+	benchSink = snapshot.x + snapshot.y;
+}
+
+//app telemetry fields refreshed and a push prepared on every call: pushes are rare, the cost that
+//matters is the refresh and the due check of the calls that push nothing
+AppTelemetry benchTelemetryApp(10, 12, 250, 2000, 300);
+void benchAppTelemetryRefresh(unsigned long i) {
+	for (uint8_t field = 0; field < 12; field++) benchTelemetryApp.set(field, 150 + ((i + field) & 3));
+	benchSink = benchTelemetryApp.prepare(63);
+}
+
+//deadband curves on all wheels, the cost of the curve lookup per duty write
+WheelCalibration benchCalibration[Drive4Wheel::WHEEL_COUNT];
+void attachBenchCalibration(bool attach) {
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		benchCalibration[i].setDeadband(WheelCalibration::FORWARD, 140 + i);
+		murahDrive.getWheel(i).setCalibration(attach ? &benchCalibration[i] : 0);
+	}
+}
+
+void runAllBenches() {
+	runBench("Drive4Wheel::goForward", &benchGoForward);
+	attachBenchCalibration(true);
+	runBench("goForward (calibrated)", &benchGoForward);
+	attachBenchCalibration(false);
+	runBench("4 x Wheel::setSpinForward", &benchSequentialForward);
+	runBench("Drive4Wheel::goBackward", &benchGoBackward);
+	runBench("Drive4Wheel::goLeft", &benchGoLeft);
+	runBench("Drive4Wheel::swayRight", &benchSwayRight);
+	runBench("Drive4Wheel::stop", &benchStop);
+	runBench("goForward unchanged (cached)", &benchGoForwardUnchanged);
+	runBench("DriveN<2>::goForward", &benchDrive2Forward);
+	runBench("DriveN<6>::goForward", &benchDrive6Forward);
+	runBench("DriveN<6>::swayRight", &benchDrive6Sway);
+	benchPwmPin.begin();
+	runBench("PwmPin::write", &benchPwmPinWrite);
+	runBench("analogWrite", &benchAnalogWrite);
+	murahDrive.getWheel(Drive4Wheel::LEFT_FRONT).invalidateCache(); //pin 5 was written behind the wheel's back
+	runBench("JoystickDrive sweep", &benchJoystickSweep);
+	runBench("JoystickDrive center", &benchJoystickCenter);
+	murahJoystick.useLookupTable(true);
+	runBench("JoystickDrive sweep (table)", &benchJoystickSweep);
+	runBench("JoystickDrive center (table)", &benchJoystickCenter);
+	murahJoystick.useLookupTable(false);
+	murahJoystick.useMixing(true);
+	runBench("JoystickDrive sweep (mixed)", &benchJoystickSweep);
+	runBench("JoystickDrive center (mixed)", &benchJoystickCenter);
+	murahJoystick.useMixing(false);
+	runBench("sway tick float", &benchSwayTickFloat);
+	runBench("sway tick Q8.8", &benchSwayTickFixed);
+	runBench("drive + telemetry tick", &benchTelemetryTick);
+	benchReportTelemetry();
+	runBench("AppTelemetry refresh", &benchAppTelemetryRefresh);
+	runBench("SharedJoystick write + consume", &benchSharedJoystick);
+	const uint8_t benchPayload[4] = { 200, 90, 0, 0 };
+	encodeCommandFrame(COMMAND_PING, 1, benchPayload, benchFrame);
+	runBench("CommandParser 8 byte frame", &benchCommandParse);
+#ifndef ARDUINO
+	runBench("CommandLink ping round trip", &benchCommandRoundTrip);
+#endif
+	benchControlLoop();
+	benchReportCommandCounters();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+	Serial.begin(115200);
+	BenchClock::begin();
+	Serial.println(F("MurahBot drive benchmarks"));
+	runAllBenches();
+	runReplayBench();
+	murahDrive.stop();
+}
+
+void loop() {
+}
+
+#else
+
+int main() {
+	printf("MurahBot drive benchmarks, %lu iterations each\n", BENCH_ITERATIONS);
+	BenchClock::begin();
+	runAllBenches();
+	runReplayBench();
+	runSpeedControlBench();
+	return 0;
+}
+
+#endif
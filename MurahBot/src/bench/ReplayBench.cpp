@@ -0,0 +1,118 @@
+// ReplayBench.cpp
+// joystick trace benchmarks: standard traces are recorded with JoystickRecorder and replayed sample
+// by sample through JoystickDrive and Drive4Wheel, in every decoding mode (thresholds, table, mixing)
+// per trace: decision time per sample, drive hardware writes and wheel writes per sample, and the
+// Drive4Wheel state transitions. the replay order and values come from the recording only, so the
+// numbers are comparable between runs and between the host and the robot
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <JoystickDrive.h>
+#include <JoystickRecorder.h>
+
+#include "BenchClock.h"
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+extern Drive4Wheel murahDrive;
+extern JoystickDrive murahJoystick;
+
+JoystickRecorder benchRecorder;
+const unsigned long traceSampleMs = 20; //a 50 Hz joystick
+
+//small deterministic noise, the same on every run and platform
+uint16_t traceNoiseState = 1;
+int traceNoise(int range) {
+	traceNoiseState = traceNoiseState * 25173 + 13849;
+	return (int)((traceNoiseState >> 8) % (2 * range + 1)) - range;
+}
+
+//the stick resting at the center with sensor noise, nothing should move
+void recordCenterJitter() {
+	traceNoiseState = 1;
+	for (uint16_t i = 0; i < JoystickRecorder::CAPACITY; i++) {
+		benchRecorder.recordAt(i * traceSampleMs, 128 + traceNoise(12), 128 + traceNoise(12));
+	}
+}
+
+//x swept across its range with the stick forward, then y swept from back to front
+void recordFullSweeps() {
+	uint16_t half = JoystickRecorder::CAPACITY / 2;
+	for (uint16_t i = 0; i < half; i++) benchRecorder.recordAt(i * traceSampleMs, i * 255 / (half - 1), 220);
+	for (uint16_t i = 0; i < half; i++) benchRecorder.recordAt((half + i) * traceSampleMs, 128, i * 255 / (half - 1));
+}
+
+//full forward and full backward, 100 ms each, with a little noise on x
+void recordRapidReversals() {
+	traceNoiseState = 7;
+	for (uint16_t i = 0; i < JoystickRecorder::CAPACITY; i++) {
+		benchRecorder.recordAt(i * traceSampleMs, 128 + traceNoise(6), ((i / 5) & 1) ? 0 : 255);
+	}
+}
+
+//replays the recording in one decoding mode and prints one line
+void replayTrace(const char* trace, const char* mode) {
+	murahDrive.stop();
+	murahDrive.resetCommandCounters();
+#ifndef ARDUINO
+	PinHALMock::reset();
+#endif
+	uint16_t samples = benchRecorder.getCount();
+	unsigned long transitions = 0;
+	uint32_t ticks = 0;
+	Drive4Wheel::DriveState state = murahDrive.getCurrentDriveState();
+	for (uint16_t i = 0; i < samples; i++) {
+		JoystickRecord record = benchRecorder.get(i);
+		uint32_t start = BenchClock::now();
+		murahJoystick.drive(record.x, record.y);
+		ticks += BenchClock::now() - start;
+		if (murahDrive.getCurrentDriveState() != state) transitions++;
+		state = murahDrive.getCurrentDriveState();
+	}
+#ifdef ARDUINO
+	Serial.print(trace);
+	Serial.print(' ');
+	Serial.print(mode);
+	Serial.print(F(": "));
+	Serial.print((float)ticks / samples);
+	Serial.print(' ');
+	Serial.print(BenchClock::unit());
+	Serial.print(F("/sample, hw writes/sample "));
+	Serial.print((float)murahDrive.getHardwareWriteCount() / samples);
+	Serial.print(F(", wheel writes/sample "));
+	Serial.print((float)murahDrive.getWheelWriteCount() / samples);
+	Serial.print(F(", transitions "));
+	Serial.println(transitions);
+#else
+	printf("%-16s %-10s %7.1f ns/sample %5.2f hw writes %5.2f wheel writes %5.2f pin writes/sample %4lu transitions\n",
+		trace, mode, (double)ticks / samples, (double)murahDrive.getHardwareWriteCount() / samples,
+		(double)murahDrive.getWheelWriteCount() / samples, (double)PinHALMock::getPinWrites() / samples, transitions);
+#endif
+}
+
+void replayTraceAllModes(const char* trace) {
+	murahJoystick.useMixing(false);
+	murahJoystick.useLookupTable(false);
+	replayTrace(trace, "threshold");
+	murahJoystick.useLookupTable(true);
+	replayTrace(trace, "table");
+	murahJoystick.useMixing(true);
+	replayTrace(trace, "mixed");
+	murahJoystick.useMixing(false);
+	murahJoystick.useLookupTable(false);
+}
+
+void runReplayBench() {
+	benchRecorder.clear();
+	recordCenterJitter();
+	replayTraceAllModes("center jitter");
+	benchRecorder.clear();
+	recordFullSweeps();
+	replayTraceAllModes("full sweeps");
+	benchRecorder.clear();
+	recordRapidReversals();
+	replayTraceAllModes("rapid reversals");
+	murahDrive.stop();
+}
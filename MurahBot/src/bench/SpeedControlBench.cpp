@@ -0,0 +1,74 @@
+// SpeedControlBench.cpp
+// host simulation of the closed loop wheel speed control, run by the [env:native] benchmarks
+// four mismatched motors (MotorModel) are driven forward open loop and closed loop on the
+// virtual clock, the spread of the wheel speeds shows what the encoders and the PID buy
+
+#ifndef ARDUINO
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <SpeedControl.h>
+#include <stdio.h>
+
+extern Drive4Wheel murahDrive;
+
+const int simMaxTicksPerSecond = 1200;
+const uint16_t simPeriodMs = 20;
+const unsigned long simStepMicros = 1000;
+const int simPwmPin[Drive4Wheel::WHEEL_COUNT] = { 5, 7, 4, 6 }; //WheelIndex order, same wiring as DriveBench.cpp
+
+//runs the drive for durationMs and prints the settled speed of every wheel
+void simulateSpeedControl(const char* name, bool closedLoop, int duty, unsigned long durationMs) {
+	WheelEncoder encoders[Drive4Wheel::WHEEL_COUNT] = { WheelEncoder(2), WheelEncoder(3), WheelEncoder(20), WheelEncoder(21) };
+	MotorModel motors[Drive4Wheel::WHEEL_COUNT] = {
+		MotorModel(simMaxTicksPerSecond, 100, 80, 100), MotorModel(simMaxTicksPerSecond, 100, 80, 88),
+		MotorModel(simMaxTicksPerSecond, 100, 80, 95), MotorModel(simMaxTicksPerSecond, 100, 80, 80) };
+
+	PinHALMock::useVirtualClock(true);
+	murahDrive.stop();
+	DriveSpeedControl speedControl(murahDrive, simMaxTicksPerSecond, simPeriodMs);
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		encoders[i].begin();
+		speedControl.attachEncoder((Drive4Wheel::WheelIndex)i, encoders[i]);
+	}
+	speedControl.setGains(64, 32, 0);
+	speedControl.enable(closedLoop);
+	murahDrive.goForward(duty);
+
+	unsigned long nextUpdate = simPeriodMs * 1000UL;
+	for (unsigned long t = 0; t < durationMs * 1000UL; t += simStepMicros) {
+		for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+			//the motor sees the duty on its PWM pin, the correction included
+			int pwm = PinHALMock::getPwmDuty(simPwmPin[i]);
+			if (murahDrive.getCurrentDuty((Drive4Wheel::WheelIndex)i) < 0) pwm = -pwm;
+			motors[i].update(pwm, simStepMicros, encoders[i]);
+		}
+		PinHALMock::advanceMicros(simStepMicros);
+		if (t + simStepMicros >= nextUpdate) {
+			speedControl.update();
+			nextUpdate += simPeriodMs * 1000UL;
+		}
+	}
+
+	float slowest = motors[0].getSpeed();
+	float fastest = slowest;
+	printf("%-28s target %5d ticks/s, wheels", name, (int)((long)duty * simMaxTicksPerSecond / 255));
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		float speed = motors[i].getSpeed();
+		slowest = min(slowest, speed);
+		fastest = max(fastest, speed);
+		printf(" %6.0f", speed);
+	}
+	printf(", spread %5.0f ticks/s\n", fastest - slowest);
+
+	speedControl.enable(false);
+	murahDrive.stop();
+	PinHALMock::useVirtualClock(false);
+}
+
+void runSpeedControlBench() {
+	simulateSpeedControl("speed control open loop", false, 200, 3000);
+	simulateSpeedControl("speed control closed loop", true, 200, 3000);
+}
+
+#endif
@@ -1,43 +1,239 @@
 
 #include <Arduino.h>
 #include <Wheels.h>
+#include <JoystickDrive.h>
+#include <SharedJoystick.h>
+#include <TimingStats.h>
+#include <LinkHealth.h>
+#include <DrivePacer.h>
+#include <JoystickRecorder.h>
+#include <TaskProfiler.h>
+#include <DriveTelemetry.h>
+#include <MotionQueue.h>
+#ifdef MURAHBOT_SPEED_CONTROL
+#include <SpeedControl.h>
+#endif
+#include <InterruptButton.h>
+#include <ControlLoop.h>
+#ifdef MURAHBOT_POWER_MONITOR
+#include <AdcSampler.h>
+#endif
+#ifdef MURAHBOT_SERIAL_PROTOCOL
+#include <CommandLink.h>
+#else
+#include <AppTelemetry.h>
+#endif
+#define _TASK_SLEEP_ON_IDLE_RUN //a scheduler pass without a due task puts the MCU into idle sleep until the next interrupt
 #include <TaskScheduler.h>
 #include <TaskSchedulerDeclarations.h>
-#include <Bounce2.h>
 #include <DigitalIO.h>
 
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 #define BLYNK_USE_DIRECT_CONNECT
 #define MurahBotBT Serial1
 
 #include <BlynkSimpleSerialBLE.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////
 //Bluetooth and Blynk related declarations (if any)
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 char auth[] = "66390b83798e4495aa9d6c23724f2181"; //Blynk Authorization code
+//Blynk.run() only has to drain Serial1 before its 64 byte receive buffer fills, 5.5 ms at 115200 baud,
+//so the MCU sleeps between the polls instead of running Blynk on every scheduler pass
+const unsigned long blynkInterval = 5; //ms
+
+//drive telemetry for the app, one multi-value write to V10 (see AppTelemetry): on a drive change at most
+//every 250 ms, else every 2 s, within 300 bytes/s of the BLE link that carries the joystick samples.
+//the wheels' changes trigger a push, the statistics ride along. a push is about 45 bytes and has to
+//fit the free bytes of the 64 byte Serial1 transmit buffer, so it never blocks the scheduler
+enum AppTelemetryField : uint8_t {
+	APP_DRIVE_STATE,
+	APP_DUTY, //4 signed duties in WheelIndex order
+	APP_JOYSTICK_INTERVAL = APP_DUTY + 4, //ms, smoothed
+	APP_JOYSTICK_JITTER, //us, max since the start
+	APP_JOYSTICK_STALE, //stale link events since the start
+	APP_DRIVE_LATENCY, //us, joystick sample to the committed duties, mean since the start
+	APP_IDLE_SHARE, //percent of the time the MCU slept since the last push
+	APP_CONTROL_JITTER, //us, max of the control loop (0 without MURAHBOT_CONTROL_LOOP)
+	APP_FIELD_COUNT
+};
+AppTelemetry appTelemetry(10, APP_FIELD_COUNT, 250, 2000, 300);
+#else
+//framed binary commands on the BLE port instead of Blynk (build flag -D MURAHBOT_SERIAL_PROTOCOL)
+//lib/CommandLink owns USART1, its RX ISR fills a lock-free ring that taskCommandLink parses every 1 ms
+CommandLink murahLink;
+const unsigned long commandLinkBaud = 115200;
+#endif
 
 
 
 ///////////////////////////////////////////////////////////////////////////
 // Wheel class and Drive4Wheel class instantiation 
-Wheel WheelFrontLeft(46, 47, 5);  //creating a pointer variable class to be passed to
-Wheel WheelFrontRight(48, 49, 4);
-Wheel WheelRearLeft(50, 51, 7);
-Wheel WheelRearRight(52, 53, 6);
+//wheel pins (forward, backward, PWM speed), the drive constructs its wheels from them in place:
+//reach them with murahDrive.getWheel()
+const WheelPins wheelFrontLeftPins = { 46, 47, 5 };
+const WheelPins wheelFrontRightPins = { 48, 49, 4 };
+const WheelPins wheelRearLeftPins = { 50, 51, 7 };
+const WheelPins wheelRearRightPins = { 52, 53, 6 };
 
 int speedTolerance = 30; //range of tolerance for drive speeds
-Drive4Wheel murahDrive(WheelFrontLeft, WheelFrontRight,
-	WheelRearLeft, WheelRearRight, speedTolerance);
+//ramp limits in duty per taskDriveRamp tick (10 ms): about 100 ms from min to max drive speed,
+//a faster ramp down, and 20 ms standstill before a wheel reverses
+const uint8_t rampAccelStep = 10;
+const uint8_t rampDecelStep = 20;
+const uint8_t rampReversalSteps = 2;
+const unsigned long motorPwmFrequency = 20000; //above the audible range
+#ifdef MURAHBOT_CONTROL_LOOP
+//fixed rate drive control (build flag -D MURAHBOT_CONTROL_LOOP): the ramp runs from the Timer5 interrupt
+//at controlLoopRate instead of taskDriveRamp, whatever the other tasks do. the ramp steps are scaled
+//to keep the ramp times. the drive is changed from the tasks inside a ControlLoop::Lock
+const uint16_t controlLoopRate = 250; //Hz
+const ControlLoop::CatchUpPolicy controlLoopPolicy = ControlLoop::SKIP;
+#endif
+Drive4Wheel murahDrive(wheelFrontLeftPins, wheelFrontRightPins,
+	wheelRearLeftPins, wheelRearRightPins, speedTolerance);
+JoystickDrive murahJoystick(murahDrive); //joystick to drive commands, sway ratio range 0.45 - 0.60
+
+#ifdef MURAHBOT_SPEED_CONTROL
+//optional wheel encoders (build flag -D MURAHBOT_SPEED_CONTROL), one external interrupt pin per wheel
+//pins 18 and 19 also have interrupts but carry Serial1 (BLE), a quadrature B pin can be given as 2nd argument
+WheelEncoder EncoderFrontLeft(2);
+WheelEncoder EncoderFrontRight(3);
+WheelEncoder EncoderRearLeft(20);
+WheelEncoder EncoderRearRight(21);
+const int encoderMaxTicksPerSecond = 1200; //measured with the wheels lifted at duty 255
+const uint16_t speedControlPeriod = 20; //ms
+DriveSpeedControl murahSpeedControl(murahDrive, encoderMaxTicksPerSecond, speedControlPeriod);
+#endif
+
+#ifdef MURAHBOT_POWER_MONITOR
+//battery and motor current monitor (build flag -D MURAHBOT_POWER_MONITOR), sampled in the background
+//battery through a 20k/10k divider on A0, motor supply current through an ACS712-05B on A1
+//the duties are scaled by nominal / measured battery voltage, an overcurrent cuts the drive out
+//until the next shutdown
+const uint8_t adcPins[] = { A0, A1 };
+const uint8_t adcBattery = 0; //index in adcPins
+const uint8_t adcCurrent = 1;
+const unsigned long batteryMicroVoltsPerCount = 14648; //3 x 5 V / 1024
+const unsigned long batteryNominalMilliVolts = 7400; //2S pack
+const unsigned long batteryMinMilliVolts = 5000; //below: no pack or a broken divider, no compensation
+const uint16_t currentZeroCount = 512; //2.5 V at 0 A
+const unsigned long currentMicroAmpsPerCount = 26393; //5 V / 1024 / 185 mV/A
+const unsigned long overcurrentMilliAmps = 4000;
+const uint16_t supplyScaleHysteresis = 3; //Q8.8 steps, about 1 %
+const unsigned long powerMonitorInterval = 10; //ms
+#endif
+
+//joystick state, written by onJoystickSample() and read by taskDrive as one snapshot per run
+//(see SharedJoystick): X and Y stay a pair even once a sample is written from an ISR
+//initialized to the center position 127
+SharedJoystick joystickInput(127, 127);
+
+//event driven drive updates: a joystick sample runs taskDrive right away, at most once per
+//driveMinInterval. samples arriving while a run is pending are coalesced, the run uses the newest one
+//(drivePacer below, the simulator paces its drive with the same code). false falls back to polling
+//the joystick every 50 ms
+const bool driveEventDriven = true;
+const unsigned long driveMinInterval = 20; //ms, rate limit of the drive updates
+unsigned long joystickSamples = 0;
+TimingStats driveLatency; //joystick sample arrival to the ramp step that commits its duties, in us
+
+//the drive command of a sample only sets the wheel targets, the next ramp step (taskDriveRamp or the
+//control step in the Timer5 interrupt) writes the duties. the command arms the measurement, that step
+//takes it in onRampCommit() and leaves it to collectDriveLatency(), which adds it to driveLatency
+volatile bool driveLatencyArmed = false;
+volatile unsigned long driveLatencyStart = 0; //micros() of the sample
+volatile bool driveLatencyReady = false;
+volatile unsigned long committedLatency = 0; //us
+
+//joystick link health: arrival times, rate and jitter of the samples. a stalled link leaves the last
+//sample in joystickInput, so after joystickStaleTimeout without a sample the command decays to a stop
+//over joystickDecayTime, one taskDrive run per joystickDecayStep. the app has to resend a held stick
+//within the timeout (Blynk joystick write interval, or the framed protocol's joystick frames)
+const unsigned long joystickStaleTimeout = 500; //ms
+const unsigned long joystickDecayTime = 500; //ms
+const unsigned long joystickDecayStep = 20; //ms
+const unsigned long drivePollMaxInterval = 100; //ms, slowest polled taskDrive when the samples are sparse
+LinkHealth joystickLink(joystickStaleTimeout, joystickDecayTime);
+DrivePacer drivePacer(joystickLink, driveMinInterval, joystickDecayStep);
+
+//joystick recorder: the last 256 samples with their timing, replayed through onJoystickSample() to
+//reproduce a field issue. controlled on Blynk V4 or COMMAND_RECORD, see onRecorderCommand()
+//the EEPROM copy sits above the first 1 KB, which is left for the drive's own settings
+JoystickRecorder joystickRecorder;
+JoystickReplay joystickReplay(joystickRecorder);
+const int recorderEepromAddress = 1024;
+
+//slow work a recorder command asks for, done by reportRecorder() once the caller has released its
+//ControlLoop::Lock: the EEPROM save (about 3.5 s) and the dump at 9600 baud take seconds
+enum RecorderReport : uint8_t {
+	RECORDER_NO_REPORT, RECORDER_SAVE, RECORDER_NOT_FOUND, RECORDER_DUMP
+};
+
+//per wheel duty calibration (WheelIndex order): deadband and response curve of each motor, so the
+//four wheels turn alike at the same duty. loaded from the EEPROM in setup(), tuned at runtime on
+//Blynk V5 or COMMAND_CALIBRATE (see onCalibrationCommand()) and saved back without reflashing
+//a wheel drives uncalibrated until its curves are loaded or changed
+WheelCalibration wheelCalibration[Drive4Wheel::WHEEL_COUNT];
+const int calibrationEepromAddress = 0;
+
+//slow work a calibration command asks for, done by reportCalibration() once the caller has released
+//its ControlLoop::Lock: the EEPROM save (up to 3.3 ms per changed byte) and the prints waiting on the
+//UART must not hold the control loop off
+enum CalibrationReport : uint8_t {
+	CALIBRATION_NO_REPORT, CALIBRATION_SAVE, CALIBRATION_NOT_FOUND, CALIBRATION_CURVES
+};
+
+//binary drive telemetry on Serial, decoded by tools/decode_telemetry.py
+//a frame on every drive change (at most every 100 ms) and a 1 s heartbeat, never blocking the scheduler
+DriveTelemetry murahTelemetry(murahDrive, 100, 1000);
+
+//the text reports share Serial with the telemetry frames: for its scope a TextReport holds the frames
+//back (after the one being sent), so tools/decode_telemetry.py never finds text inside a frame
+class TextReport {
+public:
+	TextReport() { murahTelemetry.suspend(Serial); }
+	~TextReport() { murahTelemetry.resume(); }
+};
+
+//scripted maneuvers, run by taskMotion. the joystick is ignored while a route runs
+//steps are streamed in on V2 ahead of time and started/aborted on V3 (see BLYNK_WRITE(V2), BLYNK_WRITE(V3))
+MotionQueue murahMotion(murahDrive);
+//test route: square-ish loop with a sway, about 6 s
+const MotionPrimitive testRoute[] PROGMEM = {
+	motionDrive(Drive4Wheel::DRIVE_FORWARD, 200, 1000),
+	motionStop(300),
+	motionDrive(Drive4Wheel::DRIVE_LEFT, 180, 600),
+	motionStop(300),
+	motionDrive(Drive4Wheel::DRIVE_FORWARD_LEFT, 200, 1500, toSpeedRatioQ8(0.5)),
+	motionMix(-150, 0, 1000),
+	motionDrive(Drive4Wheel::DRIVE_RIGHT, 180, 600),
+	motionStop(500)
+};
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-// Button Pin initialization and Bounce class instantiation 
-const byte buttonPinRobotStartStop = 22; //Start and Stop Robot 
+// Button Pin initialization and InterruptButton class instantiation 
+const byte buttonPinRobotStartStop = A8; //Start and Stop Robot, moved from pin 22 to a pin change interrupt pin
 										 //const byte buttonPinBackward = 23;
 										 //const byte buttonPinLeft = 24;
 										 //const byte buttonPinRight = 25;  //phased out to be repurposed in the future 
 
-Bounce ButtonRobotStartStop(buttonPinRobotStartStop, 10);
+//on A8 (PCINT16) the ISR timestamps the edges and wakes the MCU, loop() then runs taskUpdateButton
+//until the new level is debounced and nothing is polled in between. a pin without a pin change
+//interrupt (22, PA0, where the button used to be) falls back to sampling it with taskUpdateButton
+InterruptButton ButtonRobotStartStop(buttonPinRobotStartStop, 10);
+const unsigned long buttonUpdateInterval = 10; //ms, one debounce time
+
+//scheduler passes of loop() and the idle ones among them (no task due, MCU slept until the next
+//interrupt), and the time spent in them: how often and how long the robot actually sleeps
+unsigned long loopIterations = 0;
+unsigned long idleIterations = 0;
+unsigned long idleMillis = 0;
+unsigned long idleMicros = 0; //below a ms, carried into idleMillis
+unsigned long sleepReportMillis = 0; //start of the counters
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,10 +241,10 @@ Bounce ButtonRobotStartStop(buttonPinRobotStartStop, 10);
 
 
 enum SystemStates {
-	ACTIVE, PASSIVE, NO_STATE
+	ACTIVE, PASSIVE
 };
-//state variables
-SystemStates prevSystemState = NO_STATE;
+//state variables, the robot powers up PASSIVE: the first press of start/stop brings the drive up
+SystemStates prevSystemState = PASSIVE;
 SystemStates currSystemState = PASSIVE; // 
 SystemStates currBlynkState = PASSIVE;
 //int ledPin = 13; //on-board LED 
@@ -57,39 +253,162 @@ DigitalPin<13> ledPin;
 ///////////////////////////////////////////////////////////////////////////////
 //function prototypes 
 
-void callbackButtonState();
-void callbackButtonAction(); //callbacks for button actions
+void callbackButtonState(); //callback for button actions
 
 bool onEnableOfEnableDisableDrive();
 void callbackEnableDisableDrive(); //callback to ON and OFF drive system
 
 bool onEnableBlynk();
 void callbackBlynk(); //callback for Blynk connection 
+void callbackAppTelemetry(); //callback to push the drive telemetry to the app
+#ifdef MURAHBOT_SERIAL_PROTOCOL
+void callbackCommandLink(); //callback to parse and run the framed commands
+#endif
+
+void callbackJoystickDrive(); //callback to Drive system 
+
+void callbackMotion(); //callback to execute the motion queue
+void callbackReplay(); //callback to feed the recorded joystick samples
+void callbackTelemetry(); //callback to queue and send the drive telemetry
+void callbackDriveRamp(); //callback to ramp the wheel duties towards the drive commands
+void onRampCommit(); //takes the drive latency in the ramp step after a drive command
+void collectDriveLatency(); //adds that latency to driveLatency
+#ifdef MURAHBOT_POWER_MONITOR
+void callbackPowerMonitor(); //callback of the supply compensation and the overcurrent cut out
+#endif
+#ifdef MURAHBOT_CONTROL_LOOP
+void controlStep(); //fixed rate control step, runs in the Timer5 interrupt
+#endif
+#ifdef MURAHBOT_SPEED_CONTROL
+void callbackSpeedControl(); //callback of the closed loop wheel speed control
+#endif
 
-void callbackPrimaryJoystickDrive();
-void callbackSecondaryJoystickDrive();
-void callbackDisplayDriveState(); //callback to Drive system 
+#ifdef MURAHBOT_PROFILE
+void callbackProfileReport(); //callback to print the task profiles on request
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 // Scheduler and Tasks instantiation
 Scheduler MurahBotSchedule;
-Task taskUpdateButton(TASK_IMMEDIATE, TASK_FOREVER, &callbackButtonState, &MurahBotSchedule);
+Task taskUpdateButton(buttonUpdateInterval, TASK_FOREVER, &callbackButtonState, &MurahBotSchedule);
 Task taskEnableDisableDrive(TASK_IMMEDIATE, TASK_ONCE, &callbackEnableDisableDrive, &MurahBotSchedule, false);
-Task taskDrive(50, TASK_FOREVER, &callbackPrimaryJoystickDrive, &MurahBotSchedule, false);
-Task taskRunBlynk(TASK_IMMEDIATE, TASK_FOREVER, &callbackBlynk, &MurahBotSchedule, false, &onEnableBlynk);
+Task taskDrive(50, TASK_FOREVER, &callbackJoystickDrive, &MurahBotSchedule, false);
+#ifndef MURAHBOT_SERIAL_PROTOCOL
+Task taskRunBlynk(blynkInterval, TASK_FOREVER, &callbackBlynk, &MurahBotSchedule, false, &onEnableBlynk);
+Task taskAppTelemetry(50, TASK_FOREVER, &callbackAppTelemetry, &MurahBotSchedule, false);
+#else
+Task taskCommandLink(1, TASK_FOREVER, &callbackCommandLink, &MurahBotSchedule, false);
+#endif
+Task taskDriveRamp(10, TASK_FOREVER, &callbackDriveRamp, &MurahBotSchedule, false);
+Task taskTelemetry(20, TASK_FOREVER, &callbackTelemetry, &MurahBotSchedule, true);
+Task taskMotion(TASK_IMMEDIATE, TASK_FOREVER, &callbackMotion, &MurahBotSchedule, false);
+Task taskReplay(TASK_IMMEDIATE, TASK_FOREVER, &callbackReplay, &MurahBotSchedule, false);
+#ifdef MURAHBOT_POWER_MONITOR
+Task taskPowerMonitor(powerMonitorInterval, TASK_FOREVER, &callbackPowerMonitor, &MurahBotSchedule, false);
+#endif
+#ifdef MURAHBOT_SPEED_CONTROL
+Task taskSpeedControl(speedControlPeriod, TASK_FOREVER, &callbackSpeedControl, &MurahBotSchedule, false);
+#endif
+
+#ifdef MURAHBOT_PROFILE
+//task profiles (build flag -D MURAHBOT_PROFILE), send 'p' on Serial for a report, 'r' to reset them
+Task taskProfileReport(250, TASK_FOREVER, &callbackProfileReport, &MurahBotSchedule, true);
+TaskProfile profileButton("button");
+TaskProfile profileEnableDisableDrive("enableDrive");
+TaskProfile profileDrive("drive");
+#ifndef MURAHBOT_SERIAL_PROTOCOL
+TaskProfile profileLink("blynk");
+#else
+TaskProfile profileLink("commandLink");
+#endif
+TaskProfile profileDriveRamp("driveRamp");
+TaskProfile profileTelemetry("telemetry");
+TaskProfile profileMotion("motion");
+#ifdef MURAHBOT_SPEED_CONTROL
+TaskProfile profileSpeedControl("speedControl");
+#endif
+#endif
 
 
 
 void setup() {
 
-    pinMode(buttonPinRobotStartStop, INPUT_PULLUP); //initialize the button
 	Serial.begin(9600);
 	delay(500);
+	if (!ButtonRobotStartStop.begin()) { //initialize the button
+		Serial.println(F("Start/Stop button polled, no pin change interrupt on its pin"));
+	}
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 	MurahBotBT.begin(115200); //starts the BLE module 
+#else
+	murahLink.begin(commandLinkBaud); //the BLE module's UART, pings are answered from here on
+	taskCommandLink.enable();
+#endif
 	delay(100);
 
-	//enabling the Tasks
-	taskUpdateButton.enable();
+	//enabling the Tasks, an interrupt driven button enables taskUpdateButton from loop() on an edge
+	if (!ButtonRobotStartStop.isInterruptDriven()) taskUpdateButton.enable();
+	sleepReportMillis = millis();
+
+	//the drive commands only set wheel targets, taskDriveRamp slews the wheels towards them
+#ifndef MURAHBOT_CONTROL_LOOP
+	murahDrive.setRamp(rampAccelStep, rampDecelStep, rampReversalSteps);
+	murahDrive.enableRamp(true);
+	taskDriveRamp.enable();
+#else
+	//or the control loop does, with the 10 ms ramp steps scaled to its period
+	const unsigned long controlLoopPeriod = 1000000UL / controlLoopRate; //us
+	murahDrive.setRamp(max(1UL, rampAccelStep * controlLoopPeriod / 10000), max(1UL, rampDecelStep * controlLoopPeriod / 10000),
+		max(1UL, rampReversalSteps * 10000 / controlLoopPeriod));
+	murahDrive.enableRamp(true);
+	ControlLoop::begin(controlLoopRate, &controlStep, controlLoopPolicy);
+#endif
+
+	//motor PWM frequency, set after the core's timer setup. pin 4 (RIGHT_FRONT) is on Timer0,
+	//which also runs millis(), so it stays at the core's 980 Hz
+	murahDrive.getWheel(Drive4Wheel::LEFT_FRONT).setPwmFrequency(motorPwmFrequency);
+	murahDrive.getWheel(Drive4Wheel::LEFT_REAR).setPwmFrequency(motorPwmFrequency); //Timer4, shared with RIGHT_REAR
+	murahDrive.getWheel(Drive4Wheel::RIGHT_REAR).setPwmFrequency(motorPwmFrequency);
+
+	//motor calibration, read once: the wheels only look up their curves in RAM
+	if (WheelCalibration::load(calibrationEepromAddress, wheelCalibration, Drive4Wheel::WHEEL_COUNT)) {
+		for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) murahDrive.getWheel(i).setCalibration(&wheelCalibration[i]);
+	}
+	else Serial.println(F("No wheel calibration in the EEPROM, wheels uncalibrated"));
+
+#ifdef MURAHBOT_SPEED_CONTROL
+	//the encoders hold every wheel at the speed its duty asks for, whatever its motor and load
+	murahSpeedControl.attachEncoder(Drive4Wheel::LEFT_FRONT, EncoderFrontLeft);
+	murahSpeedControl.attachEncoder(Drive4Wheel::RIGHT_FRONT, EncoderFrontRight);
+	murahSpeedControl.attachEncoder(Drive4Wheel::LEFT_REAR, EncoderRearLeft);
+	murahSpeedControl.attachEncoder(Drive4Wheel::RIGHT_REAR, EncoderRearRight);
+	EncoderFrontLeft.begin();
+	EncoderFrontRight.begin();
+	EncoderRearLeft.begin();
+	EncoderRearRight.begin();
+	murahSpeedControl.setGains(64, 32, 0); //kp 0.25, ki 0.125 duty per tick/sec
+	murahSpeedControl.enable(true);
+	taskSpeedControl.enable();
+#endif
+
+#ifdef MURAHBOT_POWER_MONITOR
+	//the ADC free runs from here on, the ISR latches an overcurrent within a few ms
+	AdcSampler::begin(adcPins, sizeof(adcPins));
+	AdcSampler::setLimit(adcCurrent, currentZeroCount + overcurrentMilliAmps * 1000 / currentMicroAmpsPerCount);
+	taskPowerMonitor.enable();
+#endif
+
+	//event driven: taskDrive runs once per joystick sample (see onJoystickSample()) instead of polling
+	if (driveEventDriven) {
+		taskDrive.setInterval(TASK_IMMEDIATE);
+		taskDrive.setIterations(TASK_ONCE);
+	}
+
+	//joystick samples are mixed into continuous left/right duties, one integer pass per sample. mixing
+	//takes precedence; once CONFIG_MIXING turns it off the samples are decoded with one PROGMEM table
+	//fetch, which picks the same drive states as the threshold branches
+	murahJoystick.useLookupTable(true);
+	murahJoystick.useMixing(true);
 
 	//on board LED 
 	ledPin.mode(OUTPUT);
@@ -97,19 +416,49 @@ void setup() {
 }
 
 void loop() {
-    MurahBotSchedule.execute();
+	unsigned long passStart = micros();
+	if (MurahBotSchedule.execute()) { //true if no callback ran: the MCU slept
+		idleIterations++;
+		idleMicros += micros() - passStart;
+		while (idleMicros >= 1000) {
+			idleMicros -= 1000;
+			idleMillis++;
+		}
+	}
+	loopIterations++;
+	if (ButtonRobotStartStop.isPending()) taskUpdateButton.enableIfNot(); //a button edge woke the MCU
+}
+
+//how often and how long the MCU slept since the last report, then restarts the counters
+void reportSleep() {
+	unsigned long elapsed = millis() - sleepReportMillis;
+	Serial.print(F("Slept: "));
+	Serial.print(idleIterations);
+	Serial.print(F(" of "));
+	Serial.print(loopIterations);
+	Serial.print(F(" scheduler passes, "));
+	Serial.print((elapsed >= 1000) ? idleIterations / (elapsed / 1000) : idleIterations);
+	Serial.print(F(" per s, "));
+	Serial.print((elapsed >= 100) ? idleMillis / (elapsed / 100) : 0);
+	Serial.println(F("% of the time"));
+	idleIterations = 0;
+	loopIterations = 0;
+	idleMillis = 0;
+	idleMicros = 0;
+	sleepReportMillis = millis();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // updates various button states  
+//the button starts at its current level (no power-on event), so every release toggles the drive
 void callbackButtonState() {
-	if (ButtonRobotStartStop.update()) {
+	PROFILE_TASK(profileButton, taskUpdateButton.getInterval());
+	bool changed = ButtonRobotStartStop.update();
+	//interrupt driven: runs only from an edge until its level is taken, loop() enables it again
+	if (ButtonRobotStartStop.isInterruptDriven() && !ButtonRobotStartStop.isPending()) taskUpdateButton.disable();
+	if (changed) {
 		if (ButtonRobotStartStop.read() == HIGH) {
-			if (prevSystemState == NO_STATE) {
-				prevSystemState = currSystemState;
-				return;
-			}
-			else if (prevSystemState == currSystemState) {
+			if (prevSystemState == currSystemState) {
 				taskEnableDisableDrive.enable();
 				return;
 			}
@@ -121,13 +470,6 @@ void callbackButtonState() {
 		else;
 	}
 	else;
-	taskUpdateButton.setCallback(&callbackButtonAction);
-	//Force next iteration callbackButtonAction if needed 
-}
-
-//updates the Button Actions after the Button status are updated //if neccessary
-void callbackButtonAction() {
-	taskUpdateButton.setCallback(&callbackButtonState);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -140,144 +482,591 @@ bool onEnableOfEnableDisableDrive() {
 
 // turns the driveSystem ON and OFF
 void callbackEnableDisableDrive() {
+	PROFILE_TASK(profileEnableDisableDrive, taskEnableDisableDrive.getInterval());
+	TextReport report; //the state change reports
 	if (currSystemState == PASSIVE) {
 		prevSystemState = currSystemState;
 		currSystemState = ACTIVE; //changes the system state 
+		//sleep of the PASSIVE time before, the current draw itself needs a meter on the supply
+		reportSleep();
 		Serial.println(F("Bringing drive systems online...."));
-		taskDrive.enable();
+		if (!driveEventDriven) taskDrive.enable(); //event driven, the first joystick sample starts it
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 		if (currBlynkState == PASSIVE)taskRunBlynk.enable(); //enable only once 
+#endif
 	}
 	else {
 		prevSystemState = currSystemState;
 		currSystemState = PASSIVE;
 		Serial.println(F("Shutting down drive systems..."));
-		murahDrive.stop(); //force stop the robot
+		{
+			ControlLoop::Lock lock;
+			murahMotion.abort();
+			murahDrive.stop(); //force stop the robot, ramped down by taskDriveRamp
+		}
+#ifdef MURAHBOT_POWER_MONITOR
+		{
+			ControlLoop::Lock lock;
+			AdcSampler::clearTripped(); //the operator restarts the robot after an overcurrent
+			murahDrive.setCutOut(false);
+		}
+#endif
+		taskMotion.disable();
+		joystickReplay.stop();
+		taskReplay.disable();
 		taskDrive.disable();
+		drivePacer.reset();
+		//drive commands versus the ones that actually changed the wheels since the last start
+		Serial.print(F("Drive commands: "));
+		Serial.print(murahDrive.getCommandCount());
+		Serial.print(F(", hardware writes: "));
+		Serial.println(murahDrive.getHardwareWriteCount());
+		murahDrive.resetCommandCounters();
+		//joystick sample to committed duties latency since the last start
+		collectDriveLatency();
+		Serial.print(F("Joystick samples: "));
+		Serial.print(joystickSamples);
+		Serial.print(F(", coalesced: "));
+		Serial.print(drivePacer.getCoalesced());
+		Serial.print(F(", skipped by the drive: "));
+		Serial.print(joystickInput.getSkipped());
+		Serial.print(F(", latency us min/mean/max: "));
+		Serial.print(driveLatency.getMin());
+		Serial.print('/');
+		Serial.print(driveLatency.getMean());
+		Serial.print('/');
+		Serial.println(driveLatency.getMax());
+		Serial.print(F("Joystick interval us mean/max: "));
+		Serial.print(joystickLink.getIntervals().getMean());
+		Serial.print('/');
+		Serial.print(joystickLink.getIntervals().getMax());
+		Serial.print(F(", jitter us mean/max: "));
+		Serial.print(joystickLink.getJitter().getMean());
+		Serial.print('/');
+		Serial.print(joystickLink.getJitter().getMax());
+		Serial.print(F(", stale events: "));
+		Serial.println(joystickLink.getStaleEvents());
+		Serial.print(F("Telemetry frames: "));
+		Serial.print(murahTelemetry.getSentFrames());
+		Serial.print(F(", dropped: "));
+		Serial.println(murahTelemetry.getDroppedFrames());
+		murahTelemetry.resetCounters();
+		reportSleep(); //of the ACTIVE time
+#ifndef MURAHBOT_SERIAL_PROTOCOL
+		Serial.print(F("App telemetry pushes: "));
+		Serial.print(appTelemetry.getPushes());
+		Serial.print(F(", deferred: "));
+		Serial.print(appTelemetry.getDeferred());
+		Serial.print(F(", bytes: "));
+		Serial.println(appTelemetry.getBytes());
+		appTelemetry.resetCounters();
+#endif
+#ifdef MURAHBOT_SERIAL_PROTOCOL
+		Serial.print(F("Link frames: "));
+		Serial.print(murahLink.getParser().getFrameCount());
+		Serial.print(F(", CRC errors: "));
+		Serial.print(murahLink.getParser().getCrcErrors());
+		Serial.print(F(", overruns: "));
+		Serial.println(murahLink.getRxOverruns());
+		murahLink.resetCounters();
+#endif
+		joystickSamples = 0;
+		drivePacer.resetCounters();
+		joystickInput.resetCounters();
+		driveLatency.reset();
+		joystickLink.reset();
+#ifdef MURAHBOT_CONTROL_LOOP
+		ControlLoop::Stats controlStats;
+		ControlLoop::getStats(controlStats);
+		Serial.print(F("Control steps: "));
+		Serial.print(controlStats.steps);
+		Serial.print(F(", overruns: "));
+		Serial.print(controlStats.overruns);
+		Serial.print(F(", skipped: "));
+		Serial.print(controlStats.skipped);
+		Serial.print(F(", missed: "));
+		Serial.print(controlStats.missed);
+		Serial.print(F(", jitter us mean/max: "));
+		Serial.print(controlStats.latencyMean);
+		Serial.print('/');
+		Serial.print(controlStats.latencyMax);
+		Serial.print(F(", runtime us max: "));
+		Serial.println(controlStats.runtimeMax);
+		ControlLoop::resetStats();
+#endif
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 //ensures the Blynk app is connected 
 bool onEnableBlynk() {
 	Blynk.begin(auth, MurahBotBT);
 	currBlynkState = ACTIVE;
+	//only the drive state and the duties make a push due, the statistics ride along
+	appTelemetry.setWatched((1 << APP_DRIVE_STATE) | (0x0F << APP_DUTY));
+	taskAppTelemetry.enable();
 	return true;
 }
 
 void callbackBlynk() {
+	PROFILE_TASK(profileLink, taskRunBlynk.getInterval());
 	Blynk.run();
 	taskRunBlynk.setCallback(callbackBlynk);
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//drive control variables and functions 
-//to be ported to a separate .ino file in the future
+//refreshes the telemetry fields and pushes them when AppTelemetry says a push is due
+void callbackAppTelemetry() {
+	static unsigned long lastPushMillis = 0;
+	static unsigned long lastIdleMillis = 0;
+	if (!Blynk.connected()) return;
+	{
+		ControlLoop::Lock lock; //a consistent set of duties
+		appTelemetry.set(APP_DRIVE_STATE, murahDrive.getCurrentDriveState());
+		for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+			appTelemetry.set(APP_DUTY + i, murahDrive.getCurrentDuty((Drive4Wheel::WheelIndex)i));
+		}
+	}
+	appTelemetry.set(APP_JOYSTICK_INTERVAL, joystickLink.getSmoothedInterval() / 1000);
+	appTelemetry.set(APP_JOYSTICK_JITTER, joystickLink.getJitter().getMax());
+	appTelemetry.set(APP_JOYSTICK_STALE, joystickLink.getStaleEvents());
+	collectDriveLatency();
+	appTelemetry.set(APP_DRIVE_LATENCY, driveLatency.getMean());
+	if (idleMillis < lastIdleMillis) lastIdleMillis = 0; //the counters restart with the drive
+	unsigned long elapsed = millis() - lastPushMillis;
+	if (elapsed > 0) appTelemetry.set(APP_IDLE_SHARE, (idleMillis - lastIdleMillis) * 100 / elapsed);
+#ifdef MURAHBOT_CONTROL_LOOP
+	ControlLoop::Stats controlStats;
+	ControlLoop::getStats(controlStats);
+	appTelemetry.set(APP_CONTROL_JITTER, controlStats.latencyMax);
+#endif
 
-//constant values for jostick pad region
-const byte X_THRESHOLD_LOW = 108; //X: 128 - 20
-const byte X_THRESHOLD_HIGH = 148; //X: 128 + 20   
-const byte Y_THRESHOLD_LOW = 108;
-const byte Y_THRESHOLD_HIGH = 148;
+	uint8_t length = appTelemetry.prepare(MurahBotBT.availableForWrite());
+	if (length > 0) {
+		BlynkParam values(appTelemetry.getPayload(), length, AppTelemetry::PAYLOAD_SIZE);
+		Blynk.virtualWrite(appTelemetry.getVirtualPin(), values);
+		lastPushMillis = millis();
+		lastIdleMillis = idleMillis;
+	}
+}
+#endif
 
-// initialized the X and Y values to the center position 127
-int joystickX = 127;
-int joystickY = 127;
+////////////////////////////////////////////////////////////////////////////////
+//drive control variables and functions 
+//the joystick decision logic lives in lib/JoystickDrive so it can also run on the host
 
-//ratio range for speedRatios as a multiple of 100 //should not do floating point calculation
-float smallestRatio = 45;
-float biggestRatio = 60;
+//joystick sample from the app (Blynk V1 or COMMAND_JOYSTICK)
+void onJoystickSample(int x, int y) {
+	joystickInput.write(constrain(x, 0, 255), constrain(y, 0, 255));
+	joystickSamples++;
+	joystickLink.sample();
+	joystickRecorder.record(x, y);
+	if (currSystemState != ACTIVE) return;
+	unsigned long runDelay = drivePacer.onSample();
+	if (runDelay == DrivePacer::NO_RUN || !driveEventDriven) return; //coalesced, or taskDrive polls
+	if (runDelay == 0) taskDrive.restart();
+	else taskDrive.restartDelayed(runDelay);
+}
 
+#ifndef MURAHBOT_SERIAL_PROTOCOL
 //Blynk input of joystick values 
 BLYNK_WRITE(V1) {
-	joystickX = param[0].asInt();
-	joystickY = param[1].asInt();
+	if (joystickReplay.isRunning()) return; //the recording drives
+	onJoystickSample(param[0].asInt(), param[1].asInt());
 }
+#endif
 
-//updates the Primary controls for Joystick in four directions: Front, Back, Left, Right. 
-void callbackPrimaryJoystickDrive() {
-	//boolean conditions for the threshold regions
-	bool joystickXInThreshold = (joystickX > X_THRESHOLD_LOW && joystickX < X_THRESHOLD_HIGH);
-	bool joystickYInThreshold = (joystickY > Y_THRESHOLD_LOW && joystickY < Y_THRESHOLD_HIGH);
+//pulls a joystick axis towards the center (128) by a Q8.8 scale, 256 leaves it as it is
+int scaleJoystickAxis(int value, uint16_t scale) {
+	return 128 + (int)(((long)(value - 128) * scale) >> 8);
+}
 
-	//if joystick not in the threshold region sets callback to secondaryJoystickDrive
-	if (!joystickXInThreshold && !joystickYInThreshold) {
-		taskDrive.setCallback(&callbackSecondaryJoystickDrive);
+//Primary and Secondary controls for the Joystick in one pass: Front, Back, Left, Right and the Sways
+//the drive state is reported by taskTelemetry
+void callbackJoystickDrive() {
+	PROFILE_TASK(profileDrive, taskDrive.getInterval());
+	uint16_t commandScale = joystickLink.getCommandScale(); //below 256 only while the link is stale
+	JoystickSnapshot joystick;
+	joystickInput.consume(joystick); //the same sample as before on a decay run
+	collectDriveLatency();
+	bool driven = !murahMotion.isRunning();
+	if (driven) {
+		ControlLoop::Lock lock;
+		murahJoystick.drive(scaleJoystickAxis(joystick.x, commandScale), scaleJoystickAxis(joystick.y, commandScale));
+		if (drivePacer.isPending()) {
+			driveLatencyStart = drivePacer.getSampleMicros();
+			driveLatencyArmed = true;
+		}
+	}
+	unsigned long nextRun = drivePacer.onDrive(driven ? commandScale : 0);
+
+	if (driveEventDriven) {
+		if (nextRun != DrivePacer::NO_RUN) taskDrive.restartDelayed(nextRun); //decays a stale input
+	}
+	else if (joystickLink.getSmoothedInterval() > 0) {
+		//polled: no faster than the samples arrive
+		taskDrive.setInterval(constrain(joystickLink.getSmoothedInterval() / 1000, driveMinInterval, drivePollMaxInterval));
+	}
+}
+
+//motion control: 0 aborts, 1 starts the queued steps, 2 queues and starts the test route
+void onMotionCommand(int command) {
+	ControlLoop::Lock lock;
+	if (command == 0) {
+		murahMotion.abort();
+		taskMotion.disable();
 		return;
 	}
+	if (currSystemState != ACTIVE) return;
+	if (command == 2) murahMotion.loadRoute(testRoute, sizeof(testRoute) / sizeof(testRoute[0]));
+	murahMotion.start();
+	if (murahMotion.isRunning()) taskMotion.restart();
+}
 
-	//initializes the current allowable driveSpeeds as temp variable 
-	int minSpeed = murahDrive.getDriveSpeed(MIN);
-	int maxSpeed = murahDrive.getDriveSpeed(MAX);
+//joystick recorder control: 0 stops recording and replay, 1 records, 2 replays the recording,
+//3 saves it to the EEPROM, 4 loads it from there, 5 prints it on Serial as time_ms,x,y lines
+//(the trace format of the host simulator, src/sim/). 3 and 5 block for seconds: PASSIVE only
+//returns the slow work left to do, see reportRecorder()
+RecorderReport onRecorderCommand(int command) {
+	if (command == 0) {
+		joystickRecorder.stop();
+		joystickReplay.stop();
+		taskReplay.disable();
+	}
+	else if (command == 1) {
+		joystickReplay.stop();
+		taskReplay.disable();
+		joystickRecorder.start();
+	}
+	else if (command == 2 && currSystemState == ACTIVE) {
+		joystickRecorder.stop();
+		joystickReplay.start();
+		if (joystickReplay.isRunning()) taskReplay.restart();
+	}
+	else if (command == 3 && currSystemState == PASSIVE) {
+		return RECORDER_SAVE;
+	}
+	else if (command == 4 && !joystickReplay.isRunning()) {
+		if (!joystickRecorder.load(recorderEepromAddress)) return RECORDER_NOT_FOUND;
+	}
+	else if (command == 5 && currSystemState == PASSIVE) {
+		return RECORDER_DUMP;
+	}
+	return RECORDER_NO_REPORT;
+}
 
-	// temp variable 
-	int speed;
+//saves or prints for a recorder command, outside of any ControlLoop::Lock
+void reportRecorder(RecorderReport recorderReport) {
+	if (recorderReport == RECORDER_NO_REPORT) return;
+	if (recorderReport == RECORDER_SAVE) {
+		joystickRecorder.save(recorderEepromAddress);
+		return;
+	}
+	TextReport report;
+	if (recorderReport == RECORDER_NOT_FOUND) {
+		Serial.println(F("No joystick recording in the EEPROM"));
+		return;
+	}
+	unsigned long time = 0;
+	for (uint16_t i = 0; i < joystickRecorder.getCount(); i++) {
+		JoystickRecord record = joystickRecorder.get(i);
+		if (i > 0) time += record.deltaMs;
+		Serial.print(time);
+		Serial.print(',');
+		Serial.print(record.x);
+		Serial.print(',');
+		Serial.println(record.y);
+	}
+}
 
-	//various statement to check the appropriate Primary actions
-	if (joystickXInThreshold && joystickYInThreshold) {
-		murahDrive.stop();	//stop the drive if in absolute center	
+//wheel calibration: for wheel 0-3 (WheelIndex order) and curve 0 forward / 1 backward, sets the point
+//(0-16, the corrected duty for duty point * 16, 16 is duty 255) to duty, or with point 255 makes the
+//curve a straight line from the deadband duty to 255. the wheel uses its curves from then on
+//wheel 255 runs the curve value as a command on all wheels: 0 saves them to the EEPROM (PASSIVE only),
+//1 loads them from there, 2 drops them (uncalibrated wheels), 3 prints them on Serial (PASSIVE only)
+//returns the slow work left to do, see reportCalibration()
+CalibrationReport onCalibrationCommand(uint8_t wheel, uint8_t curve, uint8_t point, uint8_t duty) {
+	if (wheel < Drive4Wheel::WHEEL_COUNT && curve <= WheelCalibration::BACKWARD) {
+		ControlLoop::Lock lock; //the control step may be looking the curve up
+		if (point == 255) wheelCalibration[wheel].setDeadband((WheelCalibration::Curve)curve, duty);
+		else wheelCalibration[wheel].setPoint((WheelCalibration::Curve)curve, point, duty);
+		murahDrive.getWheel(wheel).setCalibration(&wheelCalibration[wheel]); //rewrites the duty on the next command
 	}
-	else if (joystickY < Y_THRESHOLD_LOW && joystickXInThreshold) {
-		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed); //map speed between joystick coordinate and allowable drive Speeds
-		murahDrive.goBackward(speed);
+	else if (wheel == 255 && curve == 0 && currSystemState == PASSIVE) {
+		return CALIBRATION_SAVE;
 	}
-	else if (joystickY > Y_THRESHOLD_HIGH && joystickXInThreshold) {
-		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
-		murahDrive.goForward(speed);
+	else if (wheel == 255 && curve == 1) {
+		ControlLoop::Lock lock;
+		if (WheelCalibration::load(calibrationEepromAddress, wheelCalibration, Drive4Wheel::WHEEL_COUNT)) {
+			for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) murahDrive.getWheel(i).setCalibration(&wheelCalibration[i]);
+		}
+		else return CALIBRATION_NOT_FOUND;
 	}
-	else if (joystickX < X_THRESHOLD_LOW && joystickYInThreshold) {
-		speed = map(joystickX, X_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
-		murahDrive.goLeft(speed);
+	else if (wheel == 255 && curve == 2) {
+		ControlLoop::Lock lock;
+		for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+			wheelCalibration[i].setIdentity();
+			murahDrive.getWheel(i).setCalibration(0);
+		}
 	}
-	else if (joystickX > X_THRESHOLD_HIGH && joystickYInThreshold) {
-		speed = map(joystickX, X_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
-		murahDrive.goRight(speed);
+	else if (wheel == 255 && curve == 3 && currSystemState == PASSIVE) {
+		return CALIBRATION_CURVES;
 	}
-	else murahDrive.stop(); //just in case call stop always 
+	return CALIBRATION_NO_REPORT;
+}
 
-	taskDrive.setCallback(&callbackDisplayDriveState);
+//saves or prints for a calibration command, outside of any ControlLoop::Lock
+void reportCalibration(CalibrationReport calibrationReport) {
+	if (calibrationReport == CALIBRATION_NO_REPORT) return;
+	if (calibrationReport == CALIBRATION_SAVE) {
+		WheelCalibration::save(calibrationEepromAddress, wheelCalibration, Drive4Wheel::WHEEL_COUNT);
+		return;
+	}
+	TextReport report;
+	if (calibrationReport == CALIBRATION_NOT_FOUND) {
+		Serial.println(F("No wheel calibration in the EEPROM"));
+		return;
+	}
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		for (uint8_t c = WheelCalibration::FORWARD; c <= WheelCalibration::BACKWARD; c++) {
+			Serial.print(i);
+			Serial.print(c == WheelCalibration::FORWARD ? F(" fwd") : F(" bwd"));
+			for (uint8_t p = 0; p < WheelCalibration::POINTS; p++) {
+				Serial.print(' ');
+				Serial.print(wheelCalibration[i].getPoint((WheelCalibration::Curve)c, p));
+			}
+			Serial.println();
+		}
+	}
 }
 
-//updates the Secondary controls for Joystick: Sway Left and Right in Forward and Backward
-void callbackSecondaryJoystickDrive() {
-	//initializes the current allowable drive Speeds
-	int minSpeed = murahDrive.getDriveSpeed(MIN);
-	int maxSpeed = murahDrive.getDriveSpeed(MAX);
+//feeds the due recorded samples into the drive path and sleeps until the next one
+void callbackReplay() {
+	uint8_t x;
+	uint8_t y;
+	while (joystickReplay.poll(x, y)) onJoystickSample(x, y);
+	if (joystickReplay.isRunning()) taskReplay.delay(joystickReplay.getTimeToNext());
+	else taskReplay.disable();
+}
 
-	//temp variables
-	int speed;
-	float turnRatio = 0;
+#ifndef MURAHBOT_SERIAL_PROTOCOL
+//Blynk input of one motion step: kind (0 drive, 1 mix), speed or linear, Q8.8 ratio or angular,
+//duration in ms, drive state (drive only). steps can be queued while a route is running
+BLYNK_WRITE(V2) {
+	MotionPrimitive step;
+	step.kind = (param[0].asInt() == 1) ? MotionPrimitive::MOTION_MIX : MotionPrimitive::MOTION_DRIVE;
+	step.a = param[1].asInt();
+	step.b = param[2].asInt();
+	step.durationMs = param[3].asInt();
+	step.state = (Drive4Wheel::DriveState)constrain(param[4].asInt(), 0, Drive4Wheel::DRIVE_BACKWARD_RIGHT);
+	murahMotion.push(step);
+}
 
-	//various statements to check for the Secondary conditions
-	if (joystickX < X_THRESHOLD_LOW && joystickY > Y_THRESHOLD_HIGH) {
-		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
-		turnRatio = map(joystickX, X_THRESHOLD_LOW, 0, smallestRatio, biggestRatio); //map speed ratio 
-		murahDrive.swayLeft(speed, (turnRatio / 100)); //ratio to be converted to float value  
-	}
-	else if (joystickX < X_THRESHOLD_LOW && joystickY < Y_THRESHOLD_LOW) {
-		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
-		turnRatio = map(joystickX, X_THRESHOLD_LOW, 0, smallestRatio, biggestRatio);
-		murahDrive.swayLeft(speed, (turnRatio / 100), true);
+//Blynk motion control, see onMotionCommand()
+BLYNK_WRITE(V3) {
+	onMotionCommand(param.asInt());
+}
+
+//Blynk joystick recorder control, see onRecorderCommand()
+BLYNK_WRITE(V4) {
+	reportRecorder(onRecorderCommand(param.asInt()));
+}
+
+//Blynk wheel calibration: wheel, curve, point, duty, see onCalibrationCommand()
+BLYNK_WRITE(V5) {
+	reportCalibration(onCalibrationCommand(param[0].asInt(), param[1].asInt(), param[2].asInt(), param[3].asInt()));
+}
+#else
+//runs every complete frame in the receive ring. the frames only set targets, so one pass is short
+//the motion steps of Blynk V2 do not fit a frame, routes are started with COMMAND_MOTION 2
+void callbackCommandLink() {
+	PROFILE_TASK(profileLink, taskCommandLink.getInterval());
+	while (murahLink.poll()) {
+		const CommandFrame& frame = murahLink.getFrame();
+		RecorderReport recorderReport = RECORDER_NO_REPORT;
+		CalibrationReport calibrationReport = CALIBRATION_NO_REPORT;
+		{
+			ControlLoop::Lock lock;
+			switch (frame.type) {
+			case COMMAND_PING:
+				murahLink.reply(frame);
+				break;
+			case COMMAND_JOYSTICK:
+				if (!joystickReplay.isRunning()) onJoystickSample(frame.payload[0], frame.payload[1]);
+				break;
+			case COMMAND_WHEELS:
+				if (currSystemState == ACTIVE && !murahMotion.isRunning()) {
+					int16_t duty[Drive4Wheel::WHEEL_COUNT];
+					for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) duty[i] = frame.getInt8(i) * 2;
+					murahDrive.driveWheels(duty);
+				}
+				break;
+			case COMMAND_STOP:
+				murahMotion.abort();
+				taskMotion.disable();
+				murahDrive.stop();
+				break;
+			case COMMAND_CONFIG:
+				if (frame.payload[0] == CONFIG_RAMP) murahDrive.setRamp(frame.payload[1], frame.payload[2], frame.payload[3]);
+				else if (frame.payload[0] == CONFIG_MIXING) murahJoystick.useMixing(frame.payload[1] != 0);
+				else if (frame.payload[0] == CONFIG_SPEED_TOLERANCE) {
+					if (!murahDrive.setSpeedToleranceRange(frame.getInt16(1))) murahLink.replyError(frame, ERROR_OUT_OF_RANGE);
+				}
+				break;
+			case COMMAND_MOTION:
+				onMotionCommand(frame.payload[0]);
+				break;
+			case COMMAND_RECORD:
+				recorderReport = onRecorderCommand(frame.payload[0]);
+				break;
+			case COMMAND_CALIBRATE:
+				calibrationReport = onCalibrationCommand(frame.payload[0], frame.payload[1], frame.payload[2], frame.payload[3]);
+				break;
+			}
+		}
+		reportRecorder(recorderReport);
+		reportCalibration(calibrationReport);
 	}
-	else if (joystickX > X_THRESHOLD_HIGH && joystickY > Y_THRESHOLD_HIGH) {
-		speed = map(joystickY, Y_THRESHOLD_HIGH, 255, minSpeed, maxSpeed);
-		turnRatio = map(joystickX, X_THRESHOLD_HIGH, 255, smallestRatio, biggestRatio);
-		murahDrive.swayRight(speed, (turnRatio / 100));
+}
+#endif
+
+//runs the due motion steps and sleeps until the next one
+void callbackMotion() {
+	PROFILE_TASK(profileMotion, taskMotion.getInterval());
+	ControlLoop::Lock lock;
+	unsigned long nextStep = murahMotion.update();
+	if (murahMotion.isRunning()) taskMotion.delay(nextStep);
+	else taskMotion.disable();
+}
+
+//queues a telemetry frame if due and sends what fits in the Serial TX buffer
+void callbackTelemetry() {
+	PROFILE_TASK(profileTelemetry, taskTelemetry.getInterval());
+	{
+		ControlLoop::Lock lock; //a consistent set of duties
+		murahTelemetry.sample();
 	}
-	else if (joystickX > X_THRESHOLD_HIGH && joystickY < Y_THRESHOLD_LOW) {
-		speed = map(joystickY, Y_THRESHOLD_LOW, 0, minSpeed, maxSpeed);
-		turnRatio = map(joystickX, X_THRESHOLD_HIGH, 255, smallestRatio, biggestRatio);
-		murahDrive.swayRight(speed, (turnRatio / 100), true);
+	murahTelemetry.flush(Serial);
+}
+
+//advances the drive ramp, one short non-blocking step per tick
+void callbackDriveRamp() {
+	PROFILE_TASK(profileDriveRamp, taskDriveRamp.getInterval());
+	murahDrive.updateRamp();
+	onRampCommit();
+}
+
+//the ramp step after a drive command wrote its duties: the latency of that command's sample
+//short enough for the control step's ISR
+void onRampCommit() {
+	if (!driveLatencyArmed) return;
+	committedLatency = micros() - driveLatencyStart;
+	driveLatencyArmed = false;
+	driveLatencyReady = true;
+}
+
+//moves the latency taken by the last ramp step into driveLatency, from the main loop
+void collectDriveLatency() {
+	unsigned long latency;
+	{
+		ControlLoop::Lock lock;
+		if (!driveLatencyReady) return;
+		latency = committedLatency;
+		driveLatencyReady = false;
 	}
-	else murahDrive.stop();
+	driveLatency.add(latency);
+}
 
-	taskDrive.setCallback(&callbackDisplayDriveState);
+#ifdef MURAHBOT_SPEED_CONTROL
+//measures the wheel speeds and corrects the duties, fixed rate
+void callbackSpeedControl() {
+	PROFILE_TASK(profileSpeedControl, taskSpeedControl.getInterval());
+	ControlLoop::Lock lock;
+	murahSpeedControl.update();
+}
+#endif
+
+#ifdef MURAHBOT_POWER_MONITOR
+//scales the duties to the battery voltage and cuts the drive out on an overcurrent latched by the ADC ISR
+void callbackPowerMonitor() {
+	if (AdcSampler::getTrippedMask() & (1 << adcCurrent)) {
+		if (!murahDrive.isCutOut()) {
+			{
+				ControlLoop::Lock lock;
+				murahMotion.abort();
+				murahDrive.setCutOut(true);
+			}
+			TextReport report;
+			Serial.print(F("Overcurrent, drive cut out at mA: "));
+			Serial.println(((long)AdcSampler::read(adcCurrent) - currentZeroCount) * (long)currentMicroAmpsPerCount / 1000);
+		}
+		return;
+	}
+	unsigned long batteryMilliVolts = AdcSampler::read(adcBattery) * batteryMicroVoltsPerCount / 1000;
+	SpeedRatioQ8 scale = supplyScaleQ8(batteryMilliVolts, batteryNominalMilliVolts, batteryMinMilliVolts);
+	if (!speedRatioMoved(murahDrive.getSupplyScale(), scale, supplyScaleHysteresis)) return;
+	ControlLoop::Lock lock;
+	murahDrive.setSupplyScale(scale);
+}
+#endif
 
+#ifdef MURAHBOT_CONTROL_LOOP
+//one ramp step per timer period, in the ISR: short and no Serial
+void controlStep() {
+	murahDrive.updateRamp();
+	onRampCommit();
 }
+#endif
 
-//update drive state to be changes to update on Blynk app in future
-void callbackDisplayDriveState() {
-	Serial.print("Drive State: ");
-	Serial.println(murahDrive.getCurrentDriveState());
+#ifdef MURAHBOT_PROFILE
+//one line per task: runs, runtime us min/mean/max, start jitter us mean/max, overruns
+void printTaskProfile(TaskProfile& profile) {
+	Serial.print(profile.getName());
+	Serial.print(F(" n="));
+	Serial.print(profile.getCount());
+	Serial.print(F(" run="));
+	Serial.print(profile.getRuntime().getMin());
+	Serial.print('/');
+	Serial.print(profile.getRuntime().getMean());
+	Serial.print('/');
+	Serial.print(profile.getRuntime().getMax());
+	Serial.print(F(" jit="));
+	Serial.print(profile.getJitter().getMean());
+	Serial.print('/');
+	Serial.print(profile.getJitter().getMax());
+	Serial.print(F(" ovr="));
+	Serial.println(profile.getOverruns());
+}
 
-	taskDrive.setCallback(&callbackPrimaryJoystickDrive);
+//checks Serial for a report request, the report itself is only printed on demand
+void callbackProfileReport() {
+	if (!Serial.available()) return;
+	char command = Serial.read();
+	if (command == 'p') {
+		TextReport report;
+		Serial.println(F("task n run(us min/mean/max) jit(us mean/max) ovr"));
+		printTaskProfile(profileButton);
+		printTaskProfile(profileEnableDisableDrive);
+		printTaskProfile(profileDrive);
+		printTaskProfile(profileLink);
+		printTaskProfile(profileDriveRamp);
+		printTaskProfile(profileTelemetry);
+		printTaskProfile(profileMotion);
+#ifdef MURAHBOT_SPEED_CONTROL
+		printTaskProfile(profileSpeedControl);
+#endif
+	}
+	else if (command == 'r') {
+		profileButton.reset();
+		profileEnableDisableDrive.reset();
+		profileDrive.reset();
+		profileLink.reset();
+		profileDriveRamp.reset();
+		profileTelemetry.reset();
+		profileMotion.reset();
+#ifdef MURAHBOT_SPEED_CONTROL
+		profileSpeedControl.reset();
+#endif
+	}
 }
+#endif
@@ -0,0 +1,271 @@
+// SimMain.cpp
+// host simulator of the MurahBot drive: the real JoystickDrive, Drive4Wheel and Wheel code runs
+// against the PinHALMock pins on the virtual clock, SkidSteerSim turns the pins into motion
+// joystick traces (built in, or CSV files of "time_ms,x,y" lines) are replayed with the scheduling
+// of src/main.cpp (DrivePacer: event driven drive updates, 20 ms rate limit, stale link decay; 10 ms ramp task)
+// reports the final pose, the input to actuation latency and the speedup over real time per trace
+// --write-baseline FILE saves the poses, --baseline FILE compares against them (exit code 1 on a regression
+// or on a trace missing from the file). src/sim/baseline.txt holds the poses of the built in traces
+//
+// pio run -e native_sim && .pioenvs/native_sim/program [--baseline src/sim/baseline.txt] [trace.csv ...]
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <JoystickDrive.h>
+#include <TimingStats.h>
+#include <LinkHealth.h>
+#include <DrivePacer.h>
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "SkidSteerSim.h"
+
+//same wiring and drive setup as src/main.cpp
+Drive4Wheel murahDrive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+JoystickDrive murahJoystick(murahDrive);
+const SimWheelPins simPins[4] = { { 46, 47, 5 }, { 50, 51, 7 }, { 48, 49, 4 }, { 52, 53, 6 } }; //WheelIndex order
+const SkidSteerSim::Parameters simParameters = { 0.6f, 100, 0.08f, 0.30f };
+
+const unsigned long simStepMicros = 1000;
+const unsigned long driveMinInterval = 20; //ms
+const unsigned long rampInterval = 10; //ms
+const unsigned long joystickStaleTimeout = 500; //ms
+const unsigned long joystickDecayTime = 500; //ms
+const unsigned long joystickDecayStep = 20; //ms
+
+struct JoystickSample {
+	unsigned long time; //ms from the trace start
+	uint8_t x;
+	uint8_t y;
+};
+
+struct Trace {
+	std::string name;
+	std::vector<JoystickSample> samples;
+	unsigned long settleMs; //simulated after the last sample
+};
+
+struct TraceResult {
+	float x, y, heading, distance;
+};
+
+//built in traces, one sample every 40 ms like a held Blynk joystick
+//without release the trace ends in a link stall with the stick held, the stale input decays to a stop
+Trace makeTrace(const char* name, unsigned long durationMs, void(*joystick)(unsigned long t, uint8_t& x, uint8_t& y),
+	bool release = true) {
+	Trace trace;
+	trace.name = name;
+	trace.settleMs = 1000;
+	for (unsigned long t = 0; t < durationMs; t += 40) {
+		JoystickSample sample = { t, 128, 128 };
+		joystick(t, sample.x, sample.y);
+		trace.samples.push_back(sample);
+	}
+	if (release) trace.samples.push_back(JoystickSample{ durationMs, 128, 128 });
+	else trace.settleMs = joystickStaleTimeout + joystickDecayTime + 1000;
+	return trace;
+}
+
+void joystickStraight(unsigned long, uint8_t& x, uint8_t& y) { x = 128; y = 255; }
+void joystickSpin(unsigned long, uint8_t& x, uint8_t& y) { x = 255; y = 128; }
+void joystickReversal(unsigned long t, uint8_t& x, uint8_t& y) { x = 128; y = (t < 1500) ? 255 : 0; }
+void joystickArc(unsigned long, uint8_t& x, uint8_t& y) { x = 60; y = 230; }
+void joystickSlalom(unsigned long t, uint8_t& x, uint8_t& y) {
+	x = (uint8_t)(128 + 110 * sinf(t / 600.0f));
+	y = 220;
+}
+void joystickSquare(unsigned long t, uint8_t& x, uint8_t& y) {
+	bool turning = (t % 2200) >= 1500;
+	x = turning ? 255 : 128;
+	y = turning ? 128 : 255;
+}
+
+//reads "time_ms,x,y" lines, # starts a comment
+bool loadTrace(const char* path, Trace& trace) {
+	FILE* file = fopen(path, "r");
+	if (!file) return false;
+	trace.name = path;
+	trace.settleMs = 1000;
+	char line[128];
+	while (fgets(line, sizeof(line), file)) {
+		unsigned long t;
+		int x, y;
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%lu,%d,%d", &t, &x, &y) == 3) {
+			trace.samples.push_back(JoystickSample{ t, (uint8_t)constrain(x, 0, 255), (uint8_t)constrain(y, 0, 255) });
+		}
+	}
+	fclose(file);
+	return !trace.samples.empty();
+}
+
+//replays the trace through the drive code and steps the model every simStepMicros
+TraceResult runTrace(const Trace& trace) {
+	PinHALMock::reset();
+	PinHALMock::useVirtualClock(true);
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) murahDrive.getWheel(i).invalidateCache();
+	murahDrive.enableRamp(false);
+	murahDrive.stop();
+	murahDrive.enableRamp(true);
+	SkidSteerSim robot(simPins, simParameters);
+
+	TimingStats commandLatency; //sample arrival to drive command, ms
+	TimingStats actuationLatency; //sample arrival to the first pin change it caused, ms
+	unsigned long start = millis();
+	unsigned long end = trace.samples.back().time + trace.settleMs;
+	size_t next = 0;
+	unsigned long sampleTime = 0;
+	bool awaitingActuation = false;
+	unsigned long actuationSampleTime = 0;
+	unsigned long pinWritesAtDrive = 0;
+	unsigned long lastRamp = 0;
+	uint8_t joystickX = 128;
+	uint8_t joystickY = 128;
+	LinkHealth joystickLink(joystickStaleTimeout, joystickDecayTime);
+	DrivePacer drivePacer(joystickLink, driveMinInterval, joystickDecayStep);
+	bool driveArmed = false; //taskDrive
+	unsigned long driveDue = 0;
+
+	auto wallStart = std::chrono::steady_clock::now();
+	for (unsigned long now = 0; now <= end; now = millis() - start) {
+		//BLYNK_WRITE(V1)
+		while (next < trace.samples.size() && trace.samples[next].time <= now) {
+			joystickX = trace.samples[next].x;
+			joystickY = trace.samples[next].y;
+			next++;
+			joystickLink.sample();
+			unsigned long runDelay = drivePacer.onSample();
+			if (runDelay == DrivePacer::NO_RUN) continue;
+			sampleTime = now;
+			driveArmed = true;
+			driveDue = now + runDelay;
+		}
+		//taskDrive, rate limited, or rearmed by itself to decay a stale input
+		if (driveArmed && now >= driveDue) {
+			int16_t before[Drive4Wheel::WHEEL_COUNT];
+			bool changed = false;
+			bool pending = drivePacer.isPending();
+			for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) before[i] = murahDrive.getTargetDuty(i);
+			uint16_t scale = joystickLink.getCommandScale();
+			murahJoystick.drive(128 + (((joystickX - 128) * scale) >> 8), 128 + (((joystickY - 128) * scale) >> 8));
+			unsigned long nextRun = drivePacer.onDrive(scale);
+			driveArmed = nextRun != DrivePacer::NO_RUN;
+			driveDue = now + nextRun;
+			if (pending) { //latency of the sample behind this run, a decay run has none
+				for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) changed |= (before[i] != murahDrive.getTargetDuty(i));
+				commandLatency.add(now - sampleTime);
+				if (changed && !awaitingActuation) {
+					awaitingActuation = true;
+					actuationSampleTime = sampleTime;
+					pinWritesAtDrive = PinHALMock::getPinWrites();
+				}
+			}
+		}
+		//taskDriveRamp
+		if (now - lastRamp >= rampInterval) {
+			murahDrive.updateRamp();
+			lastRamp = now;
+		}
+		if (awaitingActuation && PinHALMock::getPinWrites() != pinWritesAtDrive) {
+			actuationLatency.add(now - actuationSampleTime);
+			awaitingActuation = false;
+		}
+		robot.step(simStepMicros * 1e-6f);
+		PinHALMock::advanceMicros(simStepMicros);
+	}
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+	PinHALMock::useVirtualClock(false);
+
+	TraceResult result = { robot.getX(), robot.getY(), robot.getHeading() * 180 / (float)M_PI, robot.getDistance() };
+	printf("%-14s %6lu ms %7.0fx  pose %6.3f %6.3f m %7.1f deg  dist %6.3f m  latency ms cmd %lu/%lu act %lu/%lu  samples %zu (%lu coalesced)\n",
+		trace.name.c_str(), end, end / 1000.0 / wallSeconds, result.x, result.y, result.heading, result.distance,
+		commandLatency.getMean(), commandLatency.getMax(), actuationLatency.getMean(), actuationLatency.getMax(),
+		trace.samples.size(), drivePacer.getCoalesced());
+	return result;
+}
+
+//baseline file: one "name x y heading distance" line per trace
+//every trace that ran has to be in it, a trace without a baseline fails instead of passing unchecked
+bool checkBaseline(const char* path, const std::vector<Trace>& traces, const std::vector<TraceResult>& results) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		printf("baseline %s not found\n", path);
+		return false;
+	}
+	bool passed = true;
+	std::vector<bool> checked(traces.size(), false);
+	char name[256];
+	TraceResult expected;
+	while (fscanf(file, "%255s %f %f %f %f", name, &expected.x, &expected.y, &expected.heading, &expected.distance) == 5) {
+		for (size_t i = 0; i < traces.size(); i++) {
+			if (traces[i].name != name) continue;
+			checked[i] = true;
+			const TraceResult& actual = results[i];
+			float poseError = hypotf(actual.x - expected.x, actual.y - expected.y);
+			float headingError = fabsf(actual.heading - expected.heading);
+			if (poseError > 0.01f || headingError > 1.0f || fabsf(actual.distance - expected.distance) > 0.01f) {
+				printf("REGRESSION %s: pose off by %.3f m, heading by %.1f deg\n", name, poseError, headingError);
+				passed = false;
+			}
+		}
+	}
+	fclose(file);
+	for (size_t i = 0; i < traces.size(); i++) {
+		if (checked[i]) continue;
+		printf("MISSING %s: not in the baseline, add it with --write-baseline\n", traces[i].name.c_str());
+		passed = false;
+	}
+	printf("baseline %s: %s\n", path, passed ? "passed" : "FAILED");
+	return passed;
+}
+
+void writeBaseline(const char* path, const std::vector<Trace>& traces, const std::vector<TraceResult>& results) {
+	FILE* file = fopen(path, "w");
+	if (!file) return;
+	for (size_t i = 0; i < traces.size(); i++) {
+		fprintf(file, "%s %.4f %.4f %.2f %.4f\n", traces[i].name.c_str(), results[i].x, results[i].y,
+			results[i].heading, results[i].distance);
+	}
+	fclose(file);
+}
+
+int main(int argc, char** argv) {
+	murahDrive.setRamp(10, 20, 2);
+	murahJoystick.useLookupTable(true);
+	murahJoystick.useMixing(true);
+
+	const char* baseline = 0;
+	const char* newBaseline = 0;
+	std::vector<Trace> traces;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baseline = argv[++i];
+		else if (!strcmp(argv[i], "--write-baseline") && i + 1 < argc) newBaseline = argv[++i];
+		else {
+			Trace trace;
+			if (loadTrace(argv[i], trace)) traces.push_back(trace);
+			else printf("cannot read trace %s\n", argv[i]);
+		}
+	}
+	if (traces.empty()) {
+		traces.push_back(makeTrace("straight", 3000, &joystickStraight));
+		traces.push_back(makeTrace("spin", 2000, &joystickSpin));
+		traces.push_back(makeTrace("reversal", 3000, &joystickReversal));
+		traces.push_back(makeTrace("arc", 4000, &joystickArc));
+		traces.push_back(makeTrace("slalom", 6000, &joystickSlalom));
+		traces.push_back(makeTrace("square", 8800, &joystickSquare));
+		traces.push_back(makeTrace("stall", 1500, &joystickStraight, false));
+	}
+
+	printf("MurahBot drive simulator, %zu traces\n", traces.size());
+	std::vector<TraceResult> results;
+	for (size_t i = 0; i < traces.size(); i++) results.push_back(runTrace(traces[i]));
+
+	if (newBaseline) writeBaseline(newBaseline, traces, results);
+	if (baseline && !checkBaseline(baseline, traces, results)) return 1;
+	return 0;
+}
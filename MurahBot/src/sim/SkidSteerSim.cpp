@@ -0,0 +1,51 @@
+#include <math.h>
+
+#include "SkidSteerSim.h"
+
+//default constructor: the robot starts at rest at the origin
+SkidSteerSim::SkidSteerSim(const SimWheelPins pins[4], const Parameters& parameters) :_parameters(parameters) {
+	for (uint8_t i = 0; i < 4; i++) _pins[i] = pins[i];
+	reset();
+}
+
+void SkidSteerSim::reset() {
+	for (uint8_t i = 0; i < 4; i++) _wheelSpeed[i] = 0;
+	_x = 0;
+	_y = 0;
+	_heading = 0;
+	_distance = 0;
+	_speed = 0;
+}
+
+void SkidSteerSim::step(float seconds) {
+	float blend = seconds / (_parameters.timeConstant + seconds);
+	for (uint8_t i = 0; i < 4; i++) _wheelSpeed[i] += (_targetWheelSpeed(i) - _wheelSpeed[i]) * blend;
+
+	float left = (_wheelSpeed[0] + _wheelSpeed[1]) / 2;
+	float right = (_wheelSpeed[2] + _wheelSpeed[3]) / 2;
+	_speed = (left + right) / 2;
+	float turnRate = (right - left) / _parameters.trackWidth;
+
+	_heading += turnRate * seconds;
+	_x += _speed * cosf(_heading) * seconds;
+	_y += _speed * sinf(_heading) * seconds;
+	_distance += fabsf(_speed) * seconds;
+}
+
+float SkidSteerSim::getX() { return _x; }
+float SkidSteerSim::getY() { return _y; }
+float SkidSteerSim::getHeading() { return _heading; }
+float SkidSteerSim::getDistance() { return _distance; }
+float SkidSteerSim::getSpeed() { return _speed; }
+float SkidSteerSim::getWheelSpeed(uint8_t wheel) { return (wheel < 4) ? _wheelSpeed[wheel] : 0; }
+
+//private method turning the pin levels into a wheel speed: the direction pins pick the sign
+//(both or neither HIGH brakes the wheel), the duty above the stall duty sets the magnitude
+float SkidSteerSim::_targetWheelSpeed(uint8_t wheel) {
+	bool forward = PinHALMock::getPinLevel(_pins[wheel].forward) == HIGH;
+	bool backward = PinHALMock::getPinLevel(_pins[wheel].backward) == HIGH;
+	uint8_t duty = PinHALMock::getPwmDuty(_pins[wheel].pwm);
+	if (forward == backward || duty <= _parameters.stallDuty) return 0;
+	float speed = (float)(duty - _parameters.stallDuty) / (255 - _parameters.stallDuty) * _parameters.maxWheelSpeed;
+	return forward ? speed : -speed;
+}
@@ -0,0 +1,49 @@
+// SkidSteerSim.h
+// skid steer model of the robot for the host simulator, reads the wheel pins from the PinHALMock backend
+#include <Arduino.h>
+#include <PinHAL.h>
+
+#ifndef _SKIDSTEERSIM_h
+#define _SKIDSTEERSIM_h
+
+//pins of one wheel as wired to the motor driver
+struct SimWheelPins {
+	uint8_t forward;
+	uint8_t backward;
+	uint8_t pwm;
+};
+
+//4 wheel skid steer chassis: each wheel's speed follows its pins (direction and PWM duty above the
+//stall duty) with a first order lag, the sides move at the mean of their wheels and the chassis turns
+//with an effective track wider than the real one (wheel slip). wheels are in Drive4Wheel::WheelIndex order
+class SkidSteerSim {
+public:
+	struct Parameters {
+		float maxWheelSpeed; //m/s at duty 255
+		uint8_t stallDuty; //duty below which the motor does not turn
+		float timeConstant; //s, wheel speed lag
+		float trackWidth; //m, effective track including the slip
+	};
+
+	SkidSteerSim(const SimWheelPins pins[4], const Parameters& parameters);
+
+	void reset(); //pose and wheel speeds to zero
+	void step(float seconds); //reads the pins and advances the model
+
+	float getX(); //m
+	float getY();
+	float getHeading(); //rad, counterclockwise from the start heading
+	float getDistance(); //m travelled by the chassis center
+	float getSpeed(); //m/s, linear
+	float getWheelSpeed(uint8_t wheel); //m/s
+
+private:
+	SimWheelPins _pins[4];
+	Parameters _parameters;
+	float _wheelSpeed[4];
+	float _x, _y, _heading, _distance, _speed;
+
+	float _targetWheelSpeed(uint8_t wheel); //steady state speed of the wheel at its pin levels
+};
+
+#endif
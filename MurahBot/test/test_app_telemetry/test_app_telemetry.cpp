@@ -0,0 +1,101 @@
+// test_app_telemetry.cpp
+// unit tests of lib/AppTelemetry on the host: the payload format and each push throttle on the
+// virtual clock. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <AppTelemetry.h>
+#include <unity.h>
+
+const uint8_t overhead = 10; //Blynk message around the payload of V10
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+}
+
+void tearDown() {
+	PinHALMock::useVirtualClock(false);
+}
+
+//the Blynk parameter format, with negative and clamped values
+void test_payload_bytes() {
+	AppTelemetry telemetry(10, 4, 250, 2000, 300);
+	telemetry.set(0, 0);
+	telemetry.set(1, -42);
+	telemetry.set(2, AppTelemetry::FIELD_LIMIT + 5);
+	telemetry.set(3, -2000000);
+	const char expected[] = "0\0-42\0999999\0-999999"; //and the '\0' of the string
+	TEST_ASSERT_EQUAL(sizeof(expected), telemetry.prepare(128));
+	TEST_ASSERT_EQUAL_MEMORY(expected, telemetry.getPayload(), sizeof(expected));
+	TEST_ASSERT_EQUAL(sizeof(expected) + overhead, telemetry.getBytes());
+}
+
+//one field "0" or "1": 2 payload bytes, 12 on the link
+void test_min_and_max_interval() {
+	AppTelemetry telemetry(10, 1, 250, 2000, 300);
+	telemetry.set(0, 1);
+	TEST_ASSERT_EQUAL(2, telemetry.prepare(63));
+	PinHALMock::advanceMicros(100000UL);
+	telemetry.set(0, 0);
+	TEST_ASSERT_EQUAL(0, telemetry.prepare(63)); //within the min interval
+	PinHALMock::advanceMicros(150000UL);
+	TEST_ASSERT_EQUAL(2, telemetry.prepare(63));
+	PinHALMock::advanceMicros(1999000UL);
+	TEST_ASSERT_EQUAL(0, telemetry.prepare(63)); //unchanged, within the max interval
+	PinHALMock::advanceMicros(1000UL);
+	TEST_ASSERT_EQUAL(2, telemetry.prepare(63));
+	TEST_ASSERT_EQUAL(3, telemetry.getPushes());
+	TEST_ASSERT_EQUAL(0, telemetry.getDeferred());
+}
+
+void test_full_transmit_buffer_defers_the_push() {
+	AppTelemetry telemetry(10, 1, 250, 2000, 300);
+	telemetry.set(0, 1);
+	TEST_ASSERT_EQUAL(0, telemetry.prepare(overhead + 1));
+	TEST_ASSERT_EQUAL(2, telemetry.prepare(overhead + 2));
+	TEST_ASSERT_EQUAL(1, telemetry.getPushes());
+	TEST_ASSERT_EQUAL(1, telemetry.getDeferred());
+}
+
+//12 fields of "0" or "1": 34 bytes on the link against 20 bytes/s, a change every 250 ms.
+//the first 3 pushes come from the burst (106 bytes), then one every 1.7 s. a held back push is
+//only due on every other poll, the others have the pushed value back
+void test_byte_budget() {
+	AppTelemetry telemetry(10, 12, 250, 2000, 20);
+	for (unsigned long t = 0; t <= 10000; t += 250) {
+		telemetry.set(0, (t / 250) & 1);
+		telemetry.prepare(63);
+		PinHALMock::advanceMicros(250000UL);
+	}
+	TEST_ASSERT_EQUAL(9, telemetry.getPushes());
+	TEST_ASSERT_EQUAL(16, telemetry.getDeferred());
+	TEST_ASSERT_EQUAL((overhead + AppTelemetry::PAYLOAD_SIZE) + 20 * 10, telemetry.getBytes());
+}
+
+//a change of an unwatched field waits for the max interval, a watched one is pushed at the min interval
+void test_unwatched_fields_ride_along() {
+	AppTelemetry telemetry(10, 2, 250, 2000, 300);
+	telemetry.setWatched(1 << 0);
+	telemetry.prepare(63);
+	PinHALMock::advanceMicros(500000UL);
+	telemetry.set(1, 5);
+	TEST_ASSERT_EQUAL(0, telemetry.prepare(63));
+	telemetry.set(0, 1);
+	TEST_ASSERT_EQUAL(4, telemetry.prepare(63)); //"1\05\0"
+	PinHALMock::advanceMicros(500000UL);
+	telemetry.set(1, 6);
+	TEST_ASSERT_EQUAL(0, telemetry.prepare(63));
+	PinHALMock::advanceMicros(1500000UL);
+	TEST_ASSERT_EQUAL(4, telemetry.prepare(63));
+	TEST_ASSERT_EQUAL(3, telemetry.getPushes());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_payload_bytes);
+	RUN_TEST(test_min_and_max_interval);
+	RUN_TEST(test_full_transmit_buffer_defers_the_push);
+	RUN_TEST(test_byte_budget);
+	RUN_TEST(test_unwatched_fields_ride_along);
+	return UNITY_END();
+}
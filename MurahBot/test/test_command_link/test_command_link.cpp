@@ -0,0 +1,118 @@
+// test_command_link.cpp
+// unit tests of lib/CommandLink on the host: the frame parser with good frames, a bad CRC and noise,
+// the ping round trip through the receive and transmit rings and the error reply. pio test -e native
+
+#include <Arduino.h>
+#include <CommandLink.h>
+#include <unity.h>
+
+const uint8_t joystickPayload[4] = { 200, 128, 0, 0 };
+CommandFrame good;
+
+void setUp() {
+	encodeCommandFrame(COMMAND_JOYSTICK, 7, joystickPayload, good);
+}
+
+void tearDown() {
+}
+
+//feeds the bytes, counts the decoded frames and checks that each one is the good frame
+static uint8_t feedBytes(CommandParser& parser, const uint8_t* stream, uint8_t length) {
+	uint8_t frames = 0;
+	for (uint8_t b = 0; b < length; b++) {
+		if (!parser.feed(stream[b])) continue;
+		frames++;
+		const CommandFrame& frame = parser.getFrame();
+		TEST_ASSERT_EQUAL(good.type, frame.type);
+		TEST_ASSERT_EQUAL(good.seq, frame.seq);
+		TEST_ASSERT_EQUAL_MEMORY(good.payload, frame.payload, 4);
+		TEST_ASSERT_EQUAL(good.crc, frame.crc);
+	}
+	return frames;
+}
+
+void test_parser_decodes_good_frames() {
+	const uint8_t* bytes = &good.sync;
+	uint8_t stream[2 * CommandFrame::SIZE];
+	for (uint8_t b = 0; b < sizeof(stream); b++) stream[b] = bytes[b % CommandFrame::SIZE];
+	CommandParser parser;
+	TEST_ASSERT_EQUAL(2, feedBytes(parser, stream, sizeof(stream)));
+	TEST_ASSERT_EQUAL(2, parser.getFrameCount());
+	TEST_ASSERT_EQUAL(0, parser.getCrcErrors());
+	TEST_ASSERT_EQUAL(0, parser.getDiscardedBytes());
+}
+
+void test_parser_rejects_a_bad_crc() {
+	const uint8_t* bytes = &good.sync;
+	uint8_t stream[CommandFrame::SIZE];
+	for (uint8_t b = 0; b < CommandFrame::SIZE; b++) stream[b] = (b == 4) ? bytes[b] ^ 0x10 : bytes[b];
+	CommandParser parser;
+	TEST_ASSERT_EQUAL(0, feedBytes(parser, stream, sizeof(stream)));
+	TEST_ASSERT_EQUAL(1, parser.getCrcErrors());
+	TEST_ASSERT_EQUAL(CommandFrame::SIZE, parser.getDiscardedBytes());
+}
+
+//a stray sync byte and a truncated frame before a good one: the truncated frame takes in the sync
+//bytes of the next ones, so the parser resyncs twice before the good frame
+void test_parser_resyncs_after_garbage() {
+	const uint8_t* bytes = &good.sync;
+	uint8_t stream[32];
+	uint8_t length = 0;
+	stream[length++] = CommandFrame::SYNC;
+	stream[length++] = 0x33;
+	for (uint8_t b = 0; b < 5; b++) stream[length++] = bytes[b];
+	for (uint8_t b = 0; b < CommandFrame::SIZE; b++) stream[length++] = bytes[b];
+	CommandParser parser;
+	TEST_ASSERT_EQUAL(1, feedBytes(parser, stream, length));
+	TEST_ASSERT_EQUAL(2, parser.getCrcErrors());
+	TEST_ASSERT_EQUAL(2 + 5, parser.getDiscardedBytes());
+}
+
+void test_ping_is_answered_with_a_pong() {
+	const uint8_t payload[4] = { 1, 2, 3, 4 };
+	CommandFrame ping;
+	encodeCommandFrame(COMMAND_PING, 9, payload, ping);
+	CommandLink link;
+	const uint8_t* bytes = &ping.sync;
+	for (uint8_t b = 0; b < CommandFrame::SIZE; b++) CommandLink::receiveByte(bytes[b]);
+	TEST_ASSERT_TRUE(link.poll());
+	TEST_ASSERT_TRUE(link.reply(link.getFrame()));
+	TEST_ASSERT_FALSE(link.poll());
+	CommandParser parser;
+	uint8_t byte;
+	bool decoded = false;
+	while (CommandLink::nextTransmitByte(byte)) decoded = parser.feed(byte);
+	TEST_ASSERT_TRUE(decoded);
+	TEST_ASSERT_EQUAL(COMMAND_PONG, parser.getFrame().type);
+	TEST_ASSERT_EQUAL(9, parser.getFrame().seq);
+	TEST_ASSERT_EQUAL_MEMORY(payload, parser.getFrame().payload, 4);
+}
+
+//a rejected config is answered with COMMAND_ERROR: the seq, its type, its key and why
+void test_rejected_command_is_answered_with_an_error() {
+	const uint8_t payload[4] = { CONFIG_SPEED_TOLERANCE, 0xE8, 0x03, 0 }; //1000
+	CommandFrame config;
+	encodeCommandFrame(COMMAND_CONFIG, 12, payload, config);
+	CommandLink link;
+	TEST_ASSERT_TRUE(link.replyError(config, ERROR_OUT_OF_RANGE));
+	CommandParser parser;
+	uint8_t byte;
+	bool decoded = false;
+	while (CommandLink::nextTransmitByte(byte)) decoded = parser.feed(byte);
+	TEST_ASSERT_TRUE(decoded);
+	TEST_ASSERT_EQUAL(COMMAND_ERROR, parser.getFrame().type);
+	TEST_ASSERT_EQUAL(12, parser.getFrame().seq);
+	TEST_ASSERT_EQUAL(COMMAND_CONFIG, parser.getFrame().payload[0]);
+	TEST_ASSERT_EQUAL(CONFIG_SPEED_TOLERANCE, parser.getFrame().payload[1]);
+	TEST_ASSERT_EQUAL(ERROR_OUT_OF_RANGE, parser.getFrame().payload[2]);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_parser_decodes_good_frames);
+	RUN_TEST(test_parser_rejects_a_bad_crc);
+	RUN_TEST(test_parser_resyncs_after_garbage);
+	RUN_TEST(test_ping_is_answered_with_a_pong);
+	RUN_TEST(test_rejected_command_is_answered_with_an_error);
+	return UNITY_END();
+}
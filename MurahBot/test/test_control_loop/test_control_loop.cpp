@@ -0,0 +1,136 @@
+// test_control_loop.cpp
+// unit tests of lib/ControlLoop on the host: tick() is the compare match on the virtual clock, the
+// step counters of both catch up policies and the steps missed behind a long Lock. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <ControlLoop.h>
+#include <unity.h>
+
+const uint16_t rate = 250; //Hz, like main
+const unsigned long period = 4000; //us
+unsigned long stepRuntime; //us the next step takes, then back to 0
+unsigned long stepCount;
+
+void step() {
+	stepCount++;
+	PinHALMock::advanceMicros(stepRuntime);
+	stepRuntime = 0;
+}
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+	stepRuntime = 0;
+	stepCount = 0;
+}
+
+void tearDown() {
+	ControlLoop::end();
+	PinHALMock::useVirtualClock(false);
+}
+
+//one tick per period, one step each and nothing lost
+void tickPeriods(uint8_t periods) {
+	for (uint8_t i = 0; i < periods; i++) {
+		PinHALMock::advanceMicros(period);
+		ControlLoop::tick();
+	}
+}
+
+void test_steps_on_the_grid() {
+	TEST_ASSERT_FALSE(ControlLoop::begin(20, &step));
+	TEST_ASSERT_TRUE(ControlLoop::begin(rate, &step));
+	TEST_ASSERT_EQUAL(period, ControlLoop::getPeriod());
+	tickPeriods(10);
+	ControlLoop::Stats stats;
+	ControlLoop::getStats(stats);
+	TEST_ASSERT_EQUAL(10, stepCount);
+	TEST_ASSERT_EQUAL(10, stats.steps);
+	TEST_ASSERT_EQUAL(0, stats.overruns);
+	TEST_ASSERT_EQUAL(0, stats.skipped);
+	TEST_ASSERT_EQUAL(0, stats.missed);
+}
+
+//a Lock held for 3.5 periods: the step runs late once on the unlock, the two matches before it are missed
+//and the grid goes on where it was
+void test_steps_missed_behind_a_long_lock() {
+	ControlLoop::begin(rate, &step);
+	tickPeriods(2);
+	PinHALMock::advanceMicros(period * 7 / 2);
+	ControlLoop::tick();
+	ControlLoop::Stats stats;
+	ControlLoop::getStats(stats);
+	TEST_ASSERT_EQUAL(3, stats.steps);
+	TEST_ASSERT_EQUAL(2, stats.missed);
+	TEST_ASSERT_EQUAL(0, stats.overruns);
+	PinHALMock::advanceMicros(period / 2); //back on the grid
+	ControlLoop::tick();
+	tickPeriods(2);
+	ControlLoop::getStats(stats);
+	TEST_ASSERT_EQUAL(6, stats.steps);
+	TEST_ASSERT_EQUAL(2, stats.missed);
+}
+
+//a step of 1.5 periods: SKIP drops the flagged step and the next one runs on the grid
+void test_skip_drops_the_overrun_step() {
+	ControlLoop::begin(rate, &step, ControlLoop::SKIP);
+	PinHALMock::advanceMicros(period);
+	stepRuntime = period * 3 / 2;
+	ControlLoop::tick();
+	PinHALMock::advanceMicros(period / 2);
+	ControlLoop::tick();
+	ControlLoop::Stats stats;
+	ControlLoop::getStats(stats);
+	TEST_ASSERT_EQUAL(2, stats.steps);
+	TEST_ASSERT_EQUAL(1, stats.overruns);
+	TEST_ASSERT_EQUAL(1, stats.skipped);
+	TEST_ASSERT_EQUAL(0, stats.missed);
+	TEST_ASSERT_EQUAL(period * 3 / 2, stats.runtimeMax);
+}
+
+//the same step with CATCH_UP: the flagged step runs right after the late one, then the grid goes on
+void test_catch_up_runs_the_overrun_step() {
+	ControlLoop::begin(rate, &step, ControlLoop::CATCH_UP);
+	PinHALMock::advanceMicros(period);
+	stepRuntime = period * 3 / 2;
+	ControlLoop::tick();
+	ControlLoop::tick(); //the flagged match, half a period late
+	PinHALMock::advanceMicros(period / 2);
+	ControlLoop::tick();
+	ControlLoop::Stats stats;
+	ControlLoop::getStats(stats);
+	TEST_ASSERT_EQUAL(3, stats.steps);
+	TEST_ASSERT_EQUAL(1, stats.overruns);
+	TEST_ASSERT_EQUAL(0, stats.skipped);
+	TEST_ASSERT_EQUAL(0, stats.missed);
+}
+
+//a step of 2.5 periods outlasts two matches, the timer holds only one of them: one step is caught up
+//or skipped, the other one is missed under both policies
+void test_step_over_two_periods_misses_a_step() {
+	ControlLoop::CatchUpPolicy policies[2] = { ControlLoop::SKIP, ControlLoop::CATCH_UP };
+	for (uint8_t i = 0; i < 2; i++) {
+		ControlLoop::begin(rate, &step, policies[i]);
+		PinHALMock::advanceMicros(period);
+		stepRuntime = period * 5 / 2;
+		ControlLoop::tick();
+		if (policies[i] == ControlLoop::CATCH_UP) ControlLoop::tick();
+		PinHALMock::advanceMicros(period / 2);
+		ControlLoop::tick();
+		ControlLoop::Stats stats;
+		ControlLoop::getStats(stats);
+		TEST_ASSERT_EQUAL(1, stats.overruns);
+		TEST_ASSERT_EQUAL(1, stats.missed);
+		TEST_ASSERT_EQUAL((policies[i] == ControlLoop::SKIP) ? 1 : 0, stats.skipped);
+	}
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_steps_on_the_grid);
+	RUN_TEST(test_steps_missed_behind_a_long_lock);
+	RUN_TEST(test_skip_drops_the_overrun_step);
+	RUN_TEST(test_catch_up_runs_the_overrun_step);
+	RUN_TEST(test_step_over_two_periods_misses_a_step);
+	return UNITY_END();
+}
@@ -0,0 +1,92 @@
+// test_drive_pacer.cpp
+// unit tests of lib/DrivePacer on the host: the rate limit, the coalesced samples and the decay runs
+// of a stalled link on the virtual clock. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <LinkHealth.h>
+#include <DrivePacer.h>
+#include <unity.h>
+
+//same timing as src/main.cpp
+const unsigned long driveMinInterval = 20; //ms
+const unsigned long staleTimeout = 500; //ms
+const unsigned long decayTime = 500; //ms
+const unsigned long decayStep = 20; //ms
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+}
+
+void tearDown() {
+	PinHALMock::useVirtualClock(false);
+}
+
+void advanceMillis(unsigned long ms) {
+	PinHALMock::advanceMicros(ms * 1000);
+}
+
+//the first sample runs at once, the next ones wait for the rest of the min interval
+void test_sample_runs_within_the_rate_limit() {
+	LinkHealth link(staleTimeout, decayTime);
+	DrivePacer pacer(link, driveMinInterval, decayStep);
+	link.sample();
+	TEST_ASSERT_EQUAL(0, pacer.onSample());
+	TEST_ASSERT_TRUE(pacer.isPending());
+	TEST_ASSERT_EQUAL(micros(), pacer.getSampleMicros());
+	pacer.onDrive(256);
+	TEST_ASSERT_FALSE(pacer.isPending());
+	advanceMillis(5);
+	link.sample();
+	TEST_ASSERT_EQUAL(15, pacer.onSample());
+	advanceMillis(15);
+	pacer.onDrive(256);
+	advanceMillis(30);
+	link.sample();
+	TEST_ASSERT_EQUAL(0, pacer.onSample());
+}
+
+//samples arriving while a run is pending ride along with it, the run takes the oldest arrival
+void test_samples_coalesce_into_the_pending_run() {
+	LinkHealth link(staleTimeout, decayTime);
+	DrivePacer pacer(link, driveMinInterval, decayStep);
+	link.sample();
+	pacer.onSample();
+	unsigned long first = pacer.getSampleMicros();
+	advanceMillis(3);
+	link.sample();
+	TEST_ASSERT_EQUAL(DrivePacer::NO_RUN, pacer.onSample());
+	TEST_ASSERT_EQUAL(first, pacer.getSampleMicros());
+	TEST_ASSERT_EQUAL(1, pacer.getCoalesced());
+	pacer.resetCounters();
+	TEST_ASSERT_EQUAL(0, pacer.getCoalesced());
+	pacer.reset();
+	TEST_ASSERT_FALSE(pacer.isPending());
+}
+
+//without samples the drive comes back when the link goes stale, then every decay step until stopped
+void test_stalled_link_decays_to_a_stop() {
+	LinkHealth link(staleTimeout, decayTime);
+	DrivePacer pacer(link, driveMinInterval, decayStep);
+	link.sample();
+	pacer.onSample();
+	TEST_ASSERT_EQUAL(staleTimeout + 1, pacer.onDrive(link.getCommandScale()));
+	advanceMillis(staleTimeout + 1);
+	unsigned long runs = 0;
+	unsigned long nextRun;
+	while ((nextRun = pacer.onDrive(link.getCommandScale())) != DrivePacer::NO_RUN) {
+		TEST_ASSERT_EQUAL(decayStep, nextRun);
+		advanceMillis(nextRun);
+		runs++;
+	}
+	TEST_ASSERT_EQUAL(0, link.getCommandScale());
+	TEST_ASSERT_EQUAL(decayTime / decayStep, runs);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_sample_runs_within_the_rate_limit);
+	RUN_TEST(test_samples_coalesce_into_the_pending_run);
+	RUN_TEST(test_stalled_link_decays_to_a_stop);
+	return UNITY_END();
+}
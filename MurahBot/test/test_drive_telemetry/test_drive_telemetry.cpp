@@ -0,0 +1,60 @@
+// test_drive_telemetry.cpp
+// unit tests of lib/DriveTelemetry on the host: text reports between whole frames. pio test -e native
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <DriveTelemetry.h>
+#include <unity.h>
+
+Drive4Wheel drive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+
+//an output that takes room bytes per flush
+struct TestOutput {
+	unsigned long bytes = 0;
+	int room = 5;
+	int availableForWrite() { return room; }
+	void write(uint8_t) { bytes++; }
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+//a text report while a frame is half sent: suspend() finishes that frame, holds the next ones back
+//until resume(), and the output then carries whole frames around the text
+void test_suspend_finishes_the_frame_and_holds_the_next() {
+	TestOutput output;
+	DriveTelemetry telemetry(drive, 0, 1000);
+	telemetry.queueFrame();
+	telemetry.queueFrame();
+	TEST_ASSERT_EQUAL(5, telemetry.flush(output)); //5 bytes of the first frame
+	telemetry.suspend(output);
+	TEST_ASSERT_EQUAL(TELEMETRY_FRAME_SIZE, output.bytes);
+	output.room = 64;
+	TEST_ASSERT_EQUAL(0, telemetry.flush(output));
+	telemetry.resume();
+	TEST_ASSERT_EQUAL(TELEMETRY_FRAME_SIZE, telemetry.flush(output));
+	TEST_ASSERT_EQUAL(2 * TELEMETRY_FRAME_SIZE, output.bytes);
+}
+
+void test_suspend_nests() {
+	TestOutput output;
+	output.room = 64;
+	DriveTelemetry telemetry(drive, 0, 1000);
+	telemetry.suspend(output);
+	telemetry.suspend(output);
+	telemetry.queueFrame();
+	telemetry.resume();
+	TEST_ASSERT_EQUAL(0, telemetry.flush(output));
+	telemetry.resume();
+	TEST_ASSERT_EQUAL(TELEMETRY_FRAME_SIZE, telemetry.flush(output));
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_suspend_finishes_the_frame_and_holds_the_next);
+	RUN_TEST(test_suspend_nests);
+	return UNITY_END();
+}
@@ -0,0 +1,64 @@
+// test_interrupt_button.cpp
+// unit tests of lib/InterruptButton on the host: the start/stop button of src/main.cpp on its polled
+// pin 22, on the virtual clock. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <InterruptButton.h>
+#include <unity.h>
+
+void setUp() {
+	PinHALMock::reset();
+	PinHALMock::useVirtualClock(true);
+}
+
+void tearDown() {
+	PinHALMock::useVirtualClock(false);
+}
+
+//sampled every 5 ms like taskUpdateButton: no event at power up, and one bouncy press and release
+//gives exactly one press and one release, which callbackButtonState() turns into one toggle
+void test_one_bouncy_press_is_one_press_and_one_release() {
+	InterruptButton button(22, 10);
+	button.begin();
+	TEST_ASSERT_EQUAL(HIGH, button.read());
+	unsigned long releases = 0;
+	unsigned long presses = 0;
+	const uint8_t levels[] = { HIGH, HIGH, HIGH, LOW, HIGH, LOW, LOW, LOW, LOW, HIGH, LOW, HIGH, HIGH, HIGH, HIGH };
+	for (uint8_t i = 0; i < sizeof(levels); i++) {
+		PinHALMock::digitalWrite(22, levels[i]); //the button pulls the input low while pressed
+		for (uint8_t tick = 0; tick < 2; tick++) {
+			PinHALMock::advanceMicros(5000);
+			if (!button.update()) continue;
+			if (button.read() == HIGH) releases++;
+			else presses++;
+		}
+	}
+	TEST_ASSERT_EQUAL(1, presses);
+	TEST_ASSERT_EQUAL(1, releases);
+	TEST_ASSERT_EQUAL(6, button.getEdgeCount());
+}
+
+//an edge is pending until update() took the level after the debounce time, then nothing is pending
+void test_edge_pending_until_the_debounce_time() {
+	InterruptButton button(22, 10);
+	button.begin();
+	TEST_ASSERT_FALSE(button.isPending());
+	PinHALMock::digitalWrite(22, LOW);
+	TEST_ASSERT_FALSE(button.update());
+	TEST_ASSERT_TRUE(button.isPending());
+	PinHALMock::advanceMicros(9000);
+	TEST_ASSERT_FALSE(button.update());
+	TEST_ASSERT_TRUE(button.isPending());
+	PinHALMock::advanceMicros(1000);
+	TEST_ASSERT_TRUE(button.update());
+	TEST_ASSERT_FALSE(button.isPending());
+	TEST_ASSERT_EQUAL(LOW, button.read());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_one_bouncy_press_is_one_press_and_one_release);
+	RUN_TEST(test_edge_pending_until_the_debounce_time);
+	return UNITY_END();
+}
@@ -0,0 +1,75 @@
+// test_joystick_drive.cpp
+// unit tests of lib/JoystickDrive on the host: the joystick sample shared through the sequence lock and
+// the lookup table against the threshold branches. pio test -e native
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <JoystickDrive.h>
+#include <SharedJoystick.h>
+#include <unity.h>
+
+//same wiring as src/main.cpp
+Drive4Wheel drive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+JoystickDrive joystick(drive);
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_shared_joystick_first_sample() {
+	SharedJoystick input;
+	JoystickSnapshot snapshot;
+	input.writeAt(1000, 10, 20);
+	TEST_ASSERT_TRUE(input.consume(snapshot));
+	TEST_ASSERT_EQUAL(10, snapshot.x);
+	TEST_ASSERT_EQUAL(20, snapshot.y);
+	TEST_ASSERT_EQUAL(1000, snapshot.timeUs);
+	TEST_ASSERT_EQUAL(1, snapshot.sequence);
+}
+
+//5 samples written between two drive runs: the second run sees the newest one and counts 4 skipped,
+//a run without a new sample keeps the old one
+void test_shared_joystick_newest_sample_and_skipped_count() {
+	SharedJoystick input;
+	JoystickSnapshot snapshot;
+	input.writeAt(1000, 10, 20);
+	input.consume(snapshot);
+	for (uint8_t i = 0; i < 5; i++) input.writeAt(2000 + i, 30 + i, 40 + i);
+	TEST_ASSERT_TRUE(input.consume(snapshot));
+	TEST_ASSERT_EQUAL(34, snapshot.x);
+	TEST_ASSERT_EQUAL(44, snapshot.y);
+	TEST_ASSERT_EQUAL(2004, snapshot.timeUs);
+	TEST_ASSERT_EQUAL(6, snapshot.sequence);
+	TEST_ASSERT_FALSE(input.consume(snapshot));
+	TEST_ASSERT_EQUAL(34, snapshot.x);
+	TEST_ASSERT_EQUAL(6, snapshot.sequence);
+	TEST_ASSERT_EQUAL(2, input.getConsumed());
+	TEST_ASSERT_EQUAL(4, input.getSkipped());
+}
+
+//the table buckets follow the thresholds, so it picks the branch drive state on the whole pad
+void test_lookup_table_matches_the_branches() {
+	unsigned long mismatches = 0;
+	for (int x = 0; x < 256; x++) {
+		for (int y = 0; y < 256; y++) {
+			joystick.useLookupTable(false);
+			joystick.drive(x, y);
+			Drive4Wheel::DriveState branchState = drive.getCurrentDriveState();
+			joystick.useLookupTable(true);
+			joystick.drive(x, y);
+			if (drive.getCurrentDriveState() != branchState) mismatches++;
+		}
+	}
+	joystick.useLookupTable(false);
+	TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_shared_joystick_first_sample);
+	RUN_TEST(test_shared_joystick_newest_sample_and_skipped_count);
+	RUN_TEST(test_lookup_table_matches_the_branches);
+	return UNITY_END();
+}
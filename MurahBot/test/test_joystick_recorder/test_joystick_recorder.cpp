@@ -0,0 +1,80 @@
+// test_joystick_recorder.cpp
+// unit tests of lib/JoystickRecorder on the host: the EEPROM image of a recording and the replay
+// timing on the virtual clock. pio test -e native
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <PinHAL.h>
+#include <JoystickRecorder.h>
+#include <unity.h>
+
+const int address = 1024; //like main
+JoystickRecorder recorder;
+
+//the stick resting at the center with a little noise, one sample every 20 ms
+void setUp() {
+	recorder.clear();
+	for (uint16_t i = 0; i < JoystickRecorder::CAPACITY; i++) {
+		recorder.recordAt(i * 20 + (i % 3), 120 + (i % 17), 135 - (i % 11));
+	}
+}
+
+void tearDown() {
+	EEPROM.erase();
+	PinHALMock::useVirtualClock(false);
+}
+
+void test_eeprom_round_trip() {
+	recorder.save(address);
+	JoystickRecorder loaded;
+	TEST_ASSERT_TRUE(loaded.load(address));
+	TEST_ASSERT_EQUAL(recorder.getCount(), loaded.getCount());
+	for (uint16_t i = 0; i < recorder.getCount(); i++) {
+		TEST_ASSERT_EQUAL(recorder.get(i).x, loaded.get(i).x);
+		TEST_ASSERT_EQUAL(recorder.get(i).y, loaded.get(i).y);
+		TEST_ASSERT_EQUAL(recorder.get(i).deltaMs, loaded.get(i).deltaMs);
+	}
+}
+
+//a corrupted byte is refused and the ring is left empty
+void test_corrupted_image_is_refused() {
+	recorder.save(address);
+	EEPROM.write(address + 10, EEPROM.read(address + 10) ^ 1);
+	JoystickRecorder corrupted;
+	corrupted.recordAt(0, 1, 2);
+	TEST_ASSERT_FALSE(corrupted.load(address));
+	TEST_ASSERT_EQUAL(0, corrupted.getCount());
+}
+
+//polled only every 7 ms, the replay still delivers every sample in order, at most one poll (7 ms) late
+void test_replay_delivers_every_sample_on_time() {
+	PinHALMock::useVirtualClock(true);
+	JoystickReplay replay(recorder);
+	unsigned long begin = millis();
+	unsigned long expected = 0;
+	uint16_t index = 0;
+	uint8_t x;
+	uint8_t y;
+	replay.start();
+	while (replay.isRunning()) {
+		PinHALMock::advanceMicros(7000);
+		while (replay.poll(x, y)) {
+			TEST_ASSERT_LESS_THAN(recorder.getCount(), index);
+			if (index > 0) expected += recorder.get(index).deltaMs;
+			TEST_ASSERT_EQUAL(recorder.get(index).x, x);
+			TEST_ASSERT_EQUAL(recorder.get(index).y, y);
+			TEST_ASSERT_GREATER_OR_EQUAL(expected, millis() - begin);
+			TEST_ASSERT_LESS_OR_EQUAL(expected + 7, millis() - begin);
+			index++;
+		}
+	}
+	TEST_ASSERT_EQUAL(recorder.getCount(), index);
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_eeprom_round_trip);
+	RUN_TEST(test_corrupted_image_is_refused);
+	RUN_TEST(test_replay_delivers_every_sample_on_time);
+	return UNITY_END();
+}
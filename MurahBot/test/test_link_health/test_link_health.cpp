@@ -0,0 +1,98 @@
+// test_link_health.cpp
+// unit tests of lib/LinkHealth on the host: the command scale of a stalled link on the virtual clock
+// and the interval statistics. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <LinkHealth.h>
+#include <unity.h>
+
+//same timeouts as src/main.cpp
+const unsigned long staleTimeout = 500; //ms
+const unsigned long decayTime = 500; //ms
+LinkHealth link(staleTimeout, decayTime);
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+	link.reset();
+}
+
+void tearDown() {
+	PinHALMock::useVirtualClock(false);
+}
+
+void advanceMillis(unsigned long ms) {
+	PinHALMock::advanceMicros(ms * 1000);
+}
+
+void test_no_sample_is_stale() {
+	TEST_ASSERT_TRUE(link.isStale());
+	TEST_ASSERT_EQUAL(0, link.getCommandScale());
+	TEST_ASSERT_EQUAL(0, link.getTimeToStale());
+}
+
+//full scale up to the stale timeout, then linearly down to zero over the decay time
+void test_command_scale_decays_after_the_timeout() {
+	link.sample();
+	advanceMillis(staleTimeout);
+	TEST_ASSERT_FALSE(link.isStale());
+	TEST_ASSERT_EQUAL(256, link.getCommandScale());
+	advanceMillis(2);
+	TEST_ASSERT_TRUE(link.isStale());
+	TEST_ASSERT_EQUAL(255, link.getCommandScale());
+	advanceMillis(decayTime / 4 - 2);
+	TEST_ASSERT_EQUAL(192, link.getCommandScale());
+	advanceMillis(decayTime / 4);
+	TEST_ASSERT_EQUAL(128, link.getCommandScale());
+	advanceMillis(decayTime / 4);
+	TEST_ASSERT_EQUAL(64, link.getCommandScale());
+}
+
+//the decay ends in a stop that holds however long the link stays down
+void test_command_scale_stops_after_the_decay() {
+	link.sample();
+	advanceMillis(staleTimeout + decayTime - 1);
+	TEST_ASSERT_GREATER_THAN(0, link.getCommandScale());
+	advanceMillis(1);
+	TEST_ASSERT_EQUAL(0, link.getCommandScale());
+	advanceMillis(60000);
+	TEST_ASSERT_EQUAL(0, link.getCommandScale());
+}
+
+//a new sample brings back the full scale at once and counts the outage, whose gap is not an interval
+void test_new_sample_recovers_the_link() {
+	link.sample();
+	advanceMillis(20);
+	link.sample();
+	advanceMillis(staleTimeout + decayTime / 2);
+	TEST_ASSERT_EQUAL(128, link.getCommandScale());
+	link.sample();
+	TEST_ASSERT_FALSE(link.isStale());
+	TEST_ASSERT_EQUAL(256, link.getCommandScale());
+	TEST_ASSERT_EQUAL(staleTimeout, link.getTimeToStale());
+	TEST_ASSERT_EQUAL(1, link.getStaleEvents());
+	TEST_ASSERT_EQUAL(1, link.getIntervals().getCount());
+	TEST_ASSERT_EQUAL(20000, link.getIntervals().getMax());
+}
+
+//samples every 20 ms: the smoothed interval settles there without jitter
+void test_smoothed_interval() {
+	link.sample();
+	for (uint8_t i = 0; i < 10; i++) {
+		advanceMillis(20);
+		link.sample();
+	}
+	TEST_ASSERT_EQUAL(20000, link.getSmoothedInterval());
+	TEST_ASSERT_EQUAL(0, link.getJitter().getMax());
+	TEST_ASSERT_EQUAL(10, link.getIntervals().getCount());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_sample_is_stale);
+	RUN_TEST(test_command_scale_decays_after_the_timeout);
+	RUN_TEST(test_command_scale_stops_after_the_decay);
+	RUN_TEST(test_new_sample_recovers_the_link);
+	RUN_TEST(test_smoothed_interval);
+	return UNITY_END();
+}
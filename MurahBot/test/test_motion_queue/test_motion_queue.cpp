@@ -0,0 +1,96 @@
+// test_motion_queue.cpp
+// unit tests of lib/MotionQueue on the host: a route on the virtual clock and the queue capacity across the wrap
+// pio test -e native
+
+#include <Arduino.h>
+#include <Wheels.h>
+#include <MotionQueue.h>
+#include <unity.h>
+
+Drive4Wheel drive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+
+static const MotionPrimitive route[] PROGMEM = {
+	motionDrive(Drive4Wheel::DRIVE_FORWARD, 200, 1000), motionStop(250),
+	motionDrive(Drive4Wheel::DRIVE_LEFT, 180, 333), motionMix(150, -60, 1201), motionStop(100)
+};
+const uint8_t routeSteps = sizeof(route) / sizeof(route[0]);
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+	drive.stop();
+}
+
+void tearDown() {
+	PinHALMock::useVirtualClock(false);
+}
+
+//update() called only every 7 ms, like a busy scheduler: the steps are timed from their planned ends,
+//so each step starts within one update period of its planned start and the route ends on time
+void test_route_runs_in_order_on_time() {
+	const unsigned long plannedStarts[] = { 0, 1000, 1250, 1583, 2784 };
+	const Drive4Wheel::DriveState states[] = { Drive4Wheel::DRIVE_FORWARD, Drive4Wheel::DRIVE_STOP,
+		Drive4Wheel::DRIVE_LEFT, Drive4Wheel::DRIVE_FORWARD_RIGHT, Drive4Wheel::DRIVE_STOP };
+	const unsigned long planned = 1000 + 250 + 333 + 1201 + 100;
+	const unsigned long updatePeriod = 7;
+	MotionQueue motion(drive);
+	unsigned long begin = millis();
+	TEST_ASSERT_EQUAL(routeSteps, motion.loadRoute(route, routeSteps));
+	motion.start();
+
+	//a step shows as a new commanded drive: state and the duties of both sides
+	uint8_t seen = 0;
+	long lastSignature = -1;
+	while (motion.isRunning()) {
+		long signature = ((long)drive.getCurrentDriveState() << 20)
+			^ ((long)(drive.getTargetDuty(Drive4Wheel::LEFT_FRONT) & 0x3FF) << 10)
+			^ (drive.getTargetDuty(Drive4Wheel::RIGHT_FRONT) & 0x3FF);
+		if (signature != lastSignature) {
+			TEST_ASSERT_LESS_THAN(routeSteps, seen);
+			TEST_ASSERT_EQUAL(states[seen], drive.getCurrentDriveState());
+			TEST_ASSERT_GREATER_OR_EQUAL(plannedStarts[seen], millis() - begin);
+			TEST_ASSERT_LESS_THAN(plannedStarts[seen] + updatePeriod, millis() - begin);
+			seen++;
+			lastSignature = signature;
+		}
+		PinHALMock::advanceMicros(updatePeriod * 1000);
+		motion.update();
+	}
+	unsigned long ended = millis() - begin;
+	TEST_ASSERT_EQUAL(routeSteps, seen);
+	TEST_ASSERT_GREATER_OR_EQUAL(planned, ended);
+	TEST_ASSERT_LESS_THAN(planned + updatePeriod, ended);
+	TEST_ASSERT_EQUAL(Drive4Wheel::DRIVE_STOP, drive.getCurrentDriveState());
+}
+
+//all CAPACITY slots hold a step, also once the ring has wrapped
+void test_full_queue_refuses_a_step() {
+	MotionQueue motion(drive);
+	uint8_t accepted = 0;
+	while (accepted <= MotionQueue::CAPACITY && motion.push(motionStop(10))) accepted++;
+	TEST_ASSERT_EQUAL(MotionQueue::CAPACITY, accepted);
+	TEST_ASSERT_EQUAL(MotionQueue::CAPACITY, motion.getQueued());
+	TEST_ASSERT_FALSE(motion.push(motionStop(10)));
+	TEST_ASSERT_EQUAL(0, motion.loadRoute(route, routeSteps));
+	motion.clear();
+	TEST_ASSERT_EQUAL(0, motion.getQueued());
+
+	motion.push(motionStop(10));
+	motion.push(motionStop(10));
+	motion.start(); //runs the first step, one waits
+	TEST_ASSERT_EQUAL(1, motion.getQueued());
+	TEST_ASSERT_EQUAL(routeSteps, motion.loadRoute(route, routeSteps));
+	TEST_ASSERT_EQUAL(routeSteps + 1, motion.getQueued());
+	accepted = 0;
+	while (motion.push(motionStop(10))) accepted++;
+	TEST_ASSERT_EQUAL(MotionQueue::CAPACITY - routeSteps - 1, accepted);
+	TEST_ASSERT_EQUAL(MotionQueue::CAPACITY, motion.getQueued());
+	motion.abort();
+	TEST_ASSERT_EQUAL(0, motion.getQueued());
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_route_runs_in_order_on_time);
+	RUN_TEST(test_full_queue_refuses_a_step);
+	return UNITY_END();
+}
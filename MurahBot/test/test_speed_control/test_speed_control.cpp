@@ -0,0 +1,81 @@
+// test_speed_control.cpp
+// unit tests of lib/SpeedControl on the host: the PID correction of one wheel fed with encoder ticks
+// on the virtual clock. pio test -e native
+
+#include <Arduino.h>
+#include <PinHAL.h>
+#include <Wheels.h>
+#include <WheelEncoder.h>
+#include <SpeedControl.h>
+#include <unity.h>
+
+//same wiring and encoder rate as src/main.cpp
+Drive4Wheel drive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+const int maxTicksPerSecond = 1200;
+const uint16_t periodMs = 20;
+WheelEncoder encoder(2);
+DriveSpeedControl speedControl(drive, maxTicksPerSecond, periodMs);
+
+void setUp() {
+	PinHALMock::useVirtualClock(true);
+	drive.stop();
+	speedControl.attachEncoder(Drive4Wheel::LEFT_FRONT, encoder);
+	speedControl.setMaxCorrection(60);
+}
+
+void tearDown() {
+	speedControl.enable(false);
+	PinHALMock::useVirtualClock(false);
+}
+
+//one control period with the wheel turning ticks times
+void runPeriod(int16_t ticks) {
+	encoder.injectTicks(ticks);
+	PinHALMock::advanceMicros(periodMs * 1000UL);
+	speedControl.update();
+}
+
+//duty 200 targets 941 ticks/s, 18 ticks per 20 ms measure 900: an error of 41
+void test_proportional_correction() {
+	speedControl.setGains(256, 0, 0);
+	speedControl.enable(true);
+	drive.goForward(200);
+	runPeriod(18);
+	TEST_ASSERT_EQUAL(941, speedControl.getTargetSpeed(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(900, speedControl.getMeasuredSpeed(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(41, speedControl.getCorrection(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(0, speedControl.getCorrection(Drive4Wheel::RIGHT_FRONT)); //no encoder, open loop
+}
+
+//the integral is clamped to the max correction, its share alone saturates
+void test_integral_is_clamped() {
+	speedControl.setGains(0, 32, 0);
+	speedControl.enable(true);
+	drive.goForward(200);
+	runPeriod(18);
+	TEST_ASSERT_EQUAL(5, speedControl.getCorrection(Drive4Wheel::LEFT_FRONT)); //32 * 41 / 256
+	for (uint8_t i = 0; i < 100; i++) runPeriod(18);
+	TEST_ASSERT_EQUAL(60, speedControl.getCorrection(Drive4Wheel::LEFT_FRONT));
+	runPeriod(20); //1000 ticks/s, 59 over the target: the clamped sum unwinds at once
+	TEST_ASSERT_TRUE(speedControl.getCorrection(Drive4Wheel::LEFT_FRONT) < 60);
+}
+
+//without ki the error is not summed, ki switched on later starts from a clean integral
+void test_no_windup_without_ki() {
+	speedControl.setGains(0, 0, 0);
+	speedControl.enable(true);
+	drive.goForward(200);
+	for (uint8_t i = 0; i < 100; i++) runPeriod(18);
+	TEST_ASSERT_EQUAL(0, speedControl.getCorrection(Drive4Wheel::LEFT_FRONT));
+	speedControl.setGains(0, 32, 0);
+	runPeriod(18);
+	TEST_ASSERT_EQUAL(5, speedControl.getCorrection(Drive4Wheel::LEFT_FRONT));
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_proportional_correction);
+	RUN_TEST(test_integral_is_clamped);
+	RUN_TEST(test_no_windup_without_ki);
+	return UNITY_END();
+}
@@ -0,0 +1,274 @@
+// test_wheels.cpp
+// unit tests of lib/Wheels on the host: the supply compensation and the cut out of the drive, and the
+// wheel calibration curves with their EEPROM image. pio test -e native
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wheels.h>
+#include <unity.h>
+
+//same wiring as src/main.cpp
+Drive4Wheel drive({ 46, 47, 5 }, { 48, 49, 4 }, { 50, 51, 7 }, { 52, 53, 6 }, 30);
+
+const unsigned long nominalMilliVolts = 7400; //2S pack, like main
+const unsigned long minMilliVolts = 5000;
+const uint16_t supplyScaleHysteresis = 3;
+
+void setUp() {
+	drive.enableRamp(false);
+	drive.setCutOut(false);
+	drive.setSupplyScale(toSpeedRatioQ8(1.0));
+	drive.stop();
+}
+
+void tearDown() {
+	EEPROM.erase();
+}
+
+void test_supply_scale_of_the_pack_voltage() {
+	TEST_ASSERT_EQUAL(256, supplyScaleQ8(7400, nominalMilliVolts, minMilliVolts).raw);
+	TEST_ASSERT_EQUAL(225, supplyScaleQ8(8400, nominalMilliVolts, minMilliVolts).raw); //full pack
+	TEST_ASSERT_EQUAL(305, supplyScaleQ8(6200, nominalMilliVolts, minMilliVolts).raw); //low pack
+	TEST_ASSERT_EQUAL(256, supplyScaleQ8(4000, nominalMilliVolts, minMilliVolts).raw); //no pack, not compensated
+	TEST_ASSERT_EQUAL(512, supplyScaleQ8(5000, 12000, minMilliVolts).raw); //at most 2.0
+}
+
+void test_supply_scale_sets_the_duties() {
+	drive.goForward(180);
+	drive.setSupplyScale(supplyScaleQ8(8400, nominalMilliVolts, minMilliVolts));
+	TEST_ASSERT_EQUAL(158, drive.getWheel(Drive4Wheel::LEFT_FRONT).getCurrentDuty());
+	drive.setSupplyScale(supplyScaleQ8(6200, nominalMilliVolts, minMilliVolts));
+	TEST_ASSERT_EQUAL(214, drive.getWheel(Drive4Wheel::LEFT_FRONT).getCurrentDuty());
+	TEST_ASSERT_EQUAL(214, drive.getWheel(Drive4Wheel::RIGHT_REAR).getCurrentDuty());
+	TEST_ASSERT_EQUAL(180, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT)); //the commanded duty is kept
+}
+
+//6180 and 6220 mV read one step off the 6200 mV scale, 6100 mV five steps
+void test_supply_scale_hysteresis() {
+	SpeedRatioQ8 scale = supplyScaleQ8(6200, nominalMilliVolts, minMilliVolts);
+	TEST_ASSERT_FALSE(speedRatioMoved(scale, supplyScaleQ8(6180, nominalMilliVolts, minMilliVolts), supplyScaleHysteresis));
+	TEST_ASSERT_FALSE(speedRatioMoved(scale, supplyScaleQ8(6220, nominalMilliVolts, minMilliVolts), supplyScaleHysteresis));
+	TEST_ASSERT_TRUE(speedRatioMoved(scale, supplyScaleQ8(6100, nominalMilliVolts, minMilliVolts), supplyScaleHysteresis));
+}
+
+void test_cut_out_zeroes_the_duties() {
+	drive.goForward(180);
+	drive.setCutOut(true);
+	drive.goForward(200); //ignored while cut out
+	for (uint8_t i = 0; i < Drive4Wheel::WHEEL_COUNT; i++) {
+		TEST_ASSERT_EQUAL(Wheel::WHEEL_NO_SPIN, drive.getWheel(i).getCurrentWheelState());
+		TEST_ASSERT_EQUAL(0, drive.getWheel(i).getCurrentDuty());
+	}
+	TEST_ASSERT_EQUAL(0, PinHALMock::getPwmDuty(5));
+	drive.setCutOut(false);
+	drive.goForward(200);
+	TEST_ASSERT_EQUAL(200, drive.getWheel(Drive4Wheel::LEFT_FRONT).getCurrentDuty());
+}
+
+//a reversal holds the wheel at rest, a target back in the old direction or a stop ends the hold
+void test_ramp_reversal_hold_follows_the_target() {
+	drive.setRamp(10, 255, 2); //down to rest in one step
+	drive.goForward(200);
+	drive.enableRamp(true);
+	drive.goBackward(200);
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(0, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(0, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT)); //held
+	drive.goForward(200); //back to the old direction, no reversal left to wait for
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(150, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+
+	drive.goBackward(200);
+	drive.updateRamp();
+	drive.stop();
+	drive.updateRamp();
+	drive.goBackward(200); //after the stop the wheel starts at once
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(-150, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+
+	drive.goForward(200);
+	drive.updateRamp();
+	drive.updateRamp();
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(0, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT)); //a plain reversal still holds 2 steps
+	drive.updateRamp();
+	TEST_ASSERT_EQUAL(150, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+}
+
+//the wheels share 120..255, a tolerance keeps at most half of it: 0 to 67
+void test_speed_tolerance_out_of_range_is_refused() {
+	TEST_ASSERT_FALSE(drive.setSpeedToleranceRange(-1));
+	TEST_ASSERT_FALSE(drive.setSpeedToleranceRange(68));
+	TEST_ASSERT_FALSE(drive.setSpeedToleranceRange(32767));
+	TEST_ASSERT_EQUAL(30, drive.getSpeedToleranceRange());
+	TEST_ASSERT_EQUAL(150, drive.getDriveSpeed(MIN));
+	TEST_ASSERT_EQUAL(225, drive.getDriveSpeed(MAX));
+	TEST_ASSERT_TRUE(drive.setSpeedToleranceRange(67));
+	TEST_ASSERT_EQUAL(187, drive.getDriveSpeed(MIN));
+	TEST_ASSERT_EQUAL(188, drive.getDriveSpeed(MAX));
+	TEST_ASSERT_TRUE(drive.setSpeedToleranceRange(30));
+	TEST_ASSERT_EQUAL(150, drive.getDriveSpeed(MIN));
+}
+
+//the 4 wheel constructor takes the wheels as (LF, RF, LR, RR) and keeps them in WheelIndex order
+void test_drive4_wheel_order() {
+	drive.goLeft(200); //left side backward, right side forward
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(47)); //front left backward pin
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(51)); //rear left backward pin
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(48)); //front right forward pin
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(52)); //rear right forward pin
+	TEST_ASSERT_EQUAL(200, PinHALMock::getPwmDuty(7)); //rear left speed pin
+	TEST_ASSERT_EQUAL(200, PinHALMock::getPwmDuty(4)); //front right speed pin
+}
+
+//wheels 0 to N / 2 - 1 are the left side, the others the right side, each one on its own pins
+void test_driveN_side_assignment() {
+	const WheelPins pins2[2] = { { 24, 25, 2 }, { 26, 27, 3 } };
+	DriveN<2> drive2(pins2, 30);
+	drive2.goRight(200); //left side forward, right side backward
+	TEST_ASSERT_EQUAL(Wheel::WHEEL_SPIN_FORWARD, drive2.getWheel(0).getCurrentWheelState());
+	TEST_ASSERT_EQUAL(Wheel::WHEEL_SPIN_BACKWARD, drive2.getWheel(1).getCurrentWheelState());
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(24));
+	TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel(27));
+	TEST_ASSERT_EQUAL(LOW, PinHALMock::getPinLevel(25));
+	TEST_ASSERT_EQUAL(LOW, PinHALMock::getPinLevel(26));
+
+	const WheelPins pins6[6] = { { 28, 29, 2 }, { 30, 31, 3 }, { 32, 33, 8 },
+		{ 34, 35, 9 }, { 36, 37, 10 }, { 38, 39, 13 } };
+	DriveN<6> drive6(pins6, 30);
+	drive6.goRight(200);
+	for (uint8_t i = 0; i < 6; i++) {
+		Wheel::WheelState expected = (i < 3) ? Wheel::WHEEL_SPIN_FORWARD : Wheel::WHEEL_SPIN_BACKWARD;
+		TEST_ASSERT_EQUAL(expected, drive6.getWheel(i).getCurrentWheelState());
+		TEST_ASSERT_EQUAL(HIGH, PinHALMock::getPinLevel((i < 3) ? pins6[i].forward : pins6[i].backward));
+		TEST_ASSERT_EQUAL(LOW, PinHALMock::getPinLevel((i < 3) ? pins6[i].backward : pins6[i].forward));
+		TEST_ASSERT_EQUAL(200, PinHALMock::getPwmDuty(pins6[i].speed));
+	}
+}
+
+//linear 230 and angular 25 mix into left 205 and right 255: both sides share one factor, so the
+//duties keep the ratio of the commands (the default drive speed range is 150 to 225)
+void test_mix_keeps_the_turn_ratio() {
+	int maxSpeed = drive.getDriveSpeed(MAX);
+	drive.driveMix(230, 25);
+	TEST_ASSERT_EQUAL(205L * maxSpeed / 255, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(205L * maxSpeed / 255, drive.getCurrentDuty(Drive4Wheel::LEFT_REAR));
+	TEST_ASSERT_EQUAL(maxSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_FRONT));
+	TEST_ASSERT_EQUAL(maxSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_REAR));
+	drive.driveMix(-230, -25); //backward, the sides swap
+	TEST_ASSERT_EQUAL(-205L * maxSpeed / 255, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(-maxSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_REAR));
+}
+
+//an over range pair is scaled down together: 215 and 295 become 185 and 255 of full speed, and a pure
+//spin saturates at the max drive speed on both sides
+void test_mix_saturation_keeps_the_ratio() {
+	int maxSpeed = drive.getDriveSpeed(MAX);
+	drive.driveMix(255, 40);
+	TEST_ASSERT_EQUAL(185L * maxSpeed / 255, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(maxSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_FRONT));
+	drive.driveMix(0, 255);
+	TEST_ASSERT_EQUAL(-maxSpeed, drive.getCurrentDuty(Drive4Wheel::LEFT_REAR));
+	TEST_ASSERT_EQUAL(maxSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_REAR));
+	TEST_ASSERT_EQUAL(Drive4Wheel::DRIVE_LEFT, drive.getCurrentDriveState());
+}
+
+//only a side that would stall is raised to the min drive speed, a side inside the deadband stops
+void test_mix_raises_a_stalling_side_to_the_min_speed() {
+	int minSpeed = drive.getDriveSpeed(MIN);
+	int maxSpeed = drive.getDriveSpeed(MAX);
+	drive.driveMix(100, -80);
+	TEST_ASSERT_EQUAL(180L * maxSpeed / 255, drive.getCurrentDuty(Drive4Wheel::LEFT_FRONT));
+	TEST_ASSERT_EQUAL(minSpeed, drive.getCurrentDuty(Drive4Wheel::RIGHT_FRONT));
+	drive.driveMix(100, -96);
+	TEST_ASSERT_EQUAL(0, drive.getCurrentDuty(Drive4Wheel::RIGHT_FRONT));
+	TEST_ASSERT_EQUAL(Wheel::WHEEL_NO_SPIN, drive.getWheel(Drive4Wheel::RIGHT_FRONT).getCurrentWheelState());
+}
+
+//150 + duty * 105 / 255 at the points, duty 240 is the point 249 and duty 255 the point 255
+void test_calibration_interpolates_the_deadband_curve() {
+	WheelCalibration calibration;
+	calibration.setDeadband(WheelCalibration::FORWARD, 150);
+	const uint8_t duties[] = { 0, 1, 8, 16, 120, 239, 240, 247, 248, 254, 255 };
+	const uint8_t expected[] = { 0, 150, 154, 157, 200, 249, 249, 252, 252, 255, 255 };
+	for (uint8_t i = 0; i < sizeof(duties); i++) {
+		TEST_ASSERT_EQUAL(expected[i], calibration.apply(duties[i], WheelCalibration::FORWARD));
+	}
+	for (int duty = 1; duty < 256; duty++) {
+		int corrected = calibration.apply(duty, WheelCalibration::FORWARD);
+		TEST_ASSERT_INT_WITHIN(254, 150 * 255L + duty * 105L, corrected * 255L); //within 1 of the line
+		TEST_ASSERT_GREATER_OR_EQUAL(calibration.apply(duty - 1, WheelCalibration::FORWARD), corrected);
+		TEST_ASSERT_EQUAL(duty, calibration.apply(duty, WheelCalibration::BACKWARD)); //identity, the top segment too
+	}
+}
+
+void test_calibration_curve_of_the_spin_direction() {
+	WheelCalibration calibration;
+	calibration.setDeadband(WheelCalibration::FORWARD, 150);
+	drive.getWheel(Drive4Wheel::LEFT_FRONT).setCalibration(&calibration);
+	drive.goForward(120);
+	TEST_ASSERT_EQUAL(200, PinHALMock::getPwmDuty(5));
+	drive.goBackward(120);
+	TEST_ASSERT_EQUAL(120, PinHALMock::getPwmDuty(5));
+	drive.getWheel(Drive4Wheel::LEFT_FRONT).setCalibration(0);
+}
+
+//true if every point of every curve of the wheels is the same
+static bool sameCalibrations(const WheelCalibration* a, const WheelCalibration* b) {
+	for (uint8_t wheel = 0; wheel < Drive4Wheel::WHEEL_COUNT; wheel++) {
+		for (uint8_t curve = WheelCalibration::FORWARD; curve <= WheelCalibration::BACKWARD; curve++) {
+			for (uint8_t i = 0; i < WheelCalibration::POINTS; i++) {
+				if (a[wheel].getPoint((WheelCalibration::Curve)curve, i) != b[wheel].getPoint((WheelCalibration::Curve)curve, i)) return false;
+			}
+		}
+	}
+	return true;
+}
+
+void test_calibration_eeprom_round_trip() {
+	WheelCalibration calibration[Drive4Wheel::WHEEL_COUNT];
+	calibration[Drive4Wheel::LEFT_FRONT].setDeadband(WheelCalibration::FORWARD, 150);
+	calibration[Drive4Wheel::RIGHT_REAR].setDeadband(WheelCalibration::BACKWARD, 135);
+	WheelCalibration::save(0, calibration, Drive4Wheel::WHEEL_COUNT);
+	WheelCalibration loaded[Drive4Wheel::WHEEL_COUNT];
+	TEST_ASSERT_TRUE(WheelCalibration::load(0, loaded, Drive4Wheel::WHEEL_COUNT));
+	TEST_ASSERT_TRUE(sameCalibrations(loaded, calibration));
+	TEST_ASSERT_FALSE(WheelCalibration::load(0, loaded, Drive4Wheel::WHEEL_COUNT - 1)); //another wheel count
+}
+
+//a corrupted curve byte or CRC is refused and leaves the curves unchanged
+void test_calibration_refuses_a_corrupted_image() {
+	WheelCalibration calibration[Drive4Wheel::WHEEL_COUNT];
+	calibration[Drive4Wheel::LEFT_FRONT].setDeadband(WheelCalibration::FORWARD, 150);
+	WheelCalibration::save(0, calibration, Drive4Wheel::WHEEL_COUNT);
+	const int crcAddress = WheelCalibration::getEepromSize(Drive4Wheel::WHEEL_COUNT) - 1;
+	WheelCalibration loaded[Drive4Wheel::WHEEL_COUNT];
+	WheelCalibration identity[Drive4Wheel::WHEEL_COUNT];
+	EEPROM.write(20, EEPROM.read(20) ^ 0x01);
+	TEST_ASSERT_FALSE(WheelCalibration::load(0, loaded, Drive4Wheel::WHEEL_COUNT));
+	EEPROM.write(20, EEPROM.read(20) ^ 0x01);
+	EEPROM.write(crcAddress, EEPROM.read(crcAddress) ^ 0x80);
+	TEST_ASSERT_FALSE(WheelCalibration::load(0, loaded, Drive4Wheel::WHEEL_COUNT));
+	TEST_ASSERT_TRUE(sameCalibrations(loaded, identity));
+}
+
+int main() {
+	UNITY_BEGIN();
+	RUN_TEST(test_supply_scale_of_the_pack_voltage);
+	RUN_TEST(test_supply_scale_sets_the_duties);
+	RUN_TEST(test_supply_scale_hysteresis);
+	RUN_TEST(test_cut_out_zeroes_the_duties);
+	RUN_TEST(test_ramp_reversal_hold_follows_the_target);
+	RUN_TEST(test_speed_tolerance_out_of_range_is_refused);
+	RUN_TEST(test_drive4_wheel_order);
+	RUN_TEST(test_driveN_side_assignment);
+	RUN_TEST(test_mix_keeps_the_turn_ratio);
+	RUN_TEST(test_mix_saturation_keeps_the_ratio);
+	RUN_TEST(test_mix_raises_a_stalling_side_to_the_min_speed);
+	RUN_TEST(test_calibration_interpolates_the_deadband_curve);
+	RUN_TEST(test_calibration_curve_of_the_spin_direction);
+	RUN_TEST(test_calibration_eeprom_round_trip);
+	RUN_TEST(test_calibration_refuses_a_corrupted_image);
+	return UNITY_END();
+}
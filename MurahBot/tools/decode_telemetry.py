@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Decodes MurahBot binary drive telemetry (lib/DriveTelemetry) into a readable log.
+
+The frames share the Serial port with the text reports of the robot (state changes,
+recorder and calibration dumps, task profiles). The robot holds the frames back while it
+writes a report and finishes the frame in progress first (DriveTelemetry::suspend()), so
+text only ever appears between whole frames. Bytes that are not part of a frame with a
+valid checksum are printed as text lines prefixed with "> ", or dropped with --frames-only.
+
+    python3 tools/decode_telemetry.py capture.bin
+    python3 tools/decode_telemetry.py --port /dev/ttyACM0 --baud 9600   (needs pyserial)
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+FRAME_SIZE = 16
+DRIVE_STATES = [
+    "STOP", "FORWARD", "BACKWARD", "LEFT", "RIGHT", "FORWARD_LEFT",
+    "FORWARD_RIGHT", "BACKWARD_LEFT", "BACKWARD_RIGHT",
+]
+WHEELS = ["LF", "LR", "RF", "RR"]
+
+
+def decode(chunks):
+    """Yields (sequence, millis, state, duties) for every valid frame in a stream of byte chunks,
+    and the bytes between frames as bytes objects (the robot's text)."""
+    pending = bytearray()
+    for chunk in chunks:
+        pending += chunk
+        i = 0
+        text_start = 0
+        while i + FRAME_SIZE <= len(pending):
+            if pending[i] != SYNC or sum(pending[i + 1:i + 15]) & 0xFF != pending[i + 15]:
+                i += 1
+                continue
+            if i > text_start:
+                yield bytes(pending[text_start:i])
+            sequence, millis, state = struct.unpack_from("<BIB", pending, i + 1)
+            duties = struct.unpack_from("<4h", pending, i + 7)
+            yield sequence, millis, state, duties
+            i += FRAME_SIZE
+            text_start = i
+        if i > text_start:
+            yield bytes(pending[text_start:i])
+        del pending[:i]  # the rest may be the start of a frame still arriving
+
+
+def format_frames(frames, show_text=True):
+    last_sequence = None
+    text = b""
+    for item in frames:
+        if isinstance(item, bytes):
+            text += item
+            *lines, text = text.split(b"\n")  # a line may continue in the next chunk
+            for line in lines if show_text else []:
+                yield "> " + line.decode("ascii", "replace").rstrip("\r")
+            continue
+        sequence, millis, state, duties = item
+        name = DRIVE_STATES[state] if state < len(DRIVE_STATES) else "STATE_%d" % state
+        line = "%10d ms  #%3d  %-14s %s" % (
+            millis, sequence, name,
+            "  ".join("%s %+4d" % (wheel, duty) for wheel, duty in zip(WHEELS, duties)))
+        if last_sequence is not None:
+            dropped = (sequence - last_sequence - 1) & 0xFF
+            if dropped:
+                line += "  (%d dropped)" % dropped
+        last_sequence = sequence
+        yield line
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="binary capture file, stdin if omitted")
+    parser.add_argument("--port", help="read live from a serial port instead")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--frames-only", action="store_true", help="drop the text between the frames")
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        link = serial.Serial(args.port, args.baud, timeout=0.1)
+        chunks = iter(lambda: link.read(256), None)
+    else:
+        chunks = [open(args.capture, "rb").read() if args.capture else sys.stdin.buffer.read()]
+    for line in format_frames(decode(chunks), not args.frames_only):
+        print(line, flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Measures the ping round trip to MurahBot over its BLE serial link, Blynk or the framed protocol.
+
+Connect the PC to the robot's Serial1 in place of the app: a serial BLE bridge or a USB UART on
+pins 18/19 with the BLE module unplugged. Flash the robot with the protocol under test, the
+framed protocol (lib/CommandLink) is built with -D MURAHBOT_SERIAL_PROTOCOL.
+
+    python3 tools/link_latency.py --port /dev/ttyUSB0 --protocol frame
+    python3 tools/link_latency.py --port /dev/ttyUSB0 --protocol blynk --auth <token>
+    python3 tools/link_latency.py --port /dev/ttyUSB0 --speed-tolerance 40
+
+Blynk pings are answered from taskRunBlynk once the login went through, the framed pings from
+taskCommandLink. Both replies are 5 to 8 bytes, so the difference is the time spent in the robot.
+--auth is the token of your Blynk project, the one in src/main.cpp's auth[].
+
+The framed protocol answers only pings, and commands it rejects: a COMMAND_ERROR frame (0xFF)
+with the command's seq and the payload type, first payload byte, error (1: out of range).
+CONFIG_SPEED_TOLERANCE takes 0 to half the speed range the wheels share (0 to 67 on MurahBot),
+--speed-tolerance sets it before the pings and reports a refusal. Needs pyserial.
+"""
+
+import argparse
+import statistics
+import struct
+import sys
+import time
+
+FRAME_SYNC = 0x5A
+FRAME_SIZE = 8
+COMMAND_CONFIG = 4
+COMMAND_PING = 6
+COMMAND_PONG = 0x86
+COMMAND_ERROR = 0xFF
+CONFIG_SPEED_TOLERANCE = 3
+ERROR_OUT_OF_RANGE = 1
+
+BLYNK_CMD_RESPONSE = 0
+BLYNK_CMD_LOGIN = 2
+BLYNK_CMD_PING = 6
+BLYNK_SUCCESS = 200
+
+
+def crc8(data):
+    """CRC-8, poly 0x07, init 0, like commandCrc8()."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def encode_frame(command, seq, payload):
+    body = bytes([command, seq]) + payload
+    return bytes([FRAME_SYNC]) + body + bytes([crc8(body)])
+
+
+def read_exact(port, size, deadline):
+    data = bytearray()
+    while len(data) < size and time.monotonic() < deadline:
+        data += port.read(size - len(data))
+    return bytes(data) if len(data) == size else None
+
+
+class FrameLink:
+    def __init__(self, port):
+        self.port = port
+        self.seq = 0
+
+    def send(self, command, payload):
+        self.seq = (self.seq + 1) & 0xFF
+        self.port.write(encode_frame(command, self.seq, payload))
+
+    def receive(self, deadline):
+        """Next valid frame from the robot as (type, seq, payload), None at the deadline."""
+        while time.monotonic() < deadline:
+            sync = self.port.read(1)
+            if not sync or sync[0] != FRAME_SYNC:
+                continue
+            rest = read_exact(self.port, FRAME_SIZE - 1, deadline)
+            if rest is None:
+                break
+            if crc8(rest[:6]) == rest[6]:
+                return rest[0], rest[1], rest[2:6]
+        return None
+
+    def ping(self, timeout):
+        payload = struct.pack("<I", int(time.monotonic() * 1000) & 0xFFFFFFFF)
+        start = time.perf_counter()
+        self.send(COMMAND_PING, payload)
+        deadline = time.monotonic() + timeout
+        while True:
+            frame = self.receive(deadline)
+            if frame is None:
+                return None
+            if frame == (COMMAND_PONG, self.seq, payload):
+                return time.perf_counter() - start
+
+    def set_speed_tolerance(self, tolerance, timeout):
+        """True unless the robot answers with COMMAND_ERROR within the timeout."""
+        self.send(COMMAND_CONFIG, struct.pack("<BhB", CONFIG_SPEED_TOLERANCE, tolerance, 0))
+        deadline = time.monotonic() + timeout
+        while True:
+            frame = self.receive(deadline)
+            if frame is None:
+                return True
+            if frame[0] == COMMAND_ERROR and frame[1] == self.seq:
+                return False
+
+
+class BlynkLink:
+    def __init__(self, port, auth):
+        self.port = port
+        self.msg_id = 0
+        if self.request(BLYNK_CMD_LOGIN, auth.encode(), 3.0) is None:
+            sys.exit("blynk login failed, check --auth")
+
+    def request(self, command, body, timeout):
+        self.msg_id = self.msg_id % 0xFFFF + 1
+        start = time.perf_counter()
+        self.port.write(struct.pack(">BHH", command, self.msg_id, len(body)) + body)
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            header = read_exact(self.port, 5, deadline)
+            if header is None:
+                break
+            kind, msg_id, length = struct.unpack(">BHH", header)
+            if kind != BLYNK_CMD_RESPONSE:
+                read_exact(self.port, length, deadline)  # hardware info and other messages, skipped
+                continue
+            if msg_id == self.msg_id:
+                return time.perf_counter() - start if length == BLYNK_SUCCESS else None
+        return None
+
+    def ping(self, timeout):
+        return self.request(BLYNK_CMD_PING, b"", timeout)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", required=True)
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--protocol", choices=["frame", "blynk"], default="frame")
+    parser.add_argument("--auth", help="Blynk token of your project, needed with --protocol blynk")
+    parser.add_argument("--speed-tolerance", type=int, help="CONFIG_SPEED_TOLERANCE to set first (frame only)")
+    parser.add_argument("--count", type=int, default=200)
+    parser.add_argument("--interval", type=float, default=0.02, help="seconds between pings")
+    parser.add_argument("--timeout", type=float, default=0.5)
+    args = parser.parse_args()
+    if args.protocol == "blynk" and not args.auth:
+        parser.error("--protocol blynk needs --auth")
+    if args.protocol == "blynk" and args.speed_tolerance is not None:
+        parser.error("--speed-tolerance needs --protocol frame")
+
+    import serial  # pyserial
+    port = serial.Serial(args.port, args.baud, timeout=0.01)
+    time.sleep(0.1)
+    port.reset_input_buffer()
+    link = FrameLink(port) if args.protocol == "frame" else BlynkLink(port, args.auth)
+    if args.speed_tolerance is not None and not link.set_speed_tolerance(args.speed_tolerance, args.timeout):
+        sys.exit("speed tolerance %d refused: out of range" % args.speed_tolerance)
+
+    rtts = []
+    lost = 0
+    for _ in range(args.count):
+        rtt = link.ping(args.timeout)
+        if rtt is None:
+            lost += 1
+        else:
+            rtts.append(rtt * 1000)
+        time.sleep(args.interval)
+
+    if not rtts:
+        sys.exit("no replies")
+    rtts.sort()
+    print("%s: %d pings, %d lost, round trip ms min %.2f median %.2f p95 %.2f max %.2f mean %.2f" % (
+        args.protocol, args.count, lost, rtts[0], statistics.median(rtts),
+        rtts[min(len(rtts) - 1, int(len(rtts) * 0.95))], rtts[-1], statistics.mean(rtts)))
+
+
+if __name__ == "__main__":
+    main()